@@ -6,13 +6,19 @@
 #ifndef _RAMEN_H_
 #define _RAMEN_H_
 
+#include "ramen/compression.hpp"
 #include "ramen/configuration.hpp"
 #include "ramen/data_queue.hpp"
+#include "ramen/espnow_transport.hpp"
 #include "ramen/log_holder.hpp"
 #include "ramen/logger.hpp"
 #include "ramen/mesh_network.hpp"
 #include "ramen/message.hpp"
+#include "ramen/metrics.hpp"
+#include "ramen/painless_mesh_transport.hpp"
 #include "ramen/server.hpp"
+#include "ramen/trace.hpp"
+#include "ramen/transport.hpp"
 #include "ramen/utils.hpp"
 
 using ramen = broth::server::Server;
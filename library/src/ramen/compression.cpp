@@ -0,0 +1,262 @@
+/**
+ * @file compression.cpp
+ * @brief compression.cpp
+ *
+ */
+#include "ramen/compression.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+using namespace broth::compression;
+
+// LZF refers back at most 8 kB, and copies at most 264 bytes at once
+static const uint32_t LZF_MAX_OFFSET = 1 << 13;
+static const uint32_t LZF_MAX_REFERENCE = (1 << 8) + (1 << 3);
+static const uint32_t LZF_MAX_LITERAL = 1 << 5;
+
+static const char* BASE64_CHARACTERS =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+static uint32_t lzfHash(const uint8_t* data) {
+  uint32_t value = (data[0] << 16) | (data[1] << 8) | data[2];
+
+  return ((value * 2654435761u) >> (32 - COMPRESSION_HASH_BITS)) &
+         ((1 << COMPRESSION_HASH_BITS) - 1);
+}
+
+void broth::compression::lzfCompress(const uint8_t* data,
+                                     uint32_t length,
+                                     std::vector<uint8_t>& compressed) {
+  // Positions plus one of the last occurrence of every hash, 0 if none
+  std::vector<uint32_t> table(1 << COMPRESSION_HASH_BITS, 0);
+
+  compressed.clear();
+  compressed.reserve(length + length / LZF_MAX_LITERAL + 1);
+
+  // Every run of literals is preceded by its length minus one
+  uint32_t literal_count = 0;
+  uint32_t literal_position = 0;
+  compressed.push_back(0);
+
+  uint32_t position = 0;
+  while(position < length) {
+    uint32_t reference = 0;
+    bool found = false;
+
+    if(position + 2 < length) {
+      uint32_t hash = lzfHash(data + position);
+      reference = table[hash];
+      table[hash] = position + 1;
+
+      found = reference > 0 && position - (reference - 1) <= LZF_MAX_OFFSET &&
+              std::memcmp(data + reference - 1, data + position, 3) == 0;
+      --reference;
+    }
+
+    if(!found) {
+      compressed.push_back(data[position++]);
+
+      if(++literal_count == LZF_MAX_LITERAL) {
+        compressed[literal_position] = literal_count - 1;
+        literal_count = 0;
+        literal_position = compressed.size();
+        compressed.push_back(0);
+      }
+      continue;
+    }
+
+    // Close the run of literals, or drop its unused length byte
+    if(literal_count > 0) {
+      compressed[literal_position] = literal_count - 1;
+    } else {
+      compressed.pop_back();
+    }
+
+    uint32_t max_match = std::min(length - position, LZF_MAX_REFERENCE);
+    uint32_t match = 3;
+    while(match < max_match &&
+          data[reference + match] == data[position + match]) {
+      ++match;
+    }
+
+    // | length (3) | offset high (5) | [length - 7] | offset low |
+    uint32_t offset = position - reference - 1;
+    uint32_t match_length = match - 2;
+    if(match_length < 7) {
+      compressed.push_back((match_length << 5) | (offset >> 8));
+    } else {
+      compressed.push_back((7 << 5) | (offset >> 8));
+      compressed.push_back(match_length - 7);
+    }
+    compressed.push_back(offset & 0xFF);
+
+    position += match;
+
+    literal_count = 0;
+    literal_position = compressed.size();
+    compressed.push_back(0);
+  }
+
+  if(literal_count > 0) {
+    compressed[literal_position] = literal_count - 1;
+  } else {
+    compressed.pop_back();
+  }
+};
+
+bool broth::compression::lzfDecompress(const uint8_t* compressed,
+                                       uint32_t length,
+                                       std::vector<uint8_t>& data,
+                                       uint32_t max_length) {
+  data.clear();
+
+  uint32_t position = 0;
+  while(position < length) {
+    uint32_t control = compressed[position++];
+
+    if(control < LZF_MAX_LITERAL) {
+      uint32_t literal_count = control + 1;
+      if(position + literal_count > length ||
+         data.size() + literal_count > max_length) {
+        return false;
+      }
+
+      data.insert(data.end(),
+                  compressed + position,
+                  compressed + position + literal_count);
+      position += literal_count;
+    } else {
+      uint32_t match_length = control >> 5;
+      if(match_length == 7) {
+        if(position >= length) {
+          return false;
+        }
+        match_length += compressed[position++];
+      }
+      match_length += 2;
+
+      if(position >= length) {
+        return false;
+      }
+      uint32_t offset = ((control & 0x1F) << 8) + compressed[position++] + 1;
+
+      if(offset > data.size() || data.size() + match_length > max_length) {
+        return false;
+      }
+
+      // The reference may overlap with the bytes being copied
+      uint32_t reference = data.size() - offset;
+      for(uint32_t i = 0; i < match_length; ++i) {
+        data.push_back(data[reference + i]);
+      }
+    }
+  }
+
+  return true;
+};
+
+string_t broth::compression::base64Encode(const uint8_t* data,
+                                          uint32_t length) {
+  string_t encoded;
+  encoded.reserve((length + 2) / 3 * 4);
+
+  for(uint32_t i = 0; i < length; i += 3) {
+    uint32_t value = data[i] << 16;
+    if(i + 1 < length) {
+      value |= data[i + 1] << 8;
+    }
+    if(i + 2 < length) {
+      value |= data[i + 2];
+    }
+
+    encoded += BASE64_CHARACTERS[(value >> 18) & 0x3F];
+    encoded += BASE64_CHARACTERS[(value >> 12) & 0x3F];
+    encoded += (i + 1 < length) ? BASE64_CHARACTERS[(value >> 6) & 0x3F] : '=';
+    encoded += (i + 2 < length) ? BASE64_CHARACTERS[value & 0x3F] : '=';
+  }
+
+  return encoded;
+};
+
+bool broth::compression::base64Decode(const string_t& encoded,
+                                      std::vector<uint8_t>& data) {
+  const char* characters = encoded.c_str();
+  uint32_t length = encoded.length();
+
+  data.clear();
+
+  if(length % 4 != 0) {
+    return false;
+  }
+
+  data.reserve(length / 4 * 3);
+
+  uint32_t value = 0;
+  uint32_t bits = 0;
+  for(uint32_t i = 0; i < length; ++i) {
+    char character = characters[i];
+
+    // Padding is only allowed at the very end
+    if(character == '=') {
+      return i + 2 >= length && (i + 1 == length || characters[i + 1] == '=');
+    }
+
+    const char* found = std::strchr(BASE64_CHARACTERS, character);
+    if(character == '\0' || found == NULL) {
+      return false;
+    }
+
+    value = (value << 6) | (found - BASE64_CHARACTERS);
+    bits += 6;
+    if(bits >= 8) {
+      bits -= 8;
+      data.push_back((value >> bits) & 0xFF);
+    }
+  }
+
+  return true;
+};
+
+bool broth::compression::compress(const string_t& data,
+                                  string_t& compressed) {
+  if(data.length() > COMPRESSION_MAX_SIZE) {
+    return false;
+  }
+
+  std::vector<uint8_t> buffer;
+  lzfCompress((const uint8_t*) data.c_str(), data.length(), buffer);
+
+  // Base64 takes four characters for every three bytes
+  if((buffer.size() + 2) / 3 * 4 >= data.length()) {
+    return false;
+  }
+
+  compressed = base64Encode(buffer.data(), buffer.size());
+
+  return true;
+};
+
+bool broth::compression::decompress(const string_t& compressed,
+                                    string_t& data) {
+  std::vector<uint8_t> buffer;
+  std::vector<uint8_t> decompressed;
+
+  if(!base64Decode(compressed, buffer) ||
+     !lzfDecompress(
+         buffer.data(), buffer.size(), decompressed, COMPRESSION_MAX_SIZE)) {
+    return false;
+  }
+
+  data = "";
+  data.reserve(decompressed.size());
+  for(auto byte : decompressed) {
+    // Strings end at the first null character
+    if(byte == 0) {
+      return false;
+    }
+    data += (char) byte;
+  }
+
+  return true;
+};
@@ -0,0 +1,96 @@
+/**
+ * @file compression.hpp
+ * @brief compression.hpp
+ *
+ */
+#ifndef _RAMEN_COMPRESSION_HPP_
+#define _RAMEN_COMPRESSION_HPP_
+
+#include <vector>
+
+#include "ramen/configuration.hpp"
+
+namespace broth {
+namespace compression {
+
+  /**
+   * @brief Holds the encodings of the entries in append entry requests
+   *
+   */
+  typedef enum { PLAIN_ENCODING = 0, LZF_ENCODING = 1 } EntryEncoding;
+
+  /**
+   * @brief Compress the data with the LZF format, which finds repetitions up
+   * to 8 kB back with a small hash table, so it needs little RAM
+   *
+   * @param data
+   * @param length
+   * @param compressed Output, cleared first
+   */
+  void lzfCompress(const uint8_t* data,
+                   uint32_t length,
+                   std::vector<uint8_t>& compressed);
+
+  /**
+   * @brief Decompress LZF compressed data
+   * Return true if the operation was successful, false otherwise
+   *
+   * @param compressed
+   * @param length
+   * @param data Output, cleared first
+   * @param max_length Decompressed data can't be longer than this
+   * @return true
+   * @return false If the data is malformed or too long
+   */
+  bool lzfDecompress(const uint8_t* compressed,
+                     uint32_t length,
+                     std::vector<uint8_t>& data,
+                     uint32_t max_length);
+
+  /**
+   * @brief Encode binary data in base64, so that it can be sent as a string
+   *
+   * @param data
+   * @param length
+   * @return string_t
+   */
+  string_t base64Encode(const uint8_t* data, uint32_t length);
+
+  /**
+   * @brief Decode base64 encoded data
+   * Return true if the operation was successful, false otherwise
+   *
+   * @param encoded
+   * @param data Output, cleared first
+   * @return true
+   * @return false If the string is not valid base64
+   */
+  bool base64Decode(const string_t& encoded, std::vector<uint8_t>& data);
+
+  /**
+   * @brief Compress a string into base64 encoded LZF, if that makes it
+   * shorter
+   *
+   * @param data
+   * @param compressed Output
+   * @return true If the data was compressed
+   * @return false If the data is longer than COMPRESSION_MAX_SIZE or would
+   * not get shorter
+   */
+  bool compress(const string_t& data, string_t& compressed);
+
+  /**
+   * @brief Decompress a string that was compressed with compress()
+   * Return true if the operation was successful, false otherwise
+   *
+   * @param compressed
+   * @param data Output
+   * @return true
+   * @return false
+   */
+  bool decompress(const string_t& compressed, string_t& data);
+
+} // namespace compression
+} // namespace broth
+
+#endif
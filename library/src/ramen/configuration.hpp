@@ -8,22 +8,180 @@
 // Place constants here //
 // vvvvvvvvvvvvvvvvvvvv //
 
-// In microseconds
+// In microseconds, the scheduler runs tasks with millisecond resolution
+// RAFT_TIMER_PERIOD is how often queued data is retried while there is no
+// known leader
 #ifndef RAFT_TIMER_PERIOD
   #define RAFT_TIMER_PERIOD 100000
 #endif
 #ifndef REQUEST_VOTE_TIMER_PERIOD
   #define REQUEST_VOTE_TIMER_PERIOD RAFT_TIMER_PERIOD * 2
 #endif
+
+// Heart beat period is derived from the measured round trip times to the
+// followers, HEART_BEAT_TIMER_PERIOD is used until there are measurements
 #ifndef HEART_BEAT_TIMER_PERIOD
   #define HEART_BEAT_TIMER_PERIOD RAFT_TIMER_PERIOD * 5
 #endif
-#ifndef REQUEST_APPEND_ENTRY_PERIOD
-  #define REQUEST_APPEND_ENTRY_PERIOD HEART_BEAT_TIMER_PERIOD * 3
+#ifndef MIN_HEART_BEAT_TIMER_PERIOD
+  #define MIN_HEART_BEAT_TIMER_PERIOD 50000
+#endif
+#ifndef MAX_HEART_BEAT_TIMER_PERIOD
+  #define MAX_HEART_BEAT_TIMER_PERIOD 2000000
+#endif
+// Heart beat period in multiples of the round trip timeout of the slowest
+// follower
+#ifndef HEART_BEAT_RTT_FACTOR
+  #define HEART_BEAT_RTT_FACTOR 2
+#endif
+
+// Election timeouts are picked randomly from [base, 2 * base), where base is
+// the heart beat period times ELECTION_TIMEOUT_HEART_BEAT_FACTOR within the
+// given bounds
+#ifndef ELECTION_TIMEOUT_HEART_BEAT_FACTOR
+  #define ELECTION_TIMEOUT_HEART_BEAT_FACTOR 3
+#endif
+#ifndef MIN_ELECTION_TIMEOUT
+  #define MIN_ELECTION_TIMEOUT 150000
+#endif
+#ifndef MAX_ELECTION_TIMEOUT
+  #define MAX_ELECTION_TIMEOUT 10000000
+#endif
+
+// The candidacy of a node is delayed by its election cost times
+// ELECTION_COST_DELAY_FACTOR times the base of the election timeout, at most
+// by one base. By default the cost is the average hop count minus one.
+#ifndef ELECTION_COST_DELAY_FACTOR
+  #define ELECTION_COST_DELAY_FACTOR 0.5
+#endif
+
+// ESP-NOW transport
+// Frames can carry at most 250 bytes, 12 of them are used by the header
+#ifndef ESPNOW_MAX_FRAME_SIZE
+  #define ESPNOW_MAX_FRAME_SIZE 250
+#endif
+#ifndef ESPNOW_CHANNEL
+  #define ESPNOW_CHANNEL 1
+#endif
+// Messages that are not complete after this long are dropped
+#ifndef ESPNOW_REASSEMBLY_TIMEOUT
+  #define ESPNOW_REASSEMBLY_TIMEOUT 500000
+#endif
+// At most this many messages are reassembled at the same time
+#ifndef ESPNOW_MAX_PENDING_MESSAGES
+  #define ESPNOW_MAX_PENDING_MESSAGES 4
+#endif
+// Nodes announce themselves every beacon period, and are removed from the
+// node list if nothing is heard from them for the node timeout
+#ifndef ESPNOW_BEACON_PERIOD
+  #define ESPNOW_BEACON_PERIOD 500000
+#endif
+#ifndef ESPNOW_NODE_TIMEOUT
+  #define ESPNOW_NODE_TIMEOUT ESPNOW_BEACON_PERIOD * 4
 #endif
 
-#ifndef ELECTION_TIMEOUT_FACTOR
-  #define ELECTION_TIMEOUT_FACTOR 100000
+// Messages sent to the same node within one update() are coalesced into
+// packets of at most this many bytes, 0 sends every message on its own
+#ifndef MESSAGE_COALESCING_MAX_SIZE
+  #define MESSAGE_COALESCING_MAX_SIZE 1024
+#endif
+// Coalesced packets start with this character, which never starts a message
+#ifndef COALESCED_PACKET_MARKER
+  #define COALESCED_PACKET_MARKER '#'
+#endif
+
+// Client messages may use CLIENT_MESSAGE_RATE bytes per second, with bursts
+// of up to CLIENT_MESSAGE_BURST bytes. Entries are limited by the leader's
+// REPLICATION_RATE instead, control messages such as votes, heart beats and
+// responses are not limited.
+#ifndef CLIENT_MESSAGE_RATE
+  #define CLIENT_MESSAGE_RATE 16384
+#endif
+#ifndef CLIENT_MESSAGE_BURST
+  #define CLIENT_MESSAGE_BURST 4096
+#endif
+// Replication and client messages waiting to be sent may take up to
+// SEND_QUEUE_MAX_SIZE bytes per priority, further messages are refused so that
+// the caller keeps them
+#ifndef SEND_QUEUE_MAX_SIZE
+  #define SEND_QUEUE_MAX_SIZE 4096
+#endif
+
+// Append entry requests carry as many entries as fit in the replication
+// window of the follower, in bytes. The window grows by
+// REPLICATION_WINDOW_INCREASE for every acknowledged request, and is halved on
+// failed requests and retransmissions. At least one entry is always sent.
+#ifndef INITIAL_REPLICATION_WINDOW
+  #define INITIAL_REPLICATION_WINDOW 256
+#endif
+#ifndef MIN_REPLICATION_WINDOW
+  #define MIN_REPLICATION_WINDOW 64
+#endif
+#ifndef MAX_REPLICATION_WINDOW
+  #define MAX_REPLICATION_WINDOW 1024
+#endif
+#ifndef REPLICATION_WINDOW_INCREASE
+  #define REPLICATION_WINDOW_INCREASE 128
+#endif
+// The leader sends at most REPLICATION_RATE bytes of entries per second to all
+// followers together, with bursts of up to REPLICATION_BURST bytes
+#ifndef REPLICATION_RATE
+  #define REPLICATION_RATE 8192
+#endif
+#ifndef REPLICATION_BURST
+  #define REPLICATION_BURST 2048
+#endif
+
+// Batches of entries are compressed for the followers that announce they can
+// decompress them, if that makes them shorter. 0 neither compresses nor
+// announces.
+#ifndef ENABLE_COMPRESSION
+  #define ENABLE_COMPRESSION 1
+#endif
+// Longer batches are sent as they are, it also bounds decompressed batches.
+// Twice a full replication window leaves room for the JSON of the entries.
+#ifndef COMPRESSION_MAX_SIZE
+  #define COMPRESSION_MAX_SIZE 2048
+#endif
+// The compressor's hash table takes 4 * 2^COMPRESSION_HASH_BITS bytes of RAM
+#ifndef COMPRESSION_HASH_BITS
+  #define COMPRESSION_HASH_BITS 9
+#endif
+
+// Latencies are counted in METRICS_HISTOGRAM_BUCKETS buckets that double in
+// size. The first bucket holds everything below 2^METRICS_HISTOGRAM_SHIFT
+// microseconds, the last one everything beyond the others.
+#ifndef METRICS_HISTOGRAM_BUCKETS
+  #define METRICS_HISTOGRAM_BUCKETS 16
+#endif
+#ifndef METRICS_HISTOGRAM_SHIFT
+  #define METRICS_HISTOGRAM_SHIFT 10
+#endif
+// The leader times the commits of up to this many of its newest entries
+#ifndef METRICS_TRACKED_ENTRIES
+  #define METRICS_TRACKED_ENTRIES 8
+#endif
+// Every node broadcasts a summary of its metrics this often, in microseconds.
+// 0 never does, it can also be set with Server::setHealthBroadcastPeriod().
+#ifndef HEALTH_BROADCAST_PERIOD
+  #define HEALTH_BROADCAST_PERIOD 0
+#endif
+// Shorter periods are raised to this one, so that the summaries don't flood
+// the mesh network
+#ifndef MIN_HEALTH_BROADCAST_PERIOD
+  #define MIN_HEALTH_BROADCAST_PERIOD 1000000
+#endif
+
+// Log messages below this level are compiled out along with their arguments,
+// from 1 for DEBUG to 5 for CRITICAL. The level given to init() filters the
+// rest at runtime.
+#ifndef RAMEN_MIN_LOG_LEVEL
+  #define RAMEN_MIN_LOG_LEVEL 1
+#endif
+// Every node keeps its newest TRACE_SIZE events in a binary trace, 20 bytes
+// each, see broth::logger::Trace
+#ifndef TRACE_SIZE
+  #define TRACE_SIZE 64
 #endif
 
 #ifndef HEART_BEAT_MESSAGE
@@ -37,11 +195,17 @@
 #define MESSAGE_REQUEST_APPEND_DATA_ENTRY_SIZE 100
 #define REQUEST_VOTE_SIZE                      130
 #define SEND_VOTE_SIZE                         96
-#define REQUEST_APPEND_ENTRY_SIZE              96 + MESSAGE_REQUEST_APPEND_DATA_ENTRY_SIZE
-#define RESPOND_APPEND_ENTRY_SIZE              96 + MESSAGE_REQUEST_APPEND_DATA_ENTRY_SIZE
+#define REQUEST_APPEND_ENTRY_SIZE              144 + MESSAGE_REQUEST_APPEND_DATA_ENTRY_SIZE
+#define RESPOND_APPEND_ENTRY_SIZE              168 + MESSAGE_REQUEST_APPEND_DATA_ENTRY_SIZE
 #define ENTRY_SIZE                             200 + MESSAGE_REQUEST_APPEND_DATA_ENTRY_SIZE
 #define DISTRIBUTE_ENTRY_SIZE                  100 + MESSAGE_REQUEST_APPEND_DATA_ENTRY_SIZE
 #define DISTRIBUTE_ENTRY_ACK_SIZE              96
+#define HEART_BEAT_SIZE                        160
+#define HEALTH_SIZE                            256
+// A full replication window takes about twice its size once deserialized
+#define RECEIVED_PAYLOAD_SIZE                  REQUEST_APPEND_ENTRY_SIZE + MAX_REPLICATION_WINDOW * 2
+// The same goes for the largest batch that can be decompressed
+#define RECEIVED_BATCH_SIZE                    COMPRESSION_MAX_SIZE * 2
 
 // Text for message fields, these values will be used during JSON serialization
 #define TYPE_FIELD_KEY                "type"
@@ -53,11 +217,23 @@
 #define PREVIOUS_LOG_TERM_FIELD_KEY   "previousLogTerm"
 #define ENTRIES_FIELD_KEY             "entries"
 #define COMMIT_INDEX_FIELD_KEY        "commitIndex"
+#define HEART_BEAT_PERIOD_FIELD_KEY   "heartBeatPeriod"
 #define SUCCESS_FIELD_KEY             "success"
 #define MATCH_INDEX_FIELD_KEY         "matchIndex"
+#define CONFLICT_TERM_FIELD_KEY       "conflictTerm"
+#define REQUEST_ID_FIELD_KEY          "requestId"
 #define DISTRIBUTE_ENTRY_KEY          "distrib"
 #define DISTRIBUTE_ENTRY_SEND_ACK_KEY "distribSendAck"
 #define DISTRIBUTE_ENTRY_ACK_KEY      "distribAck"
+#define ENCODING_FIELD_KEY            "encoding"
+#define COMPRESSION_FIELD_KEY         "lzf"
+#define STATE_FIELD_KEY               "state"
+#define LOG_SIZE_FIELD_KEY            "logSize"
+#define QUEUE_DEPTH_FIELD_KEY         "queueDepth"
+#define ELECTIONS_FIELD_KEY           "elections"
+#define SEND_FAILURES_FIELD_KEY       "sendFailures"
+#define RPC_LATENCY_FIELD_KEY         "rpcLatency"
+#define COMMIT_LATENCY_FIELD_KEY      "commitLatency"
 
 // ^^^^^^^^^^^^^^^^^^^^ //
 //////////////////////////
@@ -78,6 +254,13 @@
         // NOLINTNEXTLINE
         typedef String string_t;
 
+        // The host builds charge the pools of the documents to the
+        // allocation tracker
+        typedef DynamicJsonDocument json_document_t;
+
+        // Heap accounting of the subsystems is only done on the host
+        #define RAMEN_ALLOCATION_SCOPE(subsystem)
+
     #endif
 
 #else
@@ -10,15 +10,27 @@ using namespace broth::dataqueue;
 DataQueue::DataQueue() {};
 
 string_t DataQueue::pop() {
-  string_t data = this->_entries.front();
+  RAMEN_ALLOCATION_SCOPE(DATA_QUEUE);
+
+  string_t data = std::move(this->_entries.front());
   this->_entries.pop();
   return data;
 };
 
+const string_t& DataQueue::peek() {
+  return this->_entries.front();
+};
+
 void DataQueue::push(string_t data) {
-  this->_entries.push(data);
+  RAMEN_ALLOCATION_SCOPE(DATA_QUEUE);
+
+  this->_entries.push(std::move(data));
 };
 
 bool DataQueue::checkEmpty() {
   return this->_entries.empty();
-};
\ No newline at end of file
+};
+
+uint32_t DataQueue::getSize() {
+  return this->_entries.size();
+};
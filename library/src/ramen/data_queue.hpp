@@ -36,6 +36,14 @@ namespace dataqueue {
      */
     string_t pop();
 
+    /**
+     * @brief Get the oldest data in the queue without removing it, so that it
+     * stays in the queue if it can't be sent yet
+     *
+     * @return const string_t&
+     */
+    const string_t& peek();
+
     /**
      * @brief Push new data in the queue to eventually send to consensus leader
      *
@@ -50,6 +58,13 @@ namespace dataqueue {
      * @return false
      */
     bool checkEmpty();
+
+    /**
+     * @brief Get the number of data waiting in the queue
+     *
+     * @return uint32_t
+     */
+    uint32_t getSize();
   };
 
 } // namespace dataqueue
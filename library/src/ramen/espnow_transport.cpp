@@ -0,0 +1,401 @@
+/**
+ * @file espnow_transport.cpp
+ * @brief espnow_transport.cpp
+ *
+ */
+#include "ramen/espnow_transport.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+#ifndef _RAMEN_UNIT_TESTING_
+  #include <ESP8266WiFi.h>
+  #include <espnow.h>
+#endif
+
+using _espnow_transport = broth::transport::EspNowTransport;
+using namespace broth::transport;
+
+// sender (4) + destination (4) + message id (2) + index (1) + count (1)
+static const uint8_t ESPNOW_HEADER_SIZE = 12;
+static const uint8_t ESPNOW_PAYLOAD_SIZE =
+    ESPNOW_MAX_FRAME_SIZE - ESPNOW_HEADER_SIZE;
+
+static void writeUint32(uint8_t* buffer, uint32_t value) {
+  buffer[0] = value >> 24;
+  buffer[1] = value >> 16;
+  buffer[2] = value >> 8;
+  buffer[3] = value;
+}
+
+static uint32_t readUint32(const uint8_t* buffer) {
+  return ((uint32_t) buffer[0] << 24) | ((uint32_t) buffer[1] << 16) |
+         ((uint32_t) buffer[2] << 8) | (uint32_t) buffer[3];
+}
+
+/////////////////////////////////////////////////
+// ESP-NOW radio of ESP8266
+/////////////////////////////////////////////////
+
+#ifndef _RAMEN_UNIT_TESTING_
+
+using _espnow_radio = broth::transport::EspNowRadio;
+
+_espnow_radio* _espnow_radio::_radio_ptr = NULL;
+
+static uint8_t broadcast_mac[] = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF};
+
+bool _espnow_radio::init() {
+  // ESP-NOW needs the radio, but not a connection
+  WiFi.mode(WIFI_STA);
+  WiFi.disconnect();
+  wifi_set_channel(ESPNOW_CHANNEL);
+
+  if(esp_now_init() != 0) {
+    return false;
+  }
+
+  esp_now_set_self_role(ESP_NOW_ROLE_COMBO);
+  esp_now_add_peer(broadcast_mac, ESP_NOW_ROLE_COMBO, ESPNOW_CHANNEL, NULL, 0);
+
+  _radio_ptr = this;
+  esp_now_register_recv_cb(&_espnow_radio::receiveFrame);
+
+  // Same node ID as painlessMesh would use, which takes the last four bytes
+  // of the soft AP MAC address. The station MAC address differs from it.
+  uint8_t mac[6];
+  WiFi.softAPmacAddress(mac);
+  this->_node_id = readUint32(mac + 2);
+
+  return true;
+};
+
+void _espnow_radio::receiveFrame(uint8_t* mac, uint8_t* data, uint8_t length) {
+  // Runs in the system context, which never interrupts loop(), so the frame
+  // is only queued here
+  if(_radio_ptr) {
+    _radio_ptr->_frame_buffer.push_back(
+        std::vector<uint8_t>(data, data + length));
+  }
+};
+
+uint32_t _espnow_radio::getNodeId() {
+  return this->_node_id;
+};
+
+bool _espnow_radio::sendFrame(const uint8_t* data, uint8_t length) {
+  return esp_now_send(broadcast_mac, (uint8_t*) data, length) == 0;
+};
+
+void _espnow_radio::onReceiveFrame(received_frame_callback_t on_receive) {
+  this->_received_callback = on_receive;
+};
+
+void _espnow_radio::update() {
+  while(this->_frame_buffer.size() > 0) {
+    auto frame = this->_frame_buffer.front();
+    this->_frame_buffer.pop_front();
+
+    if(this->_received_callback) {
+      this->_received_callback(frame.data(), frame.size());
+    }
+  }
+};
+
+#endif
+
+/////////////////////////////////////////////////
+// ESP-NOW transport
+/////////////////////////////////////////////////
+
+_espnow_transport::EspNowTransport() {};
+
+bool _espnow_transport::init(string_t mesh_name,
+                             string_t mesh_password,
+                             Scheduler* scheduler_ptr,
+                             uint16_t mesh_port) {
+  this->_scheduler_ptr = scheduler_ptr;
+
+  if(!this->_radio.init()) {
+    return false;
+  }
+
+  this->_node_id = this->_radio.getNodeId();
+  this->_radio.onReceiveFrame([&](const uint8_t* frame, uint8_t length) {
+    this->handleFrame(frame, length);
+  });
+
+  return true;
+};
+
+void _espnow_transport::update() {
+  this->_radio.update();
+  this->maintain();
+  this->deliverMessages();
+
+  if(this->_scheduler_ptr) {
+    this->_scheduler_ptr->execute();
+  }
+};
+
+uint32_t _espnow_transport::getNodeId() {
+  return this->_node_id;
+};
+
+uint32_t _espnow_transport::getNodeTime() {
+  return micros() + this->_time_offset;
+};
+
+std::list<uint32_t> _espnow_transport::getNodeList(bool include_self) {
+  std::list<uint32_t> node_list;
+
+  for(auto it = this->_last_seen.begin(); it != this->_last_seen.end(); ++it) {
+    node_list.push_back(it->first);
+  }
+
+  if(include_self) {
+    node_list.push_back(this->_node_id);
+  }
+
+  return node_list;
+};
+
+bool _espnow_transport::sendBroadcast(string_t data) {
+  return this->sendFrames(0, data);
+};
+
+bool _espnow_transport::sendSingle(uint32_t destination_node_id,
+                                   string_t data) {
+  // Every frame is broadcasted, the other nodes drop it by its destination
+  return this->sendFrames(destination_node_id, data);
+};
+
+void _espnow_transport::onReceive(received_callback_t on_receive) {
+  this->_received_callback = on_receive;
+};
+
+void _espnow_transport::onChangedConnections(
+    changed_connections_callback_t on_changed_connections) {
+  this->_changed_connections_callback = on_changed_connections;
+};
+
+bool _espnow_transport::sendFrames(uint32_t destination_node_id,
+                                   string_t& data) {
+  uint32_t length = data.length();
+  uint32_t count = (length + ESPNOW_PAYLOAD_SIZE - 1) / ESPNOW_PAYLOAD_SIZE;
+
+  // Even an empty message takes a frame, a count of 0 is a beacon
+  count = std::max(count, (uint32_t) 1);
+
+  // The fragment index has to fit in a byte
+  if(count > 255) {
+    return false;
+  }
+
+  uint8_t frame[ESPNOW_MAX_FRAME_SIZE];
+  writeUint32(frame, this->_node_id);
+  writeUint32(frame + 4, destination_node_id);
+  frame[8] = this->_message_id >> 8;
+  frame[9] = this->_message_id;
+  frame[11] = count;
+  ++this->_message_id;
+
+  const char* payload = data.c_str();
+  bool success = true;
+
+  for(uint32_t i = 0; i < count; ++i) {
+    uint32_t offset = i * ESPNOW_PAYLOAD_SIZE;
+    uint32_t size = std::min(length - offset, (uint32_t) ESPNOW_PAYLOAD_SIZE);
+
+    frame[10] = i;
+    std::memcpy(frame + ESPNOW_HEADER_SIZE, payload + offset, size);
+
+    success = this->_radio.sendFrame(frame, ESPNOW_HEADER_SIZE + size) &&
+              success;
+  }
+
+  return success;
+};
+
+void _espnow_transport::handleFrame(const uint8_t* frame, uint8_t length) {
+  // Drop frames that don't even have a header
+  if(length < ESPNOW_HEADER_SIZE) {
+    return;
+  }
+
+  uint32_t sender = readUint32(frame);
+  uint32_t destination = readUint32(frame + 4);
+  uint16_t message_id = (frame[8] << 8) | frame[9];
+  uint8_t index = frame[10];
+  uint8_t count = frame[11];
+
+  if(sender == this->_node_id) {
+    return;
+  }
+
+  // Any frame shows that the sender is around
+  uint32_t current_time = this->getNodeTime();
+  bool new_node = this->_last_seen.find(sender) == this->_last_seen.end();
+  this->_last_seen[sender] = current_time;
+
+  if(new_node && this->_changed_connections_callback) {
+    this->_changed_connections_callback();
+  }
+
+  // Beacons carry no data, and messages for other nodes are not ours to keep
+  if(count == 0 || index >= count ||
+     (destination != 0 && destination != this->_node_id)) {
+    return;
+  }
+
+  // Copy the payload into a null terminated buffer, messages are text
+  char payload[ESPNOW_MAX_FRAME_SIZE + 1];
+  std::memcpy(payload, frame + ESPNOW_HEADER_SIZE, length - ESPNOW_HEADER_SIZE);
+  payload[length - ESPNOW_HEADER_SIZE] = '\0';
+
+  if(count == 1) {
+    this->_message_buffer.push_back(std::make_pair(sender, string_t(payload)));
+    return;
+  }
+
+  uint64_t key = ((uint64_t) sender << 16) | message_id;
+  auto it = this->_pending_messages.find(key);
+
+  if(it == this->_pending_messages.end()) {
+    // Make room by dropping the oldest message
+    if(this->_pending_messages.size() >= ESPNOW_MAX_PENDING_MESSAGES) {
+      auto oldest = this->_pending_messages.begin();
+      for(auto pending = this->_pending_messages.begin();
+          pending != this->_pending_messages.end();
+          ++pending) {
+        if((uint32_t)(current_time - pending->second.first_frame_time) >
+           (uint32_t)(current_time - oldest->second.first_frame_time)) {
+          oldest = pending;
+        }
+      }
+      this->_pending_messages.erase(oldest);
+    }
+
+    PendingMessage message;
+    message.first_frame_time = current_time;
+    message.received_count = 0;
+    message.received.resize(count, false);
+    message.fragments.resize(count);
+    it = this->_pending_messages.insert(std::make_pair(key, message)).first;
+  }
+
+  PendingMessage& message = it->second;
+
+  // A reused message ID with a different count is a different message
+  if(message.fragments.size() != count) {
+    this->_pending_messages.erase(it);
+    return;
+  }
+
+  // Duplicates are ignored
+  if(!message.received[index]) {
+    message.received[index] = true;
+    message.fragments[index] = payload;
+    ++message.received_count;
+  }
+
+  if(message.received_count == count) {
+    string_t data;
+    for(auto& fragment : message.fragments) {
+      data += fragment;
+    }
+
+    this->_message_buffer.push_back(std::make_pair(sender, data));
+    this->_pending_messages.erase(it);
+  }
+};
+
+void _espnow_transport::maintain() {
+  uint32_t current_time = this->getNodeTime();
+
+  // Announce this node
+  if(!this->_sent_beacon ||
+     (uint32_t)(current_time - this->_last_beacon_time) >=
+         ESPNOW_BEACON_PERIOD) {
+    uint8_t beacon[ESPNOW_HEADER_SIZE] = {};
+    writeUint32(beacon, this->_node_id);
+
+    this->_radio.sendFrame(beacon, ESPNOW_HEADER_SIZE);
+    this->_last_beacon_time = current_time;
+    this->_sent_beacon = true;
+  }
+
+  // Forget the nodes that went quiet
+  bool removed_node = false;
+  for(auto it = this->_last_seen.begin(); it != this->_last_seen.end();) {
+    if((uint32_t)(current_time - it->second) > ESPNOW_NODE_TIMEOUT) {
+      it = this->_last_seen.erase(it);
+      removed_node = true;
+    } else {
+      ++it;
+    }
+  }
+
+  if(removed_node && this->_changed_connections_callback) {
+    this->_changed_connections_callback();
+  }
+
+  // Drop the messages that lost a frame
+  for(auto it = this->_pending_messages.begin();
+      it != this->_pending_messages.end();) {
+    if((uint32_t)(current_time - it->second.first_frame_time) >
+       ESPNOW_REASSEMBLY_TIMEOUT) {
+      it = this->_pending_messages.erase(it);
+    } else {
+      ++it;
+    }
+  }
+};
+
+void _espnow_transport::deliverMessages() {
+  while(this->_message_buffer.size() > 0) {
+    auto message = this->_message_buffer.front();
+    this->_message_buffer.pop_front();
+
+    if(this->_received_callback) {
+      this->_received_callback(message.first, message.second);
+    }
+  }
+};
+
+  /////////////////////////////////////////////////
+  // Methods used only during testing
+  /////////////////////////////////////////////////
+
+#ifdef _RAMEN_UNIT_TESTING_
+
+void _espnow_transport::setMeshTime(uint32_t time) {
+  this->_time_offset = time - micros();
+};
+
+void _espnow_transport::incrementMeshTimeBy(uint32_t time) {
+  this->_time_offset += time;
+};
+
+void _espnow_transport::setNodeId(uint32_t node_id) {
+  this->_node_id = node_id;
+  this->_radio.setNodeId(node_id);
+};
+
+void _espnow_transport::addNeighbourNode(Transport& neighbour_node) {
+  // Every radio hears every other radio on the medium
+};
+
+void _espnow_transport::checkForNewMessages() {
+  this->_radio.update();
+  this->deliverMessages();
+};
+
+std::list<std::pair<uint32_t, string_t>>&
+_espnow_transport::getMessageBuffer() {
+  this->_radio.update();
+
+  return this->_message_buffer;
+};
+
+#endif
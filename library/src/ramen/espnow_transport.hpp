@@ -0,0 +1,217 @@
+/**
+ * @file espnow_transport.hpp
+ * @brief espnow_transport.hpp
+ *
+ */
+#ifndef _RAMEN_ESPNOW_TRANSPORT_HPP_
+#define _RAMEN_ESPNOW_TRANSPORT_HPP_
+
+#include <map>
+#include <vector>
+
+#include "ramen/configuration.hpp"
+#include "ramen/transport.hpp"
+
+namespace broth {
+namespace transport {
+
+#ifndef _RAMEN_UNIT_TESTING_
+
+  /**
+   * @brief Structure for defining the received frame callback type
+   *
+   */
+  typedef std::function<void(const uint8_t* data, uint8_t length)>
+      received_frame_callback_t;
+
+  /**
+   * @brief Thin wrapper around the ESP-NOW API of ESP8266, which broadcasts
+   * frames to every node on the channel. There can only be one radio.
+   *
+   */
+  class EspNowRadio {
+   private:
+    uint32_t _node_id = 0;
+    received_frame_callback_t _received_callback;
+    // Frames are received in the system context and handled in update()
+    std::list<std::vector<uint8_t>> _frame_buffer;
+
+    static EspNowRadio* _radio_ptr;
+    static void receiveFrame(uint8_t* mac, uint8_t* data, uint8_t length);
+
+   public:
+    /**
+     * @brief Initializes ESP-NOW and derives the node ID from the MAC address,
+     * the same way painlessMesh does
+     * Return true if the operation was successful, false otherwise
+     *
+     * @return true
+     * @return false
+     */
+    bool init();
+
+    /**
+     * @brief Get the ID of the current node
+     *
+     * @return uint32_t
+     */
+    uint32_t getNodeId();
+
+    /**
+     * @brief Broadcast a frame of at most 250 bytes
+     *
+     * @param data
+     * @param length
+     * @return true
+     * @return false
+     */
+    bool sendFrame(const uint8_t* data, uint8_t length);
+
+    /**
+     * @brief Set the callback function which will be called in update() for
+     * every received frame
+     *
+     * @param on_receive
+     */
+    void onReceiveFrame(received_frame_callback_t on_receive);
+
+    /**
+     * @brief Hand the received frames to the callback
+     *
+     */
+    void update();
+  };
+
+#endif
+
+  /**
+   * @brief Transport that runs on ESP-NOW, for clusters where every node can
+   * hear every other node. Messages are split into frames of at most
+   * ESPNOW_MAX_FRAME_SIZE bytes and reassembled on the receiving side. Every
+   * frame starts with a 12 byte header:
+   *
+   * | sender (4) | destination (4) | message id (2) | index (1) | count (1) |
+   *
+   * A destination of 0 means broadcast. A frame with a count of 0 carries no
+   * data and only announces the sender, nodes are learned from these beacons
+   * and from any other frame they send.
+   *
+   */
+  class EspNowTransport : public Transport {
+   private:
+    /**
+     * @brief A message that is not fully received yet
+     *
+     */
+    struct PendingMessage {
+      uint32_t first_frame_time;
+      uint8_t received_count;
+      std::vector<bool> received;
+      std::vector<string_t> fragments;
+    };
+
+    EspNowRadio _radio;
+    uint32_t _node_id = 0;
+    uint16_t _message_id = 0;
+    uint32_t _time_offset = 0;
+    uint32_t _last_beacon_time = 0;
+    bool _sent_beacon = false;
+    Scheduler* _scheduler_ptr = NULL;
+    received_callback_t _received_callback;
+    changed_connections_callback_t _changed_connections_callback;
+    // last_seen:{node_id, time_of_last_frame_from_node_id}
+    std::map<uint32_t, uint32_t> _last_seen;
+    // pending:{(sender << 16) | message_id, fragments received so far}
+    std::map<uint64_t, PendingMessage> _pending_messages;
+    std::list<std::pair<uint32_t, string_t>> _message_buffer;
+
+    /**
+     * @brief Split the data into frames and send them to the destination
+     *
+     * @param destination_node_id 0 to send to every node
+     * @param data
+     * @return true
+     * @return false
+     */
+    bool sendFrames(uint32_t destination_node_id, string_t& data);
+
+    /**
+     * @brief Handle a frame that was received by the radio
+     *
+     * @param frame
+     * @param length
+     */
+    void handleFrame(const uint8_t* frame, uint8_t length);
+
+    /**
+     * @brief Send a beacon if it is due, and drop the nodes and messages that
+     * timed out
+     *
+     */
+    void maintain();
+
+    /**
+     * @brief Hand the complete messages to the receive callback
+     *
+     */
+    void deliverMessages();
+
+   public:
+    /**
+     * @brief Construct a new Esp Now Transport object
+     *
+     */
+    EspNowTransport();
+
+    /**
+     * @brief Initializes ESP-NOW, the mesh name, password and port are not
+     * used
+     *
+     */
+    bool init(string_t mesh_name,
+              string_t mesh_password,
+              Scheduler* scheduler_ptr,
+              uint16_t mesh_port) override;
+
+    void update() override;
+
+    uint32_t getNodeId() override;
+
+    uint32_t getNodeTime() override;
+
+    std::list<uint32_t> getNodeList(bool include_self = false) override;
+
+    bool sendBroadcast(string_t data) override;
+
+    bool sendSingle(uint32_t destination_node_id, string_t data) override;
+
+    void onReceive(received_callback_t on_receive) override;
+
+    void onChangedConnections(
+        changed_connections_callback_t on_changed_connections) override;
+
+    /////////////////////////////////////////////////
+    // Methods used only during testing
+    /////////////////////////////////////////////////
+
+#ifdef _RAMEN_UNIT_TESTING_
+
+    void setMeshTime(uint32_t time) override;
+
+    void incrementMeshTimeBy(uint32_t time) override;
+
+    void setNodeId(uint32_t node_id) override;
+
+    void addNeighbourNode(Transport& neighbour_node) override;
+
+    void checkForNewMessages() override;
+
+    std::list<std::pair<uint32_t, string_t>>& getMessageBuffer() override;
+
+#endif
+  };
+
+} // namespace transport
+} // namespace broth
+
+#endif
@@ -14,6 +14,8 @@ uint32_t LogHolder::getMatchIndex(uint32_t address) {
 };
 
 void LogHolder::setMatchIndex(uint32_t address, uint32_t index) {
+  RAMEN_ALLOCATION_SCOPE(LOG_HOLDER);
+
   (*(this->_match_index_ptr))[address] = index;
 };
 
@@ -21,25 +23,38 @@ uint32_t LogHolder::getNextIndex(uint32_t address) {
   return (*(this->_next_index_ptr))[address];
 };
 
+bool LogHolder::hasNextIndex(uint32_t address) {
+  return this->_next_index_ptr != NULL &&
+         this->_next_index_ptr->find(address) != this->_next_index_ptr->end();
+};
+
 void LogHolder::setNextIndex(uint32_t address, uint32_t index) {
+  RAMEN_ALLOCATION_SCOPE(LOG_HOLDER);
+
   (*(this->_next_index_ptr))[address] = index;
 };
 
 void LogHolder::advanceCommitIndex(uint32_t address) {};
 
-void LogHolder::resetMatchIndexMap(std::list<uint32_t> *node_list_ptr,
-                                   uint32_t index) {
+void LogHolder::resetMatchIndexMap(
+    const std::vector<uint32_t> *node_list_ptr, uint32_t index) {
+  RAMEN_ALLOCATION_SCOPE(LOG_HOLDER);
+
   delete this->_match_index_ptr;
   this->_match_index_ptr = new std::unordered_map<uint32_t, uint32_t>;
+  this->_match_index_ptr->reserve(node_list_ptr->size());
   for(auto it = node_list_ptr->begin(); it != node_list_ptr->end(); ++it) {
     this->_match_index_ptr->insert(std::make_pair(*it, index));
   }
 };
 
-void LogHolder::resetNextIndexMap(std::list<uint32_t> *node_list_ptr,
-                                  uint32_t index) {
+void LogHolder::resetNextIndexMap(
+    const std::vector<uint32_t> *node_list_ptr, uint32_t index) {
+  RAMEN_ALLOCATION_SCOPE(LOG_HOLDER);
+
   delete this->_next_index_ptr;
   this->_next_index_ptr = new std::unordered_map<uint32_t, uint32_t>;
+  this->_next_index_ptr->reserve(node_list_ptr->size());
   for(auto it = node_list_ptr->begin(); it != node_list_ptr->end(); ++it) {
     this->_next_index_ptr->insert(std::make_pair(*it, index));
   }
@@ -50,26 +65,78 @@ uint32_t LogHolder::getLogSize() {
 }
 
 uint32_t LogHolder::getLastLogTerm() {
-  return _entries.size() < 1 ? 0 : _entries.back().first;
+  return this->_term_runs.size() < 1 ? 0 : this->_term_runs.back().first;
 }
 
 uint32_t LogHolder::getLogTerm(uint32_t log_index) {
   if(log_index < 1 || log_index > this->_entries.size()) {
     return 0;
-  } else {
-    return _entries[log_index - 1].first;
   }
+
+  // The last run that starts at or before the index
+  auto run = std::upper_bound(
+      this->_term_runs.begin(),
+      this->_term_runs.end(),
+      log_index,
+      [](uint32_t index, const std::pair<uint32_t, uint32_t>& term_run) {
+        return index < term_run.second;
+      });
+
+  return (run - 1)->first;
+}
+
+uint32_t LogHolder::getFirstLogIndexOfTerm(uint32_t term) {
+  auto run = std::lower_bound(
+      this->_term_runs.begin(),
+      this->_term_runs.end(),
+      term,
+      [](const std::pair<uint32_t, uint32_t>& term_run, uint32_t term) {
+        return term_run.first < term;
+      });
+
+  if(run == this->_term_runs.end() || run->first != term) {
+    return 0;
+  }
+
+  return run->second;
+}
+
+uint32_t LogHolder::getLastLogIndexOfTerm(uint32_t term) {
+  auto run = std::lower_bound(
+      this->_term_runs.begin(),
+      this->_term_runs.end(),
+      term,
+      [](const std::pair<uint32_t, uint32_t>& term_run, uint32_t term) {
+        return term_run.first < term;
+      });
+
+  if(run == this->_term_runs.end() || run->first != term) {
+    return 0;
+  }
+
+  // The run ends where the next one starts
+  return (run + 1 == this->_term_runs.end()) ? this->_entries.size()
+                                             : (run + 1)->second - 1;
 }
 
-string_t LogHolder::getLogData(uint32_t log_index) {
+const string_t& LogHolder::getLogData(uint32_t log_index) {
+  static const string_t heart_beat_message = HEART_BEAT_MESSAGE;
+
   if(log_index < 1 || log_index > this->_entries.size()) {
-    return HEART_BEAT_MESSAGE;
+    return heart_beat_message;
   } else {
-    return _entries[log_index - 1].second;
+    return _entries[log_index - 1];
   }
 }
 
 uint32_t LogHolder::getMajorityCommitIndex() {
+  RAMEN_ALLOCATION_SCOPE(LOG_HOLDER);
+
+  // Without followers the leader is the majority
+  if(_match_index_ptr == NULL || _match_index_ptr->empty()) {
+    return this->getLogSize();
+  }
+
   std::vector<uint32_t> match_indices(_match_index_ptr->size());
   uint32_t i = 0;
 
@@ -88,8 +155,22 @@ uint32_t LogHolder::getMajorityCommitIndex() {
 
 void LogHolder::popEntry() {
   this->_entries.pop_back();
+
+  // Drop the run once its first entry is gone
+  if(this->_term_runs.back().second > this->_entries.size()) {
+    this->_term_runs.pop_back();
+  }
 }
 
-void LogHolder::pushEntry(std::pair<uint32_t, string_t> new_entry) {
-  this->_entries.push_back(new_entry);
+void LogHolder::pushEntry(std::pair<uint32_t, string_t>&& new_entry) {
+  RAMEN_ALLOCATION_SCOPE(LOG_HOLDER);
+
+  // A new term starts a new run
+  if(this->_term_runs.size() < 1 ||
+     this->_term_runs.back().first != new_entry.first) {
+    this->_term_runs.push_back(
+        std::make_pair(new_entry.first, this->_entries.size() + 1));
+  }
+
+  this->_entries.push_back(std::move(new_entry.second));
 }
\ No newline at end of file
@@ -22,8 +22,13 @@ namespace logholder {
    */
   class LogHolder {
    private:
-    // entries:{term, data}
-    std::vector<std::pair<uint32_t, string_t>> _entries;
+    // entries:{data}, the terms are kept in _term_runs
+    std::vector<string_t> _entries;
+
+    // term_runs:{term, index_of_first_entry_with_term}
+    // Terms never decrease in a Raft log, so consecutive entries mostly share
+    // a term and both fields are sorted
+    std::vector<std::pair<uint32_t, uint32_t>> _term_runs;
 
     // match_index_ptr:{server_id, index_of_last_recvd_log_entry_by_server_id}
     std::unordered_map<uint32_t, uint32_t> *_match_index_ptr = NULL;
@@ -63,6 +68,15 @@ namespace logholder {
      */
     uint32_t getNextIndex(uint32_t address);
 
+    /**
+     * @brief Whether a next index was set for the given server ID
+     *
+     * @param address
+     * @return true
+     * @return false
+     */
+    bool hasNextIndex(uint32_t address);
+
     /**
      * @brief Set the Next Index object
      *
@@ -81,16 +95,18 @@ namespace logholder {
     /**
      * @brief  Set the match index for all nodes to 0
      *
-     * @param nodeList Node list obtained from painlessMesh
+     * @param nodeList Node list obtained from the mesh network
      */
-    void resetMatchIndexMap(std::list<uint32_t> *node_list_ptr, uint32_t index);
+    void resetMatchIndexMap(const std::vector<uint32_t> *node_list_ptr,
+                            uint32_t index);
 
     /**
      * @brief  Set the next index for all nodes to 1
      *
-     * @param nodeList Node list obtained from painlessMesh
+     * @param nodeList Node list obtained from the mesh network
      */
-    void resetNextIndexMap(std::list<uint32_t> *node_list_ptr, uint32_t index);
+    void resetNextIndexMap(const std::vector<uint32_t> *node_list_ptr,
+                           uint32_t index);
 
     /**
      * @brief Get the size of the entries
@@ -114,14 +130,32 @@ namespace logholder {
      */
     uint32_t getLogTerm(uint32_t log_index);
 
+    /**
+     * @brief Get the index of the first entry with the given term
+     *
+     * @param term
+     * @return uint32_t 0 if the log has no entry with the term
+     */
+    uint32_t getFirstLogIndexOfTerm(uint32_t term);
+
+    /**
+     * @brief Get the index of the last entry with the given term
+     *
+     * @param term
+     * @return uint32_t 0 if the log has no entry with the term
+     */
+    uint32_t getLastLogIndexOfTerm(uint32_t term);
+
     /**
      * @brief Get the data in entries vector given the index.
      * If the index does not exist, then return a heartbeat message.
+     * The reference is valid until the entry is popped or another entry is
+     * pushed.
      *
      * @param log_index
-     * @return string_t
+     * @return const string_t&
      */
-    string_t getLogData(uint32_t log_index);
+    const string_t& getLogData(uint32_t log_index);
 
     /**
      * @brief Extract the index of last received log entries by all servers from
@@ -132,7 +166,7 @@ namespace logholder {
      * "A log entry is committed once the leader that created the entry has
      * replicated it on a majority of the servers"
      *
-     * @return uint32_t
+     * @return uint32_t The log size if there are no other servers
      */
     uint32_t getMajorityCommitIndex();
 
@@ -143,11 +177,12 @@ namespace logholder {
     void popEntry();
 
     /**
-     * @brief Push a new entry into _entries
+     * @brief Push a new entry into _entries, the data is moved into the log
+     * instead of being copied
      *
      * @param new_entry
      */
-    void pushEntry(std::pair<uint32_t, string_t> new_entry);
+    void pushEntry(std::pair<uint32_t, string_t>&& new_entry);
   };
 
 } // namespace logholder
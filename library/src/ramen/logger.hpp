@@ -10,6 +10,20 @@
 
 #include "ramen/configuration.hpp"
 
+/**
+ * Log through the given logger. Calls below RAMEN_MIN_LOG_LEVEL are removed by
+ * the compiler, and the arguments of calls below either that or the logging
+ * level of the logger are not evaluated.
+ *
+ * RAMEN_LOG(this->_logger, DEBUG, "Sent %u bytes\n", size);
+ */
+#define RAMEN_LOG(logger, level, ...)                                   \
+  do {                                                                  \
+    if((level) >= RAMEN_MIN_LOG_LEVEL && (logger).isEnabled((level))) { \
+      (logger)((level), __VA_ARGS__);                                   \
+    }                                                                   \
+  } while(0)
+
 namespace broth {
 namespace logger {
 
@@ -83,7 +97,20 @@ namespace logger {
     };
 
     /**
-     * @brief Overloads the () operator to log messages.
+     * @brief Checks if messages of the given level are printed, both by the
+     * logging level and by RAMEN_MIN_LOG_LEVEL
+     *
+     * @param given_level
+     * @return true
+     * @return false
+     */
+    bool isEnabled(LogLevel given_level) {
+      return given_level >= RAMEN_MIN_LOG_LEVEL && given_level >= _level;
+    }
+
+    /**
+     * @brief Overloads the () operator to log messages. Use RAMEN_LOG() in hot
+     * paths, so that the arguments are not evaluated for removed levels.
      * Example usage:
      *
      * broth::Logger Log;
@@ -94,14 +121,14 @@ namespace logger {
      * @param format The message itself
      */
     void operator()(LogLevel given_level, const char* format_ptr...) {
-      va_list args;
-      va_start(args, format_ptr);
-
-      vsnprintf(_str, 200, format_ptr, args);
-
       // Print the message if the logging level is equal or higher than the
-      // set logging level
-      if(given_level >= _level) {
+      // set logging level, the message is only formatted if it is printed
+      if(this->isEnabled(given_level)) {
+        va_list args;
+        va_start(args, format_ptr);
+        vsnprintf(_str, 200, format_ptr, args);
+        va_end(args);
+
 // clang-format off
         // Print the id of the node while testing
         #ifdef _RAMEN_UNIT_TESTING_
@@ -137,8 +164,6 @@ namespace logger {
 
         this->_printed_output = true;
       }
-
-      va_end(args);
     }
 
     /**
@@ -157,7 +182,7 @@ namespace logger {
     void operator()(LogLevel given_level, string_t& message) {
       // Print the message if the logging level is equal or higher than the
       // set logging level
-      if(given_level >= _level) {
+      if(this->isEnabled(given_level)) {
 // clang-format off
         // Print the id of the node while testing
         #ifdef _RAMEN_UNIT_TESTING_
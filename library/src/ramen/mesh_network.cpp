@@ -5,174 +5,455 @@
  */
 #include "ramen/mesh_network.hpp"
 
+#include <cstring>
+
 using _meshnetwork = broth::meshnetwork::MeshNetwork;
 using namespace broth::logger;
 
-_meshnetwork::MeshNetwork() {
+static string_t substring(const string_t& data, uint32_t begin, uint32_t end) {
+#ifdef _RAMEN_UNIT_TESTING_
+  return data.substr(begin, end - begin);
+#else
+  return data.substring(begin, end);
+#endif
+}
 
+_meshnetwork::MeshNetwork() {
+  this->_client_bucket.init(CLIENT_MESSAGE_RATE, CLIENT_MESSAGE_BURST);
 };
 
-bool _meshnetwork::init(MeshNetworkType mesh_network_type,
-                        string_t mesh_name,
-                        string_t mesh_password,
-                        uint16_t mesh_port,
-                        uint8_t logging_level) {
-  this->_logger.setLogLevel(logging_level);
+_meshnetwork::~MeshNetwork() {
+  if(this->_owns_transport) {
+    delete this->_transport_ptr;
+  }
+};
 
-  // Set mesh network type
-  this->_selected_mesh_network_type = mesh_network_type;
+bool _meshnetwork::setTransport(MeshNetworkType mesh_network_type) {
+  Transport* transport_ptr;
 
-  // Initialize selected mesh network
-  switch(this->_selected_mesh_network_type) {
+  switch(mesh_network_type) {
     case PAINLESSMESH:
-      this->_painless_mesh.init(mesh_name,
-                                mesh_password,
-                                &_scheduler,
-                                mesh_port);
-
-      this->_node_id = this->_painless_mesh.getNodeId();
+      transport_ptr = new PainlessMeshTransport();
+      break;
 
-      this->_logger(DEBUG, "Just initialized painlessMesh!\n");
+    case ESPNOW:
+      transport_ptr = new EspNowTransport();
       break;
 
     default:
       // A wrong mesh type was specified
-      this->_logger(WARNING,
-                    "(init) Selected mesh network type does not exist!\n");
+      RAMEN_LOG(this->_logger,
+                WARNING,
+                "(setTransport) Selected mesh network type does not exist!\n");
       return false;
       break;
   }
 
+  this->setTransport(transport_ptr);
+  this->_owns_transport = true;
+
   return true;
 };
 
-bool _meshnetwork::update() {
-  switch(this->_selected_mesh_network_type) {
-    case PAINLESSMESH:
-      this->_painless_mesh.update();
-      break;
+void _meshnetwork::setTransport(Transport* transport_ptr) {
+  if(this->_owns_transport) {
+    delete this->_transport_ptr;
+  }
 
-    default:
-      // A wrong mesh type was specified
-      this->_logger(WARNING,
-                    "(update) Selected mesh network type does not exist!\n");
-      return false;
-      break;
+  this->_transport_ptr = transport_ptr;
+  this->_owns_transport = false;
+  this->_topology_changed = true;
+  this->_node_list_changed = true;
+};
+
+bool _meshnetwork::init(string_t mesh_name,
+                        string_t mesh_password,
+                        uint16_t mesh_port,
+                        uint8_t logging_level) {
+  RAMEN_ALLOCATION_SCOPE(MESH_NETWORK);
+
+  this->_logger.setLogLevel(logging_level);
+
+  // Default to painlessMesh
+  if(this->_transport_ptr == NULL) {
+    this->setTransport(PAINLESSMESH);
   }
 
+  if(!this->_transport_ptr->init(
+         mesh_name, mesh_password, &this->_scheduler, mesh_port)) {
+    RAMEN_LOG(this->_logger,
+              WARNING,
+              "(init) Could not initialize the transport!\n");
+    return false;
+  }
+
+  this->_node_id = this->_transport_ptr->getNodeId();
+  this->_node_list_changed = true;
+
+  // The hop counts and the node list are recalculated on the next request
+  this->_transport_ptr->onChangedConnections([&]() {
+    this->_topology_changed = true;
+    this->_node_list_changed = true;
+  });
+
+  RAMEN_LOG(this->_logger, DEBUG, "Just initialized the transport!\n");
+
   return true;
 };
 
-uint32_t _meshnetwork::getNodeId() {
-  switch(this->_selected_mesh_network_type) {
-    case PAINLESSMESH:
-      return this->_painless_mesh.getNodeId();
-      break;
+bool _meshnetwork::init(MeshNetworkType mesh_network_type,
+                        string_t mesh_name,
+                        string_t mesh_password,
+                        uint16_t mesh_port,
+                        uint8_t logging_level) {
+  this->_logger.setLogLevel(logging_level);
 
-    default:
-      // A wrong mesh type was specified
-      this->_logger(WARNING,
-                    "(getNodeId) Selected mesh network type does not exist!\n");
-      return 0;
-      break;
+  if(!this->setTransport(mesh_network_type)) {
+    return false;
   }
+
+  return this->init(mesh_name, mesh_password, mesh_port, logging_level);
 };
 
-uint32_t _meshnetwork::getNodeTime() {
-  switch(this->_selected_mesh_network_type) {
-    case PAINLESSMESH:
-      return this->_painless_mesh.getNodeTime();
-      break;
+bool _meshnetwork::update() {
+  if(this->_transport_ptr == NULL) {
+    RAMEN_LOG(this->_logger, WARNING, "(update) No transport was selected!\n");
+    return false;
+  }
 
-    default:
-      // A wrong mesh type was specified
-      this->_logger(
-          WARNING,
-          "(getNodeTime) Selected mesh network type does not exist!\n");
-      return 0;
-      break;
+  // Everything sent while the transport runs its callbacks and tasks is held
+  // back, so that messages to the same node share a packet
+  this->_coalescing = true;
+  this->_transport_ptr->update();
+  this->_coalescing = false;
+  this->sendQueuedMessages(CLIENT);
+
+  return true;
+};
+
+Scheduler& _meshnetwork::getScheduler() {
+  return this->_scheduler;
+};
+
+uint32_t _meshnetwork::getNodeId() {
+  if(this->_transport_ptr == NULL) {
+    RAMEN_LOG(this->_logger,
+              WARNING,
+              "(getNodeId) No transport was selected!\n");
+    return 0;
   }
+
+  return this->_transport_ptr->getNodeId();
+};
+
+uint32_t _meshnetwork::getNodeTime() {
+  if(this->_transport_ptr == NULL) {
+    RAMEN_LOG(this->_logger,
+              WARNING,
+              "(getNodeTime) No transport was selected!\n");
+    return 0;
+  }
+
+  return this->_transport_ptr->getNodeTime();
 };
 
 uint32_t _meshnetwork::getMeshTime() {
-  switch(this->_selected_mesh_network_type) {
-    case PAINLESSMESH:
-      return this->_painless_mesh.getNodeTime();
-      break;
+  if(this->_transport_ptr == NULL) {
+    RAMEN_LOG(this->_logger,
+              WARNING,
+              "(getMeshTime) No transport was selected!\n");
+    return 0;
+  }
 
-    default:
-      // A wrong mesh type was specified
-      this->_logger(
-          WARNING,
-          "(getMeshTime) Selected mesh network type does not exist!\n");
-      return 0;
-      break;
+  return this->_transport_ptr->getNodeTime();
+};
+
+const std::vector<uint32_t>& _meshnetwork::getNodeList(bool include_self) {
+  if(this->_transport_ptr == NULL) {
+    RAMEN_LOG(this->_logger,
+              WARNING,
+              "(getNodeList) No transport was selected!\n");
+    this->_node_list.clear();
+    this->_node_list_with_self.clear();
+  } else {
+    this->updateNodeList();
   }
+
+  return include_self ? this->_node_list_with_self : this->_node_list;
 };
 
-std::list<uint32_t> _meshnetwork::getNodeList(bool include_self) {
-  switch(this->_selected_mesh_network_type) {
-    case PAINLESSMESH:
-      return this->_painless_mesh.getNodeList(include_self);
-      break;
+uint32_t _meshnetwork::getNodeListGeneration() {
+  if(this->_transport_ptr != NULL) {
+    this->updateNodeList();
+  }
 
-    default:
-      // A wrong mesh type was specified
-      this->_logger(
-          WARNING,
-          "(getNodeList) Selected mesh network type does not exist!\n");
-      return std::list<uint32_t>();
-      break;
+  return this->_node_list_generation;
+};
+
+void _meshnetwork::updateNodeList() {
+  RAMEN_ALLOCATION_SCOPE(MESH_NETWORK);
+
+  if(!this->_node_list_changed) {
+    return;
+  }
+
+  // Only the transport's own list is copied, once per change
+  auto node_list = this->_transport_ptr->getNodeList(false);
+  std::vector<uint32_t> new_node_list(node_list.begin(), node_list.end());
+
+  if(new_node_list != this->_node_list) {
+    this->_node_list.swap(new_node_list);
+    ++this->_node_list_generation;
+  }
+
+  this->_node_list_with_self = this->_node_list;
+  this->_node_list_with_self.push_back(this->_transport_ptr->getNodeId());
+  this->_node_list_changed = false;
+};
+
+float _meshnetwork::getAverageHopCount() {
+  if(!this->_topology_changed) {
+    return this->_average_hop_count;
+  }
+
+  if(this->_transport_ptr == NULL) {
+    RAMEN_LOG(this->_logger,
+              WARNING,
+              "(getAverageHopCount) No transport was selected!\n");
+    return 0;
   }
+
+  this->_average_hop_count = broth::utils::getAverageNodeTreeDepth(
+      this->_transport_ptr->subConnectionJson());
+  this->_topology_changed = false;
+
+  RAMEN_LOG(this->_logger,
+            DEBUG,
+            "Average hop count to the other nodes is %.2f\n",
+            this->_average_hop_count);
+
+  return this->_average_hop_count;
 };
 
 bool _meshnetwork::sendBroadcast(string_t data) {
-  switch(this->_selected_mesh_network_type) {
-    case PAINLESSMESH:
-      return this->_painless_mesh.sendBroadcast(data);
-      break;
+  RAMEN_ALLOCATION_SCOPE(MESH_NETWORK);
 
-    default:
-      // A wrong mesh type was specified
-      this->_logger(
-          WARNING,
-          "(sendBroadcast) Selected mesh network type does not exist!\n");
-      return false;
-      break;
+  if(this->_transport_ptr == NULL) {
+    RAMEN_LOG(this->_logger,
+              WARNING,
+              "(sendBroadcast) No transport was selected!\n");
+    return false;
   }
+
+  // Broadcasts are control messages, keep their order with the ones that are
+  // held back for single nodes
+  this->sendQueuedMessages(CONTROL);
+
+  return this->_transport_ptr->sendBroadcast(data);
 };
 
 bool _meshnetwork::sendMessageToNode(uint32_t destination_node_id,
-                                     string_t data) {
-  switch(this->_selected_mesh_network_type) {
-    case PAINLESSMESH:
-      return this->_painless_mesh.sendSingle(destination_node_id, data);
-      break;
+                                     string_t data,
+                                     MessagePriority priority) {
+  RAMEN_ALLOCATION_SCOPE(MESH_NETWORK);
+
+  if(this->_transport_ptr == NULL) {
+    RAMEN_LOG(this->_logger,
+              WARNING,
+              "(sendMessageToNode) No transport was selected!\n");
+    return false;
+  }
 
-    default:
-      // A wrong mesh type was specified
-      this->_logger(
-          WARNING,
-          "(sendMessageToNode) Selected mesh network type does not exist!\n");
-      return false;
-      break;
+  if(!this->_coalescing && priority == CONTROL) {
+    return this->_transport_ptr->sendSingle(destination_node_id, data);
+  }
+
+  // A full queue pushes back on the caller, a single message always fits
+  uint32_t& queue_size = this->_send_queue_sizes[priority];
+  if(priority != CONTROL && queue_size > 0 &&
+     queue_size + data.length() > SEND_QUEUE_MAX_SIZE) {
+    RAMEN_LOG(this->_logger,
+              DEBUG,
+              "Refused a message to %u, the send queue is full\n",
+              destination_node_id);
+    return false;
+  }
+
+  queue_size += data.length();
+  this->_send_queues[priority].push_back(
+      std::make_pair(destination_node_id, data));
+
+  // Outside of update() bulk messages go out right away if the budget allows
+  if(!this->_coalescing) {
+    this->sendQueuedMessages(CLIENT);
   }
+
+  return true;
 };
 
-void _meshnetwork::onReceiveCallback(received_callback_t on_receive) {
-  switch(this->_selected_mesh_network_type) {
-    case PAINLESSMESH:
-      this->_painless_mesh.onReceive(on_receive);
-      break;
+void _meshnetwork::sendQueuedMessages(MessagePriority lowest_priority) {
+  RAMEN_ALLOCATION_SCOPE(MESH_NETWORK);
 
-    default:
-      // A wrong mesh type was specified
-      this->_logger(WARNING,
-                    "(onReceive) Selected mesh network type does not exist!\n");
-      break;
+  uint32_t current_time = this->getNodeTime();
+
+  for(uint8_t priority = CONTROL; priority <= lowest_priority; ++priority) {
+    auto& queue = this->_send_queues[priority];
+
+    while(queue.size() > 0) {
+      auto& message = queue.front();
+
+      // Client messages that are over the budget wait for the next update()
+      if(priority == CLIENT &&
+         !this->_client_bucket.consume(message.second.length(), current_time)) {
+        this->sendPackets();
+        return;
+      }
+
+      this->_send_queue_sizes[priority] -= message.second.length();
+      this->addToPacket(message.first, message.second);
+      queue.pop_front();
+    }
+
+    // Higher priority packets leave first
+    this->sendPackets();
   }
 };
 
+void _meshnetwork::addToPacket(uint32_t destination_node_id,
+                               string_t& data) {
+  RAMEN_ALLOCATION_SCOPE(MESH_NETWORK);
+
+  // Length of the message, its digits and the separator
+  char length[11];
+  snprintf(length, sizeof(length), "%u", (uint32_t) data.length());
+  uint32_t framed_size = data.length() + strlen(length) + 1;
+
+  OutboundPacket& packet = this->_outbound_packets[destination_node_id];
+
+  // Make room if the packet would get too large
+  if(packet.messages.size() > 0 &&
+     packet.size + framed_size > MESSAGE_COALESCING_MAX_SIZE) {
+    this->sendPacket(destination_node_id, packet);
+  }
+
+  packet.messages.push_back(std::move(data));
+  packet.size += framed_size;
+
+  // Messages that are too large on their own are not held back
+  if(packet.size > MESSAGE_COALESCING_MAX_SIZE) {
+    this->sendPacket(destination_node_id, packet);
+  }
+};
+
+bool _meshnetwork::sendPacket(uint32_t destination_node_id,
+                              OutboundPacket& packet) {
+  RAMEN_ALLOCATION_SCOPE(MESH_NETWORK);
+
+  bool success;
+
+  if(packet.messages.size() == 1) {
+    success = this->_transport_ptr->sendSingle(destination_node_id,
+                                               packet.messages.front());
+  } else {
+    // | marker | length | : | message | length | : | message | ...
+    string_t data;
+    char length[11];
+
+    data += COALESCED_PACKET_MARKER;
+    for(auto& message : packet.messages) {
+      snprintf(length, sizeof(length), "%u", (uint32_t) message.length());
+      data += length;
+      data += ':';
+      data += message;
+    }
+
+    RAMEN_LOG(this->_logger,
+              DEBUG,
+              "Coalesced %u messages to %u\n",
+              (uint32_t) packet.messages.size(),
+              destination_node_id);
+
+    success = this->_transport_ptr->sendSingle(destination_node_id, data);
+  }
+
+  if(!success && this->_send_failure_callback) {
+    this->_send_failure_callback(destination_node_id, packet.messages.size());
+  }
+
+  packet.messages.clear();
+  packet.size = 1;
+
+  return success;
+};
+
+void _meshnetwork::sendPackets() {
+  for(auto it = this->_outbound_packets.begin();
+      it != this->_outbound_packets.end();
+      ++it) {
+    if(it->second.messages.size() > 0) {
+      this->sendPacket(it->first, it->second);
+    }
+  }
+};
+
+void _meshnetwork::handlePacket(uint32_t from, string_t& data) {
+  RAMEN_ALLOCATION_SCOPE(MESH_NETWORK);
+
+  if(!this->_received_callback) {
+    return;
+  }
+
+  if(data.length() == 0 || data[0] != COALESCED_PACKET_MARKER) {
+    this->_received_callback(from, data);
+    return;
+  }
+
+  const char* packet = data.c_str();
+  uint32_t packet_size = data.length();
+  uint32_t position = 1;
+
+  while(position < packet_size) {
+    uint32_t length = 0;
+    while(position < packet_size && packet[position] >= '0' &&
+          packet[position] <= '9') {
+      length = length * 10 + (packet[position] - '0');
+      ++position;
+    }
+
+    if(position >= packet_size || packet[position] != ':' ||
+       length > packet_size - position - 1) {
+      RAMEN_LOG(this->_logger,
+                WARNING,
+                "Dropped a malformed packet from %u\n",
+                from);
+      return;
+    }
+    ++position;
+
+    string_t message = substring(data, position, position + length);
+    position += length;
+
+    this->_received_callback(from, message);
+  }
+};
+
+void _meshnetwork::onReceiveCallback(received_callback_t on_receive) {
+  if(this->_transport_ptr == NULL) {
+    RAMEN_LOG(this->_logger,
+              WARNING,
+              "(onReceive) No transport was selected!\n");
+    return;
+  }
+
+  this->_received_callback = on_receive;
+  this->_transport_ptr->onReceive(
+      [&](uint32_t from, string_t& data) { this->handlePacket(from, data); });
+};
+
+void _meshnetwork::onSendFailure(send_failure_callback_t on_send_failure) {
+  this->_send_failure_callback = on_send_failure;
+};
+
   /////////////////////////////////////////////////
   // Methods used only during testing
   /////////////////////////////////////////////////
@@ -180,80 +461,88 @@ void _meshnetwork::onReceiveCallback(received_callback_t on_receive) {
 #ifdef _RAMEN_UNIT_TESTING_
 
 void _meshnetwork::setMeshTime(uint32_t time) {
-  switch(this->_selected_mesh_network_type) {
-    case PAINLESSMESH:
-      this->_painless_mesh.setMeshTime(time);
-      break;
-
-    default:
-      // A wrong mesh type was specified
-      this->_logger(
-          WARNING,
-          "(addNeighbourNode) Selected mesh network type does not exist!\n");
-      break;
+  if(this->_transport_ptr == NULL) {
+    RAMEN_LOG(this->_logger,
+              WARNING,
+              "(setMeshTime) No transport was selected!\n");
+    return;
   }
+
+  this->_transport_ptr->setMeshTime(time);
 };
 
 void _meshnetwork::incrementMeshTimeBy(uint32_t time) {
-  switch(this->_selected_mesh_network_type) {
-    case PAINLESSMESH:
-      this->_painless_mesh.incrementMeshTimeBy(time);
-      break;
-
-    default:
-      // A wrong mesh type was specified
-      this->_logger(
-          WARNING,
-          "(addNeighbourNode) Selected mesh network type does not exist!\n");
-      break;
+  if(this->_transport_ptr == NULL) {
+    RAMEN_LOG(this->_logger,
+              WARNING,
+              "(incrementMeshTimeBy) No transport was selected!\n");
+    return;
   }
+
+  this->_transport_ptr->incrementMeshTimeBy(time);
 };
 
 void _meshnetwork::setNodeId(uint32_t node_id) {
   this->_node_id = node_id;
+  this->_node_list_changed = true;
 
-  switch(this->_selected_mesh_network_type) {
-    case PAINLESSMESH:
-      this->_painless_mesh.setNodeId(node_id);
-      break;
-
-    default:
-      // A wrong mesh type was specified
-      this->_logger(
-          WARNING,
-          "(addNeighbourNode) Selected mesh network type does not exist!\n");
-      break;
+  if(this->_transport_ptr == NULL) {
+    RAMEN_LOG(this->_logger,
+              WARNING,
+              "(setNodeId) No transport was selected!\n");
+    return;
   }
+
+  this->_transport_ptr->setNodeId(node_id);
 };
 
 void _meshnetwork::addNeighbourNode(MeshNetwork& neighbour_node) {
-  switch(this->_selected_mesh_network_type) {
-    case PAINLESSMESH:
-      this->_painless_mesh.addNeighbourNode(neighbour_node._painless_mesh);
-      break;
-
-    default:
-      // A wrong mesh type was specified
-      this->_logger(
-          WARNING,
-          "(addNeighbourNode) Selected mesh network type does not exist!\n");
-      break;
+  if(this->_transport_ptr == NULL || neighbour_node._transport_ptr == NULL) {
+    RAMEN_LOG(this->_logger,
+              WARNING,
+              "(addNeighbourNode) No transport was selected!\n");
+    return;
   }
+
+  this->_transport_ptr->addNeighbourNode(*neighbour_node._transport_ptr);
 };
 
 void _meshnetwork::checkForNewMessages() {
-  switch(this->_selected_mesh_network_type) {
-    case PAINLESSMESH:
-      this->_painless_mesh.checkForNewMessages();
-      break;
+  if(this->_transport_ptr == NULL) {
+    RAMEN_LOG(this->_logger,
+              WARNING,
+              "(checkForNewMessages) No transport was selected!\n");
+    return;
+  }
 
-    default:
-      // A wrong mesh type was specified
-      this->_logger(
-          WARNING,
-          "(addNeighbourNode) Selected mesh network type does not exist!\n");
-      break;
+  this->_transport_ptr->checkForNewMessages();
+};
+
+bool _meshnetwork::hasQueuedMessages() {
+  for(auto& queue : this->_send_queues) {
+    if(queue.size() > 0) {
+      return true;
+    }
   }
+
+  return false;
+};
+
+void _meshnetwork::dropMessages() {
+  for(uint8_t priority = CONTROL; priority <= CLIENT; ++priority) {
+    this->_send_queues[priority].clear();
+    this->_send_queue_sizes[priority] = 0;
+  }
+  this->_outbound_packets.clear();
+  this->_client_bucket.init(CLIENT_MESSAGE_RATE, CLIENT_MESSAGE_BURST);
+
+  if(this->_transport_ptr != NULL) {
+    this->_transport_ptr->getMessageBuffer().clear();
+  }
+};
+
+std::list<std::pair<uint32_t, string_t>>& _meshnetwork::getMessageBuffer() {
+  return this->_transport_ptr->getMessageBuffer();
 };
 
-#endif
\ No newline at end of file
+#endif
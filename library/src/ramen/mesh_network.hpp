@@ -6,37 +6,136 @@
 #ifndef _RAMEN_MESH_NETWORK_HPP_
 #define _RAMEN_MESH_NETWORK_HPP_
 
+#include <map>
+#include <vector>
+
 #include "ramen/configuration.hpp"
+#include "ramen/espnow_transport.hpp"
 #include "ramen/logger.hpp"
+#include "ramen/painless_mesh_transport.hpp"
+#include "ramen/transport.hpp"
+#include "ramen/utils.hpp"
 
 namespace broth {
 namespace meshnetwork {
   using namespace broth::logger;
+  using namespace broth::transport;
 
   /**
    * @brief Holds the mesh network name mapping
    *
    */
-  typedef enum { PAINLESSMESH = 0 } MeshNetworkType;
+  typedef enum { PAINLESSMESH = 0, ESPNOW = 1 } MeshNetworkType;
 
   /**
-   * @brief Structure for defining the callback argument type
+   * @brief Priority classes of the messages sent to single nodes. Control
+   * messages are sent first and never held back, then the replication
+   * messages, and the client messages as far as their budget allows.
    *
    */
-  typedef std::function<void(uint32_t from, string_t& data)>
-      received_callback_t;
+  typedef enum { CONTROL = 0, REPLICATION = 1, CLIENT = 2 } MessagePriority;
 
   /**
-   * @brief Abstraction layer for the mesh network underneath
+   * @brief Structure for defining the send failure callback type
+   *
+   */
+  typedef std::function<void(uint32_t destination, uint32_t messages)>
+      send_failure_callback_t;
+
+  /**
+   * @brief Abstraction layer for the mesh network underneath, the actual work
+   * is done by the selected transport
    *
    */
   class MeshNetwork {
    private:
+    /**
+     * @brief Messages waiting to be sent to the same node as one packet
+     *
+     */
+    struct OutboundPacket {
+      std::vector<string_t> messages;
+      // Size of the packet once the messages are framed
+      uint32_t size = 1;
+    };
+
     uint32_t _node_id;
     Scheduler _scheduler;
     Logger _logger;
-    MeshNetworkType _selected_mesh_network_type;
-    painlessMesh _painless_mesh;
+    Transport* _transport_ptr = NULL;
+    // Whether the transport was created by setTransport(MeshNetworkType)
+    bool _owns_transport = false;
+    float _average_hop_count = 0;
+    bool _topology_changed = true;
+    // Cached copies of the transport's node list, refreshed only after the
+    // connections in the network change
+    std::vector<uint32_t> _node_list;
+    std::vector<uint32_t> _node_list_with_self;
+    uint32_t _node_list_generation = 0;
+    bool _node_list_changed = true;
+    received_callback_t _received_callback;
+    send_failure_callback_t _send_failure_callback;
+    // Messages sent during update() are held back until the end of it
+    bool _coalescing = false;
+    // send_queues:[priority]{destination_node_id, message}
+    std::list<std::pair<uint32_t, string_t>> _send_queues[CLIENT + 1];
+    // Bytes of the messages in each send queue
+    uint32_t _send_queue_sizes[CLIENT + 1] = {0};
+    // outbound_packets:{destination_node_id, messages_for_destination}
+    std::map<uint32_t, OutboundPacket> _outbound_packets;
+    // Budget of the client messages in bytes
+    broth::utils::TokenBucket _client_bucket;
+
+    /**
+     * @brief Copy the node list of the transport into the cache if the
+     * connections changed since the last copy, and bump the generation if the
+     * nodes are different
+     *
+     */
+    void updateNodeList();
+
+    /**
+     * @brief Send the queued messages from the highest priority down to the
+     * given one, as long as the client budget allows
+     *
+     * @param lowest_priority
+     */
+    void sendQueuedMessages(MessagePriority lowest_priority);
+
+    /**
+     * @brief Add a message to the packet of its destination, sending the
+     * packet first if it would grow too large
+     *
+     * @param destination_node_id
+     * @param data The message, which is moved into the packet
+     */
+    void addToPacket(uint32_t destination_node_id, string_t& data);
+
+    /**
+     * @brief Send the messages held back for the given node, on their own if
+     * there is only one, as a coalesced packet otherwise
+     *
+     * @param destination_node_id
+     * @param packet
+     * @return true
+     * @return false
+     */
+    bool sendPacket(uint32_t destination_node_id, OutboundPacket& packet);
+
+    /**
+     * @brief Send all packets that have messages
+     *
+     */
+    void sendPackets();
+
+    /**
+     * @brief Split a received packet into its messages and hand them to the
+     * receive callback one by one
+     *
+     * @param from
+     * @param data
+     */
+    void handlePacket(uint32_t from, string_t& data);
 
    public:
     /**
@@ -45,6 +144,54 @@ namespace meshnetwork {
      */
     MeshNetwork();
 
+    /**
+     * @brief Destroy the Mesh Network object
+     *
+     */
+    ~MeshNetwork();
+
+    /**
+     * @brief The mesh network may own its transport, so it can't be copied
+     *
+     */
+    MeshNetwork(const MeshNetwork&) = delete;
+    MeshNetwork& operator=(const MeshNetwork&) = delete;
+
+    /**
+     * @brief Select one of the built-in transports
+     * Return true if the operation was successful, false otherwise
+     *
+     * @param mesh_network_type Type of the mesh network to use
+     * @return true
+     * @return false
+     */
+    bool setTransport(MeshNetworkType mesh_network_type);
+
+    /**
+     * @brief Select a user-defined transport, which has to outlive the mesh
+     * network
+     *
+     * @param transport_ptr
+     */
+    void setTransport(Transport* transport_ptr);
+
+    /**
+     * @brief Initializes the selected transport, painlessMesh is used if no
+     * transport was selected
+     * Return true if the operation was successful, false otherwise
+     *
+     * @param mesh_name Name of the mesh network
+     * @param mesh_password Password for the mesh network
+     * @param mesh_port Port for the mesh network
+     * @param logging_level Logging level for the system messages
+     * @return true
+     * @return false
+     */
+    bool init(string_t mesh_name,
+              string_t mesh_password,
+              uint16_t mesh_port,
+              uint8_t logging_level = INFO);
+
     /**
      * @brief Initializes the choosen mesh network
      * Return true if the operation was successful, false otherwise
@@ -64,7 +211,9 @@ namespace meshnetwork {
               uint8_t logging_level = INFO);
 
     /**
-     * @brief Calls the update function for the mesh network, if there is any
+     * @brief Calls the update function for the mesh network, if there is any.
+     * Messages sent to the same node while updating are coalesced into as few
+     * packets as possible, which are sent before returning.
      * Return true if the operation was successful, false otherwise
      *
      * @return true
@@ -72,6 +221,14 @@ namespace meshnetwork {
      */
     bool update();
 
+    /**
+     * @brief Get the scheduler that the mesh network runs on every update(),
+     * tasks added to it are executed when they are due
+     *
+     * @return Scheduler&
+     */
+    Scheduler& getScheduler();
+
     /**
      * @brief Get the ID of the current node
      *
@@ -95,13 +252,31 @@ namespace meshnetwork {
     uint32_t getMeshTime();
 
     /**
-     * @brief Get the current list of nodes in the network
+     * @brief Get the current list of nodes in the network. The list is cached
+     * and stays valid until the next update().
      *
      * @param include_self Whether to include the current node to the list or
      * not
-     * @return std::list<uint32_t>
+     * @return const std::vector<uint32_t>&
+     */
+    const std::vector<uint32_t>& getNodeList(bool include_self = false);
+
+    /**
+     * @brief Get a counter that is incremented every time the node list
+     * changes, to check for new or dropped nodes without comparing the lists
+     *
+     * @return uint32_t
+     */
+    uint32_t getNodeListGeneration();
+
+    /**
+     * @brief Get the average number of hops from the current node to the other
+     * nodes in the network. It is recalculated only after the connections in
+     * the network change.
+     *
+     * @return float 0 if there are no other nodes
      */
-    std::list<uint32_t> getNodeList(bool include_self = false);
+    float getAverageHopCount();
 
     /**
      * @brief Send data to all nodes in the mesh network
@@ -113,24 +288,42 @@ namespace meshnetwork {
     bool sendBroadcast(string_t data);
 
     /**
-     * @brief Send data to a specific node with the given node ID
+     * @brief Send data to a specific node with the given node ID. Client
+     * messages are rate limited to CLIENT_MESSAGE_RATE bytes per second, and
+     * wait for a later update() when over the budget.
      *
      * @param destination_node_id The node to deliver the data to
      * @param data Data to send
-     * @return true
-     * @return false
+     * @param priority Priority class of the message
+     * @return true If the message was sent, or queued to be sent later. Queued
+     * messages that the transport fails to send are reported to
+     * onSendFailure().
+     * @return false If the transport failed, or the queue of a replication or
+     * client message is full
      */
-    bool sendMessageToNode(uint32_t destination_node_id, string_t data);
+    bool sendMessageToNode(uint32_t destination_node_id,
+                           string_t data,
+                           MessagePriority priority = CONTROL);
 
     /**
      * @brief The callback function which will be called when data is received
-     * from another node
+     * from another node, once for every message of a coalesced packet
      *
      * @param on_receive A function that takes two arguments, you can use a
      * lambda function
      */
     void onReceiveCallback(received_callback_t on_receive);
 
+    /**
+     * @brief The callback function which will be called when the transport
+     * fails to send messages that were queued or held back, since their
+     * sendMessageToNode() already returned true
+     *
+     * @param on_send_failure A function that takes the destination and the
+     * number of messages that were lost
+     */
+    void onSendFailure(send_failure_callback_t on_send_failure);
+
     /////////////////////////////////////////////////
     // Methods used only during testing
     /////////////////////////////////////////////////
@@ -175,6 +368,31 @@ namespace meshnetwork {
      */
     void checkForNewMessages();
 
+    /**
+     * @brief Whether some messages are held back by the client traffic budget
+     * [NOTE: Used for testing purposes only]
+     *
+     * @return true
+     * @return false
+     */
+    bool hasQueuedMessages();
+
+    /**
+     * @brief Drop the messages that were not sent or received yet, as a reboot
+     * would
+     * [NOTE: Used for testing purposes only]
+     *
+     */
+    void dropMessages();
+
+    /**
+     * @brief Get the buffer of the messages that are not received yet
+     * [NOTE: Used for testing purposes only]
+     *
+     * @return std::list<std::pair<uint32_t, string_t>>&
+     */
+    std::list<std::pair<uint32_t, string_t>>& getMessageBuffer();
+
 #endif
   };
 
@@ -17,15 +17,58 @@ _message::~Message() {
   delete this->_payload;
 };
 
+broth::message::MessageType _message::getType() {
+  return this->_message_type;
+};
+
 string_t _message::serialize() {
-  // We need a larger buffer due to data type differences on a x86 computer, so
-  // we need to redefine a quite large buffer instead of the default ones for
-  // ESP8266
-#ifdef _RAMEN_UNIT_TESTING_
-  delete this->_payload;
-  this->_payload = new DynamicJsonDocument(RAMEN_UNIT_TESTING_PAYLOAD_SIZE);
+  RAMEN_ALLOCATION_SCOPE(MESSAGE);
+
+  this->dumpFields();
+
+  // Dump the batch of entries
+  if(this->_entries.size() > 0) {
+    JsonArray entries = this->_payload->createNestedArray(ENTRIES_FIELD_KEY);
+    for(auto it = this->_entries.begin(); it != this->_entries.end(); ++it) {
+      JsonArray entry = entries.createNestedArray();
+      entry.add(it->first);
+      entry.add(it->second->c_str());
+    }
+
+#if ENABLE_COMPRESSION
+    // Replace the batch with its compressed form if that is shorter
+    if(this->_compress_entries) {
+      string_t serialized_entries;
+      string_t compressed_entries;
+      serializeJson((*(this->_payload))[ENTRIES_FIELD_KEY], serialized_entries);
+
+      if(broth::compression::compress(serialized_entries,
+                                      compressed_entries)) {
+        // The compressed batch is copied into the document, which is replaced
+        // by one that has room for it
+        delete this->_payload;
+        this->_payload = new json_document_t(
+            REQUEST_APPEND_ENTRY_SIZE + compressed_entries.length() + 1);
+        this->dumpFields();
+
+        (*(this->_payload))[ENTRIES_FIELD_KEY] = compressed_entries;
+        (*(this->_payload))[ENCODING_FIELD_KEY] =
+            broth::compression::LZF_ENCODING;
+      }
+    }
 #endif
+  }
+
+  // Empty serialized payload
+  string_t serialized_payload;
+
+  // Fill the serialized payload
+  serializeJson((*(this->_payload)), serialized_payload);
 
+  return serialized_payload;
+};
+
+void _message::dumpFields() {
   // Dump the common fields
   (*(this->_payload))[TYPE_FIELD_KEY] = this->_message_type;
   (*(this->_payload))[TERM_FIELD_KEY] = this->_term;
@@ -49,12 +92,4 @@ string_t _message::serialize() {
       ++it) {
     (*(this->_payload))[it->first] = it->second;
   }
-
-  // Empty serialized payload
-  string_t serialized_payload;
-
-  // Fill the serialized payload
-  serializeJson((*(this->_payload)), serialized_payload);
-
-  return serialized_payload;
 };
@@ -8,7 +8,9 @@
 
 #include <cassert>
 #include <map>
+#include <vector>
 
+#include "ramen/compression.hpp"
 #include "ramen/configuration.hpp"
 #include "ramen/logger.hpp"
 
@@ -26,8 +28,28 @@ namespace message {
     ENTRY = 4,
     DISTRIBUTE_ENTRY = 5,
     DISTRIBUTE_ENTRY_ACK = 6,
+    HEART_BEAT = 7,
+    HEALTH = 8,
   } MessageType;
 
+  /**
+   * @brief Summary of the metrics of a node, which it broadcasts to let a
+   * gateway node collect the stats of the whole mesh network. Latencies are
+   * medians in microseconds.
+   *
+   */
+  struct HealthSummary {
+    uint32_t term = 0;
+    uint32_t state = 0;
+    uint32_t commit_index = 0;
+    uint32_t log_size = 0;
+    uint32_t queue_depth = 0;
+    uint32_t elections = 0;
+    uint32_t send_failures = 0;
+    uint32_t rpc_latency = 0;
+    uint32_t commit_latency = 0;
+  };
+
   /**
    * @brief Class that is used to create messages that will be sent between mesh
    * nodes and serializing these messages
@@ -38,11 +60,15 @@ namespace message {
     string_t _serialized_payload;
     MessageType _message_type;
     uint32_t _term;
-    DynamicJsonDocument* _payload;
+    json_document_t* _payload = NULL;
 
     std::map<string_t, uint32_t> _field_uint32_t;
     std::map<string_t, bool> _field_bool;
     std::map<string_t, string_t> _field_string_t;
+    // entries:{term, data_ptr}, serialized as [[term, data], ...]
+    // The data stays in the log, it is not copied before serialize()
+    std::vector<std::pair<uint32_t, const string_t*>> _entries;
+    bool _compress_entries = false;
 
    public:
     /**
@@ -67,9 +93,10 @@ namespace message {
      */
     void addFields(uint32_t last_log_term, uint32_t last_log_index) {
       assert(this->_message_type == REQUEST_VOTE);
+      RAMEN_ALLOCATION_SCOPE(MESSAGE);
 
       // Initialize the correct size
-      this->_payload = new DynamicJsonDocument(REQUEST_VOTE_SIZE);
+      this->_payload = new json_document_t(REQUEST_VOTE_SIZE);
 
       // clang-format off
       this->_field_uint32_t.insert(std::make_pair(LAST_LOG_TERM_FIELD_KEY, last_log_term));
@@ -84,9 +111,10 @@ namespace message {
      */
     void addFields(bool granted) {
       assert(this->_message_type == SEND_VOTE);
+      RAMEN_ALLOCATION_SCOPE(MESSAGE);
 
       // Initialize the correct size
-      this->_payload = new DynamicJsonDocument(SEND_VOTE_SIZE);
+      this->_payload = new json_document_t(SEND_VOTE_SIZE);
 
       this->_field_bool.insert(std::make_pair(GRANTED_FIELD_KEY, granted));
     };
@@ -98,21 +126,105 @@ namespace message {
      * @param previous_log_term
      * @param entries
      * @param commit_index
+     * @param heart_beat_period Leader's current heart beat period
+     * @param request_id Echoed in the response to time the round trip, 0 if
+     * the response is not timed
      */
     void addFields(uint32_t previous_log_index,
                    uint32_t previous_log_term,
                    string_t entries,
-                   uint32_t commit_index) {
+                   uint32_t commit_index,
+                   uint32_t heart_beat_period,
+                   uint32_t request_id = 0) {
       assert(this->_message_type == REQUEST_APPEND_ENTRY);
+      RAMEN_ALLOCATION_SCOPE(MESSAGE);
 
       // Initialize the correct size
-      this->_payload = new DynamicJsonDocument(REQUEST_APPEND_ENTRY_SIZE);
+      this->_payload = new json_document_t(REQUEST_APPEND_ENTRY_SIZE);
 
       // clang-format off
       this->_field_uint32_t.insert(std::make_pair(PREVIOUS_LOG_INDEX_FIELD_KEY, previous_log_index));
       this->_field_uint32_t.insert(std::make_pair(PREVIOUS_LOG_TERM_FIELD_KEY, previous_log_term));
       this->_field_string_t.insert(std::make_pair(ENTRIES_FIELD_KEY, entries));
       this->_field_uint32_t.insert(std::make_pair(COMMIT_INDEX_FIELD_KEY, commit_index));
+      this->_field_uint32_t.insert(std::make_pair(HEART_BEAT_PERIOD_FIELD_KEY, heart_beat_period));
+      // clang-format on
+
+      if(request_id > 0) {
+        this->_field_uint32_t.insert(
+            std::make_pair(REQUEST_ID_FIELD_KEY, request_id));
+      }
+    };
+
+    /**
+     * @brief MessageRequestAppendEntry with a batch of entries, each with its
+     * own term
+     *
+     * @param previous_log_index
+     * @param previous_log_term
+     * @param entries The data has to outlive the call to serialize()
+     * @param commit_index
+     * @param heart_beat_period
+     * @param compress_entries Whether the receiver can decompress the batch
+     * @param request_id Echoed in the response to time the round trip, 0 if
+     * the response is not timed
+     */
+    void addFields(
+        uint32_t previous_log_index,
+        uint32_t previous_log_term,
+        std::vector<std::pair<uint32_t, const string_t*>>&& entries,
+        uint32_t commit_index,
+        uint32_t heart_beat_period,
+        bool compress_entries = false,
+        uint32_t request_id = 0) {
+      assert(this->_message_type == REQUEST_APPEND_ENTRY);
+      RAMEN_ALLOCATION_SCOPE(MESSAGE);
+
+      // Initialize the correct size, every entry is an array of two. The data
+      // is added as const char*, which the document only points to. A
+      // compressed batch gets a document of its own in serialize(), once its
+      // length is known.
+      size_t size = REQUEST_APPEND_ENTRY_SIZE + JSON_ARRAY_SIZE(entries.size()) +
+                    entries.size() * JSON_ARRAY_SIZE(2);
+      this->_payload = new json_document_t(size);
+
+      // clang-format off
+      this->_field_uint32_t.insert(std::make_pair(PREVIOUS_LOG_INDEX_FIELD_KEY, previous_log_index));
+      this->_field_uint32_t.insert(std::make_pair(PREVIOUS_LOG_TERM_FIELD_KEY, previous_log_term));
+      this->_field_uint32_t.insert(std::make_pair(COMMIT_INDEX_FIELD_KEY, commit_index));
+      this->_field_uint32_t.insert(std::make_pair(HEART_BEAT_PERIOD_FIELD_KEY, heart_beat_period));
+      // clang-format on
+      if(request_id > 0) {
+        this->_field_uint32_t.insert(
+            std::make_pair(REQUEST_ID_FIELD_KEY, request_id));
+      }
+      this->_entries = std::move(entries);
+      this->_compress_entries = compress_entries;
+    };
+
+    /**
+     * @brief MessageHeartBeat
+     *
+     * @param commit_index
+     * @param last_log_index
+     * @param last_log_term
+     * @param heart_beat_period Leader's current heart beat period
+     */
+    void addFields(uint32_t commit_index,
+                   uint32_t last_log_index,
+                   uint32_t last_log_term,
+                   uint32_t heart_beat_period) {
+      assert(this->_message_type == HEART_BEAT);
+      RAMEN_ALLOCATION_SCOPE(MESSAGE);
+
+      // Initialize the correct size
+      this->_payload = new json_document_t(HEART_BEAT_SIZE);
+
+      // clang-format off
+      this->_field_uint32_t.insert(std::make_pair(COMMIT_INDEX_FIELD_KEY, commit_index));
+      this->_field_uint32_t.insert(std::make_pair(LAST_LOG_INDEX_FIELD_KEY, last_log_index));
+      this->_field_uint32_t.insert(std::make_pair(LAST_LOG_TERM_FIELD_KEY, last_log_term));
+      this->_field_uint32_t.insert(std::make_pair(HEART_BEAT_PERIOD_FIELD_KEY, heart_beat_period));
       // clang-format on
     };
 
@@ -121,17 +233,39 @@ namespace message {
      *
      * @param success
      * @param match_index
+     * @param conflict_term Term of the follower's entry that conflicted with
+     * the previous log entry of the request, 0 if there was none
+     * @param request_id ID of the request that is responded to, 0 if it had
+     * none
      */
-    void addFields(bool success, uint32_t match_index) {
+    void addFields(bool success,
+                   uint32_t match_index,
+                   uint32_t conflict_term = 0,
+                   uint32_t request_id = 0) {
       assert(this->_message_type == RESPOND_APPEND_ENTRY);
+      RAMEN_ALLOCATION_SCOPE(MESSAGE);
 
       // Initialize the correct size
-      this->_payload = new DynamicJsonDocument(RESPOND_APPEND_ENTRY_SIZE);
+      this->_payload = new json_document_t(RESPOND_APPEND_ENTRY_SIZE);
 
       // clang-format off
       this->_field_bool.insert(std::make_pair(SUCCESS_FIELD_KEY, success));
       this->_field_uint32_t.insert(std::make_pair(MATCH_INDEX_FIELD_KEY, match_index));
       // clang-format on
+
+      if(conflict_term > 0) {
+        this->_field_uint32_t.insert(
+            std::make_pair(CONFLICT_TERM_FIELD_KEY, conflict_term));
+      }
+      if(request_id > 0) {
+        this->_field_uint32_t.insert(
+            std::make_pair(REQUEST_ID_FIELD_KEY, request_id));
+      }
+
+#if ENABLE_COMPRESSION
+      // Let the leader know that compressed entries can be sent
+      this->_field_bool.insert(std::make_pair(COMPRESSION_FIELD_KEY, true));
+#endif
     };
 
     /**
@@ -141,9 +275,10 @@ namespace message {
      */
     void addFields(string_t data, bool ack) {
       assert(this->_message_type == DISTRIBUTE_ENTRY);
+      RAMEN_ALLOCATION_SCOPE(MESSAGE);
 
       // Initialize the correct size
-      this->_payload = new DynamicJsonDocument(DISTRIBUTE_ENTRY_SIZE);
+      this->_payload = new json_document_t(DISTRIBUTE_ENTRY_SIZE);
 
       // clang-format off
       this->_field_string_t.insert(std::make_pair(DISTRIBUTE_ENTRY_KEY, data));
@@ -158,21 +293,61 @@ namespace message {
      */
     void addFields(uint32_t message_id, bool ack) {
       assert(this->_message_type == DISTRIBUTE_ENTRY_ACK);
+      RAMEN_ALLOCATION_SCOPE(MESSAGE);
 
       // Initialize the correct size
-      this->_payload = new DynamicJsonDocument(DISTRIBUTE_ENTRY_ACK_SIZE);
+      this->_payload = new json_document_t(DISTRIBUTE_ENTRY_ACK_SIZE);
 
       // clang-format off
       this->_field_bool.insert(std::make_pair(DISTRIBUTE_ENTRY_ACK_KEY, ack));
       // clang-format on
     };
 
+    /**
+     * @brief Health
+     *
+     * @param health The term is sent as the term of the message
+     */
+    void addFields(const HealthSummary& health) {
+      assert(this->_message_type == HEALTH);
+      RAMEN_ALLOCATION_SCOPE(MESSAGE);
+
+      // Initialize the correct size
+      this->_payload = new json_document_t(HEALTH_SIZE);
+
+      // clang-format off
+      this->_field_uint32_t.insert(std::make_pair(STATE_FIELD_KEY, health.state));
+      this->_field_uint32_t.insert(std::make_pair(COMMIT_INDEX_FIELD_KEY, health.commit_index));
+      this->_field_uint32_t.insert(std::make_pair(LOG_SIZE_FIELD_KEY, health.log_size));
+      this->_field_uint32_t.insert(std::make_pair(QUEUE_DEPTH_FIELD_KEY, health.queue_depth));
+      this->_field_uint32_t.insert(std::make_pair(ELECTIONS_FIELD_KEY, health.elections));
+      this->_field_uint32_t.insert(std::make_pair(SEND_FAILURES_FIELD_KEY, health.send_failures));
+      this->_field_uint32_t.insert(std::make_pair(RPC_LATENCY_FIELD_KEY, health.rpc_latency));
+      this->_field_uint32_t.insert(std::make_pair(COMMIT_LATENCY_FIELD_KEY, health.commit_latency));
+      // clang-format on
+    };
+
+    /**
+     * @brief Get the type of the message
+     *
+     * @return MessageType
+     */
+    MessageType getType();
+
     /**
      * @brief Serializes the current message object to a JSON string
      *
      * @return string_t
      */
     string_t serialize();
+
+   private:
+    /**
+     * @brief Dump the common fields and the fields added by addFields() into
+     * the document, everything but the batch of entries
+     *
+     */
+    void dumpFields();
   };
 } // namespace message
 } // namespace broth
@@ -0,0 +1,152 @@
+/**
+ * @file metrics.cpp
+ * @brief metrics.cpp
+ *
+ */
+#include "ramen/metrics.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+using _histogram = broth::metrics::Histogram;
+using _metrics = broth::metrics::Metrics;
+using namespace broth::metrics;
+
+_histogram::Histogram() {};
+
+void _histogram::add(uint32_t value) {
+  ++this->_buckets[getBucket(value)];
+  ++this->_count;
+  this->_sum += value;
+  this->_max = std::max(this->_max, value);
+};
+
+uint32_t _histogram::getCount() {
+  return this->_count;
+};
+
+uint32_t _histogram::getMax() {
+  return this->_max;
+};
+
+uint32_t _histogram::getMean() {
+  if(this->_count == 0) {
+    return 0;
+  }
+
+  return this->_sum / this->_count;
+};
+
+uint32_t _histogram::getBucketCount(uint32_t bucket) {
+  if(bucket >= METRICS_HISTOGRAM_BUCKETS) {
+    return 0;
+  }
+
+  return this->_buckets[bucket];
+};
+
+uint32_t _histogram::getPercentile(float percentile) {
+  if(this->_count == 0) {
+    return 0;
+  }
+
+  // Rank of the value, counting from 1
+  uint32_t rank = std::max(
+      (uint32_t) 1, (uint32_t) std::ceil(percentile / 100 * this->_count));
+
+  uint32_t counted = 0;
+  for(uint32_t bucket = 0; bucket < METRICS_HISTOGRAM_BUCKETS; ++bucket) {
+    counted += this->_buckets[bucket];
+    if(counted >= rank) {
+      return std::min(getBucketUpperBound(bucket), this->_max);
+    }
+  }
+
+  return this->_max;
+};
+
+uint32_t _histogram::getBucket(uint32_t value) {
+  // The bucket is the number of bits of the value beyond the first bucket
+  uint32_t scaled = value >> METRICS_HISTOGRAM_SHIFT;
+  uint32_t bucket = 0;
+  while(scaled > 0 && bucket < METRICS_HISTOGRAM_BUCKETS - 1) {
+    scaled >>= 1;
+    ++bucket;
+  }
+
+  return bucket;
+};
+
+uint32_t _histogram::getBucketUpperBound(uint32_t bucket) {
+  if(bucket >= METRICS_HISTOGRAM_BUCKETS - 1 ||
+     bucket + METRICS_HISTOGRAM_SHIFT >= 32) {
+    return UINT32_MAX;
+  }
+
+  return (1UL << (bucket + METRICS_HISTOGRAM_SHIFT)) - 1;
+};
+
+_metrics::Metrics() {};
+
+void _metrics::increment(Counter counter, uint32_t amount) {
+  this->_counters[counter] += amount;
+};
+
+uint32_t _metrics::get(Counter counter) {
+  return this->_counters[counter];
+};
+
+void _metrics::countSent(MessageType type, uint32_t bytes) {
+  if(type <= HEALTH) {
+    ++this->_messages_sent[type];
+  }
+  this->_counters[BYTES_SENT] += bytes;
+};
+
+void _metrics::countReceived(MessageType type, uint32_t bytes) {
+  if(type <= HEALTH) {
+    ++this->_messages_received[type];
+  }
+  this->_counters[BYTES_RECEIVED] += bytes;
+};
+
+uint32_t _metrics::getSent(MessageType type) {
+  return (type <= HEALTH) ? this->_messages_sent[type] : 0;
+};
+
+uint32_t _metrics::getReceived(MessageType type) {
+  return (type <= HEALTH) ? this->_messages_received[type] : 0;
+};
+
+void _metrics::trackEntry(uint32_t index, uint32_t current_time) {
+  // Slots are reused in turns, which drops the oldest entry when all of them
+  // are taken
+  this->_tracked_indices[this->_next_tracked_entry] = index;
+  this->_tracked_times[this->_next_tracked_entry] = current_time;
+  this->_next_tracked_entry =
+      (this->_next_tracked_entry + 1) % METRICS_TRACKED_ENTRIES;
+};
+
+void _metrics::commitEntries(uint32_t commit_index, uint32_t current_time) {
+  for(uint32_t i = 0; i < METRICS_TRACKED_ENTRIES; ++i) {
+    if(this->_tracked_indices[i] > 0 &&
+       this->_tracked_indices[i] <= commit_index) {
+      this->_commit_latency.add(current_time - this->_tracked_times[i]);
+      this->_tracked_indices[i] = 0;
+    }
+  }
+};
+
+void _metrics::untrackEntries() {
+  for(uint32_t i = 0; i < METRICS_TRACKED_ENTRIES; ++i) {
+    this->_tracked_indices[i] = 0;
+  }
+};
+
+Histogram& _metrics::getRpcLatency() {
+  return this->_rpc_latency;
+};
+
+Histogram& _metrics::getCommitLatency() {
+  return this->_commit_latency;
+};
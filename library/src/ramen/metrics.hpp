@@ -0,0 +1,252 @@
+/**
+ * @file metrics.hpp
+ * @brief metrics.hpp
+ *
+ */
+#ifndef _RAMEN_METRICS_HPP_
+#define _RAMEN_METRICS_HPP_
+
+#include "ramen/configuration.hpp"
+#include "ramen/message.hpp"
+
+namespace broth {
+namespace metrics {
+  using namespace broth::message;
+
+  /**
+   * @brief Counters of the events of a node, they wrap around like the time
+   * of the node
+   *
+   */
+  typedef enum {
+    ELECTIONS_STARTED = 0,
+    ELECTIONS_WON = 1,
+    TERM_CHANGES = 2,
+    // Messages that the mesh network could not send
+    SEND_FAILURES = 3,
+    BYTES_SENT = 4,
+    BYTES_RECEIVED = 5,
+    MALFORMED_MESSAGES = 6,
+    // Entries that the leader appended to its log
+    ENTRIES_APPENDED = 7,
+    ENTRIES_COMMITTED = 8,
+    // Append entry requests held back over the replication budget
+    REPLICATION_HELD_BACK = 9,
+  } Counter;
+
+  /**
+   * @brief Histogram of durations in microseconds with buckets that double in
+   * size, see METRICS_HISTOGRAM_BUCKETS. Percentiles are rounded up to the
+   * end of their bucket.
+   *
+   */
+  class Histogram {
+   private:
+    uint32_t _buckets[METRICS_HISTOGRAM_BUCKETS] = {0};
+    uint32_t _count = 0;
+    uint32_t _max = 0;
+    uint64_t _sum = 0;
+
+   public:
+    /**
+     * @brief Construct a new Histogram object
+     *
+     */
+    Histogram();
+
+    /**
+     * @brief Count a value in its bucket
+     *
+     * @param value
+     */
+    void add(uint32_t value);
+
+    /**
+     * @brief Get the number of values counted
+     *
+     * @return uint32_t
+     */
+    uint32_t getCount();
+
+    /**
+     * @brief Get the largest value counted
+     *
+     * @return uint32_t
+     */
+    uint32_t getMax();
+
+    /**
+     * @brief Get the average of the values counted
+     *
+     * @return uint32_t 0 if nothing was counted
+     */
+    uint32_t getMean();
+
+    /**
+     * @brief Get the number of values counted in the given bucket
+     *
+     * @param bucket
+     * @return uint32_t
+     */
+    uint32_t getBucketCount(uint32_t bucket);
+
+    /**
+     * @brief Get the value below which the given percentage of the values
+     * are, rounded up to the end of its bucket and capped at the largest value
+     *
+     * @param percentile Between 0 and 100
+     * @return uint32_t 0 if nothing was counted
+     */
+    uint32_t getPercentile(float percentile);
+
+    /**
+     * @brief Get the bucket that a value is counted in
+     *
+     * @param value
+     * @return uint32_t
+     */
+    static uint32_t getBucket(uint32_t value);
+
+    /**
+     * @brief Get the largest value of a bucket
+     *
+     * @param bucket
+     * @return uint32_t
+     */
+    static uint32_t getBucketUpperBound(uint32_t bucket);
+  };
+
+  /**
+   * @brief Counters and latency histograms of a node. It has a fixed size,
+   * so nothing is allocated while counting.
+   *
+   */
+  class Metrics {
+   private:
+    uint32_t _counters[REPLICATION_HELD_BACK + 1] = {0};
+    uint32_t _messages_sent[HEALTH + 1] = {0};
+    uint32_t _messages_received[HEALTH + 1] = {0};
+    // From sending an append entry request until its response
+    Histogram _rpc_latency;
+    // From appending an entry to the log of the leader until it is committed
+    Histogram _commit_latency;
+    // tracked_entries:{log_index, append_time}, index 0 is a free slot
+    uint32_t _tracked_indices[METRICS_TRACKED_ENTRIES] = {0};
+    uint32_t _tracked_times[METRICS_TRACKED_ENTRIES] = {0};
+    uint32_t _next_tracked_entry = 0;
+
+   public:
+    /**
+     * @brief Construct a new Metrics object
+     *
+     */
+    Metrics();
+
+    /**
+     * @brief Add to a counter
+     *
+     * @param counter
+     * @param amount
+     */
+    void increment(Counter counter, uint32_t amount = 1);
+
+    /**
+     * @brief Get the value of a counter
+     *
+     * @param counter
+     * @return uint32_t
+     */
+    uint32_t get(Counter counter);
+
+    /**
+     * @brief Count a message that was handed to the mesh network
+     *
+     * @param type
+     * @param bytes Length of the serialized message
+     */
+    void countSent(MessageType type, uint32_t bytes);
+
+    /**
+     * @brief Count a received message, unknown types only count their bytes
+     *
+     * @param type
+     * @param bytes Length of the serialized message
+     */
+    void countReceived(MessageType type, uint32_t bytes);
+
+    /**
+     * @brief Get the number of messages of a type that were sent
+     *
+     * @param type
+     * @return uint32_t
+     */
+    uint32_t getSent(MessageType type);
+
+    /**
+     * @brief Get the number of messages of a type that were received
+     *
+     * @param type
+     * @return uint32_t
+     */
+    uint32_t getReceived(MessageType type);
+
+    /**
+     * @brief Start timing the commit of an entry the leader appended, the
+     * oldest entry that is still timed is dropped if there is no room left
+     *
+     * @param index Log index of the entry
+     * @param current_time Current time in microseconds
+     */
+    void trackEntry(uint32_t index, uint32_t current_time);
+
+    /**
+     * @brief Count the commit latencies of the timed entries up to the commit
+     * index
+     *
+     * @param commit_index
+     * @param current_time Current time in microseconds
+     */
+    void commitEntries(uint32_t commit_index, uint32_t current_time);
+
+    /**
+     * @brief Stop timing all entries, for example after losing the leadership
+     *
+     */
+    void untrackEntries();
+
+    /**
+     * @brief Get the histogram of the append entry round trip times
+     *
+     * @return Histogram&
+     */
+    Histogram& getRpcLatency();
+
+    /**
+     * @brief Get the histogram of the commit latencies of the leader
+     *
+     * @return Histogram&
+     */
+    Histogram& getCommitLatency();
+  };
+
+  /**
+   * @brief Copy of the metrics of a node, along with its current state
+   *
+   */
+  struct MetricsSnapshot {
+    Metrics metrics;
+    uint32_t state = 0;
+    uint32_t term = 0;
+    uint32_t log_size = 0;
+    uint32_t commit_index = 0;
+    // Entries in the log that are not committed yet
+    uint32_t commit_lag = 0;
+    // Data waiting in the data queue to be sent to the leader
+    uint32_t queue_depth = 0;
+    uint32_t heart_beat_period = 0;
+  };
+
+} // namespace metrics
+} // namespace broth
+
+#endif
@@ -0,0 +1,93 @@
+/**
+ * @file painless_mesh_transport.cpp
+ * @brief painless_mesh_transport.cpp
+ *
+ */
+#include "ramen/painless_mesh_transport.hpp"
+
+using _painless_mesh_transport = broth::transport::PainlessMeshTransport;
+using namespace broth::transport;
+
+_painless_mesh_transport::PainlessMeshTransport() {};
+
+bool _painless_mesh_transport::init(string_t mesh_name,
+                                    string_t mesh_password,
+                                    Scheduler* scheduler_ptr,
+                                    uint16_t mesh_port) {
+  this->_painless_mesh.init(mesh_name, mesh_password, scheduler_ptr, mesh_port);
+
+  return true;
+};
+
+void _painless_mesh_transport::update() {
+  // painlessMesh executes the scheduler itself
+  this->_painless_mesh.update();
+};
+
+uint32_t _painless_mesh_transport::getNodeId() {
+  return this->_painless_mesh.getNodeId();
+};
+
+uint32_t _painless_mesh_transport::getNodeTime() {
+  return this->_painless_mesh.getNodeTime();
+};
+
+std::list<uint32_t> _painless_mesh_transport::getNodeList(bool include_self) {
+  return this->_painless_mesh.getNodeList(include_self);
+};
+
+bool _painless_mesh_transport::sendBroadcast(string_t data) {
+  return this->_painless_mesh.sendBroadcast(data);
+};
+
+bool _painless_mesh_transport::sendSingle(uint32_t destination_node_id,
+                                          string_t data) {
+  return this->_painless_mesh.sendSingle(destination_node_id, data);
+};
+
+void _painless_mesh_transport::onReceive(received_callback_t on_receive) {
+  this->_painless_mesh.onReceive(on_receive);
+};
+
+void _painless_mesh_transport::onChangedConnections(
+    changed_connections_callback_t on_changed_connections) {
+  this->_painless_mesh.onChangedConnections(on_changed_connections);
+};
+
+string_t _painless_mesh_transport::subConnectionJson() {
+  return this->_painless_mesh.subConnectionJson();
+};
+
+  /////////////////////////////////////////////////
+  // Methods used only during testing
+  /////////////////////////////////////////////////
+
+#ifdef _RAMEN_UNIT_TESTING_
+
+void _painless_mesh_transport::setMeshTime(uint32_t time) {
+  this->_painless_mesh.setMeshTime(time);
+};
+
+void _painless_mesh_transport::incrementMeshTimeBy(uint32_t time) {
+  this->_painless_mesh.incrementMeshTimeBy(time);
+};
+
+void _painless_mesh_transport::setNodeId(uint32_t node_id) {
+  this->_painless_mesh.setNodeId(node_id);
+};
+
+void _painless_mesh_transport::addNeighbourNode(Transport& neighbour_node) {
+  this->_painless_mesh.addNeighbourNode(
+      static_cast<PainlessMeshTransport&>(neighbour_node)._painless_mesh);
+};
+
+void _painless_mesh_transport::checkForNewMessages() {
+  this->_painless_mesh.checkForNewMessages();
+};
+
+std::list<std::pair<uint32_t, string_t>>&
+_painless_mesh_transport::getMessageBuffer() {
+  return this->_painless_mesh._message_buffer;
+};
+
+#endif
@@ -0,0 +1,78 @@
+/**
+ * @file painless_mesh_transport.hpp
+ * @brief painless_mesh_transport.hpp
+ *
+ */
+#ifndef _RAMEN_PAINLESS_MESH_TRANSPORT_HPP_
+#define _RAMEN_PAINLESS_MESH_TRANSPORT_HPP_
+
+#include "ramen/configuration.hpp"
+#include "ramen/transport.hpp"
+
+namespace broth {
+namespace transport {
+
+  /**
+   * @brief Transport that runs on painlessMesh
+   *
+   */
+  class PainlessMeshTransport : public Transport {
+   private:
+    painlessMesh _painless_mesh;
+
+   public:
+    /**
+     * @brief Construct a new Painless Mesh Transport object
+     *
+     */
+    PainlessMeshTransport();
+
+    bool init(string_t mesh_name,
+              string_t mesh_password,
+              Scheduler* scheduler_ptr,
+              uint16_t mesh_port) override;
+
+    void update() override;
+
+    uint32_t getNodeId() override;
+
+    uint32_t getNodeTime() override;
+
+    std::list<uint32_t> getNodeList(bool include_self = false) override;
+
+    bool sendBroadcast(string_t data) override;
+
+    bool sendSingle(uint32_t destination_node_id, string_t data) override;
+
+    void onReceive(received_callback_t on_receive) override;
+
+    void onChangedConnections(
+        changed_connections_callback_t on_changed_connections) override;
+
+    string_t subConnectionJson() override;
+
+    /////////////////////////////////////////////////
+    // Methods used only during testing
+    /////////////////////////////////////////////////
+
+#ifdef _RAMEN_UNIT_TESTING_
+
+    void setMeshTime(uint32_t time) override;
+
+    void incrementMeshTimeBy(uint32_t time) override;
+
+    void setNodeId(uint32_t node_id) override;
+
+    void addNeighbourNode(Transport& neighbour_node) override;
+
+    void checkForNewMessages() override;
+
+    std::list<std::pair<uint32_t, string_t>>& getMessageBuffer() override;
+
+#endif
+  };
+
+} // namespace transport
+} // namespace broth
+
+#endif
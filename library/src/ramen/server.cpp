@@ -14,187 +14,269 @@ using namespace broth::utils;
 using namespace broth::message;
 using namespace broth::logger;
 
+// Brackets, quotes, commas and the term around every entry in a request
+static const uint32_t ENTRY_FRAMING_SIZE = 16;
+
 _server::Server() :
-    _state(FOLLOWER), _term(0), _received_new_append_entry_request(false) {
-  // Seed the rand function with current time
-  std::srand(time(NULL));
+    _state(FOLLOWER), _term(0), _heart_beat_period(HEART_BEAT_TIMER_PERIOD),
+    _commit_index(0) {
+  // Seed the random number generator with current time
+  this->_random.seed(time(NULL));
+
+  this->_replication_bucket.init(REPLICATION_RATE, REPLICATION_BURST);
 };
 
 void _server::init(string_t mesh_name,
                    string_t mesh_password,
                    uint16_t mesh_port,
                    uint8_t logging_level) {
+  RAMEN_ALLOCATION_SCOPE(SERVER);
+
   this->_logger.setLogLevel(logging_level);
 
-  // Initialize painlessMesh
-  this->_mesh.init(PAINLESSMESH,
-                   mesh_name,
-                   mesh_password,
-                   mesh_port,
-                   logging_level);
+  // Initialize the selected transport, painlessMesh by default
+  this->_mesh.init(mesh_name, mesh_password, mesh_port, logging_level);
 
   // Set callbacks
   this->_mesh.onReceiveCallback([&](uint32_t from, string_t data) {
     this->receiveData(from, data);
   });
+  this->_mesh.onSendFailure([&](uint32_t destination, uint32_t messages) {
+    this->_metrics.increment(SEND_FAILURES, messages);
+  });
 
-  // Set node ID and time
+  // Set node ID
   this->_id = this->_mesh.getNodeId();
   this->_logger.setLoggerId(this->_mesh.getNodeId());
-  this->_previous_node_time = this->_mesh.getNodeTime();
 
-  // Set the election alarm
-  this->setElectionAlarmValue();
+  // Nodes that start at the same time must not draw the same election alarms
+  this->_random.seed(time(NULL) + this->_id);
 
-  // Let the user know that initialization was successful
-  this->_logger(DEBUG, "Just initialized the node!\n");
+  // Register the Raft tasks to the scheduler of the mesh network, periods are
+  // converted from microseconds to milliseconds
+  Scheduler& scheduler = this->_mesh.getScheduler();
 
-  // Set timers' periods to specified periods
-  this->_raft_timer.init(RAFT_TIMER_PERIOD);
-  this->_request_vote_timer.init(REQUEST_VOTE_TIMER_PERIOD);
-  this->_heart_beat_timer.init(HEART_BEAT_TIMER_PERIOD);
-  this->_request_append_entry_timer.init(REQUEST_APPEND_ENTRY_PERIOD);
-};
+  this->_task_election.set(TASK_IMMEDIATE, TASK_ONCE, [&]() {
+    this->handleElectionAlarmTimeout();
+  });
+  this->_task_request_vote.set((REQUEST_VOTE_TIMER_PERIOD) / 1000,
+                               TASK_FOREVER,
+                               [&]() { this->requestVote(); });
+  this->_task_heart_beat.set(
+      this->_heart_beat_period / 2000, TASK_FOREVER, [&]() {
+        this->broadcastRequestAppendEntries(true);
 
-void _server::update() {
-  // Update the mesh network all the time
-  this->_mesh.update();
+        // Check for idle followers twice per heart beat period, following
+        // the latest round trip time estimates
+        this->_task_heart_beat.setInterval(this->_heart_beat_period / 2000);
+      });
+  this->_task_data_queue.set((RAFT_TIMER_PERIOD) / 1000, TASK_FOREVER, [&]() {
+    this->sendLocalQueueDataToLeaderQueue();
+  });
+  this->_task_health.set(this->_health_broadcast_period / 1000,
+                         TASK_FOREVER,
+                         [&]() { this->broadcastHealth(); });
 
-  uint32_t current_time = this->_mesh.getNodeTime();
+  scheduler.addTask(this->_task_election);
+  scheduler.addTask(this->_task_request_vote);
+  scheduler.addTask(this->_task_heart_beat);
+  scheduler.addTask(this->_task_data_queue);
+  scheduler.addTask(this->_task_health);
 
-  // Slow down the Raft implementation with the help of the timer
-  if(this->_raft_timer.check(current_time)) {
-    //////////////////////
-    // State => FOLLOWER
-    //////////////////////
-    if(this->getState() == FOLLOWER) {
-      this->checkForElectionAlarmTimeout();
-    }
+  // Health summaries are only broadcast if a period is set, which is bounded
+  // the same way as one set later on
+  this->setHealthBroadcastPeriod(this->_health_broadcast_period);
 
-    //////////////////////
-    // State => CANDIDATE
-    //////////////////////
-    else if(this->getState() == CANDIDATE) {
-      this->checkForElectionAlarmTimeout();
+  // Set the election alarm
+  this->setElectionAlarmValue();
 
-      // Slow down with timer
-      if(this->_request_vote_timer.check(current_time)) {
-        this->requestVote();
-      }
-    }
+  this->_trace.record(this->_mesh.getNodeTime(), TRACE_STARTED);
 
-    //////////////////////
-    // State => LEADER
-    //////////////////////
-    else if(this->getState() == LEADER) {
-      this->_commit_index =
-          std::max(this->_commit_index, this->_log.getMajorityCommitIndex());
-
-      // Slow down with timer
-      bool heart_beat_timer = this->_heart_beat_timer.check(current_time);
-      bool request_append_entry_timer =
-          this->_request_append_entry_timer.check(current_time);
-
-      // If heart_beat_timer and request_append_entry_timer timeout together,
-      // send append entry request,
-      // otherwise send an hear beat
-      if(heart_beat_timer && request_append_entry_timer) {
-        // Boolean refers to sending heartbeat
-        this->broadcastRequestAppendEntries(false);
-      } else if(heart_beat_timer) {
-        this->broadcastRequestAppendEntries(true);
-      }
-    }
+  // Let the user know that initialization was successful
+  RAMEN_LOG(this->_logger, DEBUG, "Just initialized the node!\n");
+};
 
-    this->sendLocalQueueDataToLeaderQueue();
-  }
+bool _server::setTransport(MeshNetworkType mesh_network_type) {
+  return this->_mesh.setTransport(mesh_network_type);
+};
+
+void _server::setTransport(Transport* transport_ptr) {
+  this->_mesh.setTransport(transport_ptr);
+};
+
+void _server::update() {
+  RAMEN_ALLOCATION_SCOPE(SERVER);
+
+  // Update the mesh network all the time, this also runs the scheduled Raft
+  // tasks that are due
+  this->_mesh.update();
 };
 
 void _server::switchState(ServerState state, uint32_t term) {
+  ServerState previous_state = this->_state;
+
   switch(state) {
     case LEADER: {
-      auto nodeList = _mesh.getNodeList(false);
+      auto& nodeList = _mesh.getNodeList(false);
       this->_state = LEADER;
       this->_log.resetNextIndexMap(&nodeList, this->_log.getLogSize() + 1);
+      this->_log.resetMatchIndexMap(&nodeList, 0);
+      this->_node_list_generation = this->_mesh.getNodeListGeneration();
+      this->_awaiting_append_entry_response.clear();
+      this->_rtt_probe.clear();
       this->_election_alarm = INFINITY;
-      this->_logger(DEBUG,
-                    "Current state: LEADER @ %u\n",
-                    this->_mesh.getNodeTime());
+
+      // Leaders don't have election alarms, they send heart beats instead
+      this->_task_election.disable();
+      this->_task_request_vote.disable();
+      this->_task_heart_beat.enable();
+      RAMEN_LOG(this->_logger,
+                DEBUG,
+                "Current state: LEADER @ %u\n",
+                this->_mesh.getNodeTime());
       break;
     }
     case CANDIDATE: {
       this->_state = CANDIDATE;
-      this->_logger(DEBUG,
-                    "Current state: CANDIDATE @ %u\n",
-                    this->_mesh.getNodeTime());
+      RAMEN_LOG(this->_logger,
+                DEBUG,
+                "Current state: CANDIDATE @ %u\n",
+                this->_mesh.getNodeTime());
       break;
     }
     case FOLLOWER: {
       // Reset election alarm if stepping down from being a leader
       if(this->_state == LEADER) {
         this->setElectionAlarmValue();
+        this->_metrics.untrackEntries();
       }
+      if(term != this->_term) {
+        this->_metrics.increment(TERM_CHANGES);
+      }
+      this->_task_request_vote.disable();
+      this->_task_heart_beat.disable();
+
       // Set new state and update term
       this->_state = state;
       this->_term = term;
       this->_voted_for = 0;
-      this->_logger(DEBUG,
-                    "Current state: FOLLOWER @ %u\n",
-                    this->_mesh.getNodeTime());
+      RAMEN_LOG(this->_logger,
+                DEBUG,
+                "Current state: FOLLOWER @ %u\n",
+                this->_mesh.getNodeTime());
       break;
     }
     default:
-      break;
+      return;
   }
+
+  this->_trace.record(this->_mesh.getNodeTime(),
+                      TRACE_STATE_CHANGED,
+                      state,
+                      this->_term,
+                      previous_state);
 };
 
 ServerState _server::getState() {
   return this->_state;
 };
 
-void _server::setElectionAlarmValue(uint32_t min_val) {
-  this->_election_alarm =
-      (min_val + (std::rand() % 10)) * ELECTION_TIMEOUT_FACTOR;
-  this->_previous_node_time = _mesh.getNodeTime();
-  this->_logger(DEBUG,
-                "Set the election alarm %u duration from now, which is @ %u "
-                "mesh time\n",
-                this->_election_alarm,
-                this->_mesh.getNodeTime() + this->_election_alarm);
-};
-
-void _server::checkForElectionAlarmTimeout() {
-  uint32_t current_node_time = this->_mesh.getNodeTime();
-  // Decide to start an election or not
-  if(this->_received_new_append_entry_request) {
-    // Reset the prev time for restarting the timer
-    this->_previous_node_time = current_node_time;
-    // Assume that the no new append entry requests will be received (no
-    // leaders are available in the network)
-    this->_received_new_append_entry_request = false;
-  } else {
-    if((uint32_t)(current_node_time - this->_previous_node_time) >=
-       this->_election_alarm) {
-      // this->_logger(DEBUG,
-      //               "Current time = %u, Previous time = %u, Difference =
-      //               %u\n", current_node_time, this->_previous_node_time,
-      //               (uint32_t)(current_node_time -
-      //               this->_previous_node_time));
-      // Start an election and restart the timer
-      this->startNewElection();
-      this->setElectionAlarmValue();
-      this->_previous_node_time = current_node_time;
-    }
+void _server::setElectionAlarmValue() {
+  uint32_t base = std::min(
+      std::max((uint32_t) ELECTION_TIMEOUT_HEART_BEAT_FACTOR *
+                   this->_heart_beat_period,
+               (uint32_t) MIN_ELECTION_TIMEOUT),
+      (uint32_t) MAX_ELECTION_TIMEOUT);
+
+  // Nodes with higher costs, like the ones on the edge of the mesh network,
+  // start their candidacy later, so that the leader is placed where the
+  // append entry requests cross the fewest hops
+  uint32_t delay = std::min(
+      (uint32_t) (this->getElectionCost() * ELECTION_COST_DELAY_FACTOR * base),
+      base);
+
+  // Randomize within [base, 2 * base) to avoid split votes
+  this->_election_alarm = base + (this->_random.next() % base) + delay;
+
+  // Restart the election countdown, the task runs in milliseconds
+  this->_task_election.restartDelayed(this->_election_alarm / 1000);
+
+  RAMEN_LOG(this->_logger,
+            DEBUG,
+            "Set the election alarm %u duration from now, which is @ %u "
+            "mesh time\n",
+            this->_election_alarm,
+            this->_mesh.getNodeTime() + this->_election_alarm);
+};
+
+void _server::setElectionCostCallback(
+    election_cost_callback_t election_cost_callback) {
+  this->_election_cost_callback = election_cost_callback;
+};
+
+float _server::getElectionCost() {
+  if(this->_election_cost_callback) {
+    return std::max(this->_election_cost_callback(), 0.0f);
+  }
+
+  // A node that is directly connected to all other nodes has an average hop
+  // count of 1
+  return std::max(this->_mesh.getAverageHopCount() - 1.0f, 0.0f);
+};
+
+void _server::updateHeartBeatPeriod() {
+  // Follow the slowest follower, so that none of them times out
+  uint32_t timeout = 0;
+  for(auto& peer_rtt : this->_peer_rtt) {
+    timeout = std::max(timeout, peer_rtt.second.getTimeout());
+  }
+
+  this->_heart_beat_period =
+      std::min(std::max((uint32_t) HEART_BEAT_RTT_FACTOR * timeout,
+                        (uint32_t) MIN_HEART_BEAT_TIMER_PERIOD),
+               (uint32_t) MAX_HEART_BEAT_TIMER_PERIOD);
+
+  // Followers are told about the new period right away, so a shorter period
+  // has to be picked up right away as well. A longer period is picked up by
+  // the heart beat task on its next run.
+  uint32_t interval = this->_heart_beat_period / 2000;
+  if(interval < this->_task_heart_beat.getInterval()) {
+    this->_task_heart_beat.setInterval(interval);
   }
 };
 
+void _server::followHeartBeatPeriod(uint32_t heart_beat_period) {
+  if(heart_beat_period == 0) {
+    return;
+  }
+
+  // A faulty leader must not set the election timeout beyond the bounds that
+  // a leader would pick itself
+  this->_heart_beat_period = std::min(
+      std::max(heart_beat_period, (uint32_t) MIN_HEART_BEAT_TIMER_PERIOD),
+      (uint32_t) MAX_HEART_BEAT_TIMER_PERIOD);
+};
+
+void _server::handleElectionAlarmTimeout() {
+  // Leaders don't start elections
+  if(this->getState() == LEADER) {
+    return;
+  }
+
+  // Start an election and restart the alarm
+  this->startNewElection();
+  this->setElectionAlarmValue();
+};
+
 void _server::startNewElection() {
-  //  Get node list from painlessMesh
-  auto nodeList = _mesh.getNodeList(false);
+  //  Get node list from the mesh network
+  auto& nodeList = _mesh.getNodeList(false);
 
   this->_term += 1;
   this->_voted_for = this->_id;
   this->switchState(CANDIDATE);
+  this->_metrics.increment(ELECTIONS_STARTED);
+  this->_metrics.increment(TERM_CHANGES);
 
   // Reinitialize list of votes granted
   delete this->_votes_received_ptr;
@@ -208,7 +290,19 @@ void _server::startNewElection() {
   this->_log.resetMatchIndexMap(&nodeList, 0);
   this->_log.resetNextIndexMap(&nodeList, 1);
 
-  this->_logger(DEBUG, "Started election @ %u\n", _mesh.getNodeTime());
+  this->_trace.record(this->_mesh.getNodeTime(),
+                      TRACE_ELECTION_STARTED,
+                      this->_term,
+                      this->_log.getLastLogTerm(),
+                      this->_log.getLogSize());
+  RAMEN_LOG(this->_logger,
+            DEBUG,
+            "Started election @ %u\n",
+            _mesh.getNodeTime());
+
+  // Request votes right away and keep requesting until the election ends
+  this->requestVote();
+  this->_task_request_vote.restartDelayed();
 };
 
 bool _server::getElectionResults() {
@@ -222,11 +316,12 @@ bool _server::getElectionResults() {
     }
   }
 
-  this->_logger(DEBUG,
-                "I have %u votes and more than %u votes is enough to win the "
-                "election\n",
-                granted_votes,
-                this->_votes_received_ptr->size() / 2);
+  RAMEN_LOG(this->_logger,
+            DEBUG,
+            "I have %u votes and more than %u votes is enough to win the "
+            "election\n",
+            granted_votes,
+            this->_votes_received_ptr->size() / 2);
 
   // Majority decides election win
   bool won_election = (granted_votes > (this->_votes_received_ptr->size() / 2));
@@ -239,9 +334,24 @@ void _server::broadcastData(string_t data) {};
 void _server::sendData(uint32_t receiver, string_t data) {};
 
 void _server::receiveData(uint32_t from, string_t& data) {
-  DynamicJsonDocument payload(1024);
-  deserializeJson(payload, data);
+  RAMEN_ALLOCATION_SCOPE(SERVER);
+
+  json_document_t payload(RECEIVED_PAYLOAD_SIZE);
+  DeserializationError error = deserializeJson(payload, data);
+  if(error) {
+    RAMEN_LOG(this->_logger,
+              WARNING,
+              "Dropped a malformed message from %u (%s)\n",
+              from,
+              error.c_str());
+    this->_metrics.increment(MALFORMED_MESSAGES);
+    this->_trace.record(
+        this->_mesh.getNodeTime(), TRACE_MALFORMED_MESSAGE, from);
+    return;
+  }
+
   MessageType type = payload[TYPE_FIELD_KEY];
+  this->_metrics.countReceived(type, data.length());
 
   // router
   switch(type) {
@@ -269,6 +379,14 @@ void _server::receiveData(uint32_t from, string_t& data) {
       this->handleAckFromLeaderQueue(from, payload);
       break;
 
+    case HEART_BEAT:
+      this->handleHeartBeat(from, payload);
+      break;
+
+    case HEALTH:
+      this->handleHealth(from, payload);
+      break;
+
     default:
       break;
   }
@@ -280,12 +398,12 @@ void _server::requestVote() {
   message.addFields(this->_log.getLastLogTerm(), this->_log.getLogSize());
 
   // Broadcast the message
-  _mesh.sendBroadcast(message.serialize());
+  this->broadcastMessage(message);
 
-  this->_logger(DEBUG, "Requested vote from other nodes\n");
+  RAMEN_LOG(this->_logger, DEBUG, "Requested vote from other nodes\n");
 };
 
-void _server::handleVoteRequest(uint32_t sender, DynamicJsonDocument& data) {
+void _server::handleVoteRequest(uint32_t sender, json_document_t& data) {
   // Equalize term with sender if term is lower
   if(this->_term < (uint32_t) data[TERM_FIELD_KEY]) {
     this->switchState(FOLLOWER, (uint32_t) data[TERM_FIELD_KEY]);
@@ -317,12 +435,21 @@ void _server::handleVoteRequest(uint32_t sender, DynamicJsonDocument& data) {
   Message message(SEND_VOTE, this->_term);
   message.addFields(granted);
 
-  this->_mesh.sendMessageToNode(sender, message.serialize());
-
-  this->_logger(DEBUG, "Replied to %u with %u vote\n", sender, granted);
+  this->sendMessage(sender, message);
+
+  this->_trace.record(this->_mesh.getNodeTime(),
+                      TRACE_VOTE_REQUEST,
+                      sender,
+                      (uint32_t) data[TERM_FIELD_KEY],
+                      granted);
+  RAMEN_LOG(this->_logger,
+            DEBUG,
+            "Replied to %u with %u vote\n",
+            sender,
+            granted);
 };
 
-void _server::handleVoteResponse(uint32_t sender, DynamicJsonDocument& data) {
+void _server::handleVoteResponse(uint32_t sender, json_document_t& data) {
   // Equalize term with responder if term is lower
   if(this->_term < (uint32_t) data[TERM_FIELD_KEY]) {
     this->switchState(FOLLOWER, (uint32_t) data[TERM_FIELD_KEY]);
@@ -331,63 +458,219 @@ void _server::handleVoteResponse(uint32_t sender, DynamicJsonDocument& data) {
   // Update votes received map
   bool granted = data[GRANTED_FIELD_KEY];
 
+  this->_trace.record(this->_mesh.getNodeTime(),
+                      TRACE_VOTE_RESPONSE,
+                      sender,
+                      (uint32_t) data[TERM_FIELD_KEY],
+                      granted);
+
   if(this->getState() == CANDIDATE &&
      this->_term == (uint32_t) data[TERM_FIELD_KEY]) {
     // Store received vote in votes received map
     (*(this->_votes_received_ptr))[sender] = granted;
-    this->_logger(DEBUG, "Saved vote from %u with %u vote\n", sender, granted);
+    RAMEN_LOG(this->_logger,
+              DEBUG,
+              "Saved vote from %u with %u vote\n",
+              sender,
+              granted);
 
     // Check for election results
     if(this->getElectionResults()) {
-      this->_logger(DEBUG, "Won the election @ %u\n", _mesh.getNodeTime());
+      RAMEN_LOG(this->_logger,
+                DEBUG,
+                "Won the election @ %u\n",
+                _mesh.getNodeTime());
       this->switchState(LEADER);
+      this->_metrics.increment(ELECTIONS_WON);
     } else {
-      this->_logger(DEBUG,
-                    "Did not win the election @ %u\n",
-                    this->_mesh.getNodeTime());
+      RAMEN_LOG(this->_logger,
+                DEBUG,
+                "Did not win the election @ %u\n",
+                this->_mesh.getNodeTime());
     }
   }
 };
 
-void _server::requestAppendEntries(uint32_t receiver, bool heart_beat) {
+bool _server::requestAppendEntries(uint32_t receiver) {
+  uint32_t next_index = this->_log.getNextIndex(receiver);
+
+  // Heart beats are broadcast, see broadcastHeartBeat()
+  if(next_index > this->_log.getLogSize()) {
+    return false;
+  }
+
   // Generate the message
   Message message(REQUEST_APPEND_ENTRY, this->_term);
 
-  uint32_t next_index = this->_log.getNextIndex(receiver);
   uint32_t previous_log_index = next_index - 1;
   uint32_t previous_log_term = this->_log.getLogTerm(previous_log_index);
   uint32_t commit_index = this->_commit_index;
+  uint32_t current_time = this->_mesh.getNodeTime();
+
+  // Every request gets its own ID, so that its response can be told apart
+  // from the responses to earlier requests
+  if(++this->_last_request_id == 0) {
+    ++this->_last_request_id;
+  }
+  uint32_t request_id = this->_last_request_id;
+  bool retransmit = false;
+
+  // Grab as many entries from the log as the window allows
+  ReplicationWindow& window = this->_replication_window[receiver];
+
+  // Sending again before the response means the last request or its
+  // response was lost
+  if(this->_awaiting_append_entry_response[receiver]) {
+    window.decrease();
+    retransmit = true;
+  }
+
+  // The batch has to fit in the window and in the replication budget
+  float tokens = this->_replication_bucket.getTokens(current_time);
+  uint32_t limit = std::min((float) window.getSize(), std::max(tokens, 0.0f));
+
+  // The entries point into the log, which doesn't change until the message
+  // is serialized
+  std::vector<std::pair<uint32_t, const string_t*>> entries;
+  uint32_t size = 0;
+  for(uint32_t index = next_index; index <= this->_log.getLogSize(); ++index) {
+    const string_t& data = this->_log.getLogData(index);
+    uint32_t entry_size = data.length() + ENTRY_FRAMING_SIZE;
+
+    // The first entry is sent even if it doesn't fit in the window
+    if(entries.size() > 0 && size + entry_size > limit) {
+      break;
+    }
+
+    entries.push_back(std::make_pair(this->_log.getLogTerm(index), &data));
+    size += entry_size;
+  }
 
-  // Default to heart_beat message
-  // Otherwise grab data from log
-  string_t entries = HEART_BEAT_MESSAGE;
-  if(!heart_beat &&
-     (this->_log.getNextIndex(receiver) <= this->_log.getLogSize())) {
-    entries = this->_log.getLogData(next_index);
+  // Wait for the budget, the follower is retried on the next heart beat
+  if(!this->_replication_bucket.consume(size, current_time)) {
+    RAMEN_LOG(this->_logger,
+              DEBUG,
+              "Held back append entry request to %u over the budget\n",
+              receiver);
+    this->_metrics.increment(REPLICATION_HELD_BACK);
+    return false;
   }
 
   message.addFields(previous_log_index,
                     previous_log_term,
-                    entries,
-                    commit_index);
+                    std::move(entries),
+                    commit_index,
+                    this->_heart_beat_period,
+                    this->_peer_compression[receiver],
+                    request_id);
+
+  // Entries are bulk traffic, the receiver is retried on the next heart
+  // beat if the mesh can't take them
+  if(!this->sendMessage(receiver, message, REPLICATION)) {
+    return false;
+  }
+
+  // Wait for the response before sending more entries to the receiver
+  this->_awaiting_append_entry_response[receiver] = request_id;
+
+  // Any append entry request counts as a heart beat for the receiver
+  this->_last_append_entry_time[receiver] = current_time;
+
+  // Karn's rule: retransmitted entries are not timed, their response could
+  // belong to any of the transmissions
+  this->_rtt_probe[receiver] =
+      std::make_pair(retransmit ? 0 : request_id, current_time);
 
-  this->_mesh.sendMessageToNode(receiver, message.serialize());
+  RAMEN_LOG(this->_logger,
+            DEBUG,
+            "Sent append entry request to %u\n",
+            receiver);
 
-  this->_logger(DEBUG, "Sent append entry request to %u\n", receiver);
+  return true;
 };
 
 void _server::broadcastRequestAppendEntries(bool heart_beat) {
-  auto nodeList = this->_mesh.getNodeList(false);
+  auto& nodeList = this->_mesh.getNodeList(false);
+
+  // Nodes that joined after the election start from the end of the log, the
+  // maps are only checked when the node list actually changed
+  if(this->_node_list_generation != this->_mesh.getNodeListGeneration()) {
+    this->_node_list_generation = this->_mesh.getNodeListGeneration();
+    for(auto it = nodeList.begin(); it != nodeList.end(); ++it) {
+      if(!this->_log.hasNextIndex(*it)) {
+        this->_log.setNextIndex(*it, this->_log.getLogSize() + 1);
+        this->_log.setMatchIndex(*it, 0);
+      }
+    }
+  }
+
+  uint32_t current_time = this->_mesh.getNodeTime();
+  bool needs_heart_beat = false;
 
   for(auto it = nodeList.begin(); it != nodeList.end(); ++it) {
-    this->requestAppendEntries(*it, heart_beat);
+    bool has_pending_entries =
+        this->_log.getNextIndex(*it) <= this->_log.getLogSize();
+    bool idle = this->checkFollowerIdle(*it, current_time);
+
+    if(has_pending_entries &&
+       ((!heart_beat && !this->_awaiting_append_entry_response[*it]) ||
+        idle)) {
+      // Entries are unicast, idle followers get them instead of a heart beat
+      // unless they are over the replication budget
+      if(!this->requestAppendEntries(*it) && idle) {
+        needs_heart_beat = true;
+      }
+    } else if(idle) {
+      needs_heart_beat = true;
+    }
   }
 
-  this->_logger(DEBUG, "Broadcasted append entry request to everyone!\n");
+  // A single broadcast serves all idle followers
+  if(needs_heart_beat) {
+    this->broadcastHeartBeat();
+  }
+
+  RAMEN_LOG(this->_logger,
+            DEBUG,
+            "Broadcasted append entry request to everyone!\n");
+}
+
+void _server::broadcastHeartBeat() {
+  // Generate the message
+  Message message(HEART_BEAT, this->_term);
+  message.addFields(this->_commit_index,
+                    this->_log.getLogSize(),
+                    this->_log.getLastLogTerm(),
+                    this->_heart_beat_period);
+
+  this->broadcastMessage(message);
+
+  // The heart beat reached every follower, except for the ones that are
+  // awaiting entries, they are sent the entries again once they are idle
+  uint32_t current_time = this->_mesh.getNodeTime();
+  auto& nodeList = this->_mesh.getNodeList(false);
+  for(auto it = nodeList.begin(); it != nodeList.end(); ++it) {
+    if(!this->_awaiting_append_entry_response[*it]) {
+      this->_last_append_entry_time[*it] = current_time;
+    }
+  }
+
+  RAMEN_LOG(this->_logger, DEBUG, "Broadcasted heart beat to everyone!\n");
+}
+
+bool _server::checkFollowerIdle(uint32_t follower, uint32_t current_time) {
+  auto it = this->_last_append_entry_time.find(follower);
+
+  // Never contacted followers are idle by definition
+  if(it == this->_last_append_entry_time.end()) {
+    return true;
+  }
+
+  return (uint32_t)(current_time - it->second) >= this->_heart_beat_period;
 }
 
 void _server::handleAppendEntriesRequest(uint32_t sender,
-                                         DynamicJsonDocument& data) {
+                                         json_document_t& data) {
   // Equalize term with sender if term is lower
   if(this->_term < (uint32_t) data[TERM_FIELD_KEY]) {
     this->switchState(FOLLOWER, (uint32_t) data[TERM_FIELD_KEY]);
@@ -398,59 +681,212 @@ void _server::handleAppendEntriesRequest(uint32_t sender,
   auto previousLogTerm = (uint32_t) data[PREVIOUS_LOG_TERM_FIELD_KEY];
   auto leaderCommit = (uint32_t) data[COMMIT_INDEX_FIELD_KEY];
 
-  // TODO: If we want to be able to send multiple entries in the future,
-  // create a function that can deserialize the JSON string received in the
-  // entries field
-  std::vector<std::pair<uint32_t, string_t>> received_entries;
-  string_t entry_data = data[ENTRIES_FIELD_KEY];
-  received_entries.push_back(
-      std::make_pair((uint32_t) data[TERM_FIELD_KEY], entry_data));
+  // Entries come in batches of [[term, data], ...], compressed batches are
+  // decompressed into their own document
+  std::unique_ptr<json_document_t> batch_ptr;
+  JsonArray received_entries;
+  if(!this->decodeEntries(data, batch_ptr, received_entries)) {
+    RAMEN_LOG(this->_logger,
+              WARNING,
+              "Dropped append entry request with malformed entries from "
+              "%u\n",
+              sender);
+    this->_metrics.increment(MALFORMED_MESSAGES);
+    this->_trace.record(
+        this->_mesh.getNodeTime(), TRACE_MALFORMED_MESSAGE, sender);
+    return;
+  }
 
   // Default message parameters
   Message message(RESPOND_APPEND_ENTRY, this->_term);
 
   bool message_success = false;
   uint32_t message_match_index = 0;
+  uint32_t message_conflict_term = 0;
 
-  if(data[ENTRIES_FIELD_KEY] == HEART_BEAT_MESSAGE) {
-    this->_commit_index = std::max(leaderCommit, this->_commit_index);
-    message_success = true;
-    message_match_index = this->_commit_index;
-    this->setElectionAlarmValue(5);
+  // Any append entry request from the current leader counts as a heart beat
+  if(this->_term == (uint32_t) data[TERM_FIELD_KEY]) {
+    // Time out based on the heart beat period of the leader
+    this->followHeartBeatPeriod(data[HEART_BEAT_PERIOD_FIELD_KEY]);
+
+    this->setElectionAlarmValue();
     this->_last_known_leader = sender;
-  } else if(previousLogIndex == 0 ||
-            (previousLogIndex <= this->_log.getLogSize() &&
-             this->_log.getLogTerm(previousLogIndex) == previousLogTerm)) {
+  }
+
+  if(previousLogIndex == 0 ||
+     (previousLogIndex <= this->_log.getLogSize() &&
+      this->_log.getLogTerm(previousLogIndex) == previousLogTerm)) {
     message_success = true;
 
     auto loopIndex = previousLogIndex;
 
-    for(uint32_t i = 0; i < received_entries.size(); i++) {
+    for(JsonVariant entry : received_entries) {
       ++loopIndex;
-      if(this->_log.getLogTerm(loopIndex) != received_entries[i].first) {
-        while(this->_log.getLogSize() > loopIndex) {
+      uint32_t entry_term = entry[0];
+      if(this->_log.getLogTerm(loopIndex) != entry_term) {
+        // Drop the conflicting entry and everything that follows it
+        while(this->_log.getLogSize() >= loopIndex) {
           this->_log.popEntry();
         }
-        this->_log.pushEntry(received_entries[i]);
+        // The data is read out of the document straight into the log
+        this->_log.pushEntry(
+            std::make_pair(entry_term, entry[1].as<string_t>()));
       }
     }
 
     message_match_index = loopIndex;
 
-    this->_commit_index = std::max(leaderCommit, this->_commit_index);
+    this->advanceCommitIndex(leaderCommit);
+  } else if(previousLogIndex <= this->_log.getLogSize()) {
+    // Skip the whole conflicting term at once, the leader continues from its
+    // own last entry of the term if it has any
+    message_conflict_term = this->_log.getLogTerm(previousLogIndex);
+    message_match_index =
+        this->_log.getFirstLogIndexOfTerm(message_conflict_term) - 1;
+  } else {
+    // Let the leader know where to continue from
+    message_match_index = this->_log.getLogSize();
+  }
+
+  message.addFields(message_success,
+                    message_match_index,
+                    message_conflict_term,
+                    (uint32_t) data[REQUEST_ID_FIELD_KEY]);
+
+  this->sendMessage(sender, message);
+  this->_trace.record(this->_mesh.getNodeTime(),
+                      TRACE_APPEND_ENTRIES_REQUEST,
+                      sender,
+                      message_success,
+                      message_match_index);
+  RAMEN_LOG(this->_logger,
+            DEBUG,
+            "Responded to append entry request from %u\n",
+            sender);
+};
+
+bool _server::decodeEntries(json_document_t& data,
+                            std::unique_ptr<json_document_t>& batch_ptr,
+                            JsonArray& entries) {
+#if ENABLE_COMPRESSION
+  if((uint8_t) data[ENCODING_FIELD_KEY] == broth::compression::LZF_ENCODING) {
+    string_t compressed_entries = data[ENTRIES_FIELD_KEY];
+    string_t serialized_entries;
+
+    if(!broth::compression::decompress(compressed_entries,
+                                       serialized_entries)) {
+      return false;
+    }
+
+    batch_ptr.reset(new json_document_t(RECEIVED_BATCH_SIZE));
+    if(deserializeJson(*batch_ptr, serialized_entries)) {
+      batch_ptr.reset();
+      return false;
+    }
+
+    entries = batch_ptr->as<JsonArray>();
+
+    return true;
+  }
+#endif
+
+  // Requests without entries leave the array null
+  entries = data[ENTRIES_FIELD_KEY].as<JsonArray>();
+
+  return true;
+};
+
+bool _server::sendMessage(uint32_t receiver,
+                          Message& message,
+                          MessagePriority priority) {
+  string_t serialized = message.serialize();
+  this->_metrics.countSent(message.getType(), serialized.length());
+
+  if(!this->_mesh.sendMessageToNode(
+         receiver, std::move(serialized), priority)) {
+    this->_metrics.increment(SEND_FAILURES);
+    return false;
+  }
+
+  return true;
+};
+
+bool _server::broadcastMessage(Message& message) {
+  string_t serialized = message.serialize();
+  this->_metrics.countSent(message.getType(), serialized.length());
+
+  if(!this->_mesh.sendBroadcast(std::move(serialized))) {
+    this->_metrics.increment(SEND_FAILURES);
+    return false;
+  }
+
+  return true;
+};
+
+void _server::advanceCommitIndex(uint32_t commit_index) {
+  if(commit_index <= this->_commit_index) {
+    return;
   }
 
-  message.addFields(message_success, message_match_index);
+  this->_metrics.increment(ENTRIES_COMMITTED,
+                           commit_index - this->_commit_index);
+  this->_trace.record(this->_mesh.getNodeTime(),
+                      TRACE_COMMIT_ADVANCED,
+                      commit_index,
+                      this->_commit_index);
+  this->_commit_index = commit_index;
 
-  this->_mesh.sendMessageToNode(sender, message.serialize());
-  this->_logger(DEBUG, "Responded to append entry request from %u\n", sender);
+  // Only the entries the leader appended are timed
+  this->_metrics.commitEntries(commit_index, this->_mesh.getNodeTime());
+};
+
+void _server::handleHeartBeat(uint32_t sender, json_document_t& data) {
+  // Equalize term with sender if term is lower
+  if(this->_term < (uint32_t) data[TERM_FIELD_KEY]) {
+    this->switchState(FOLLOWER, (uint32_t) data[TERM_FIELD_KEY]);
+  }
+
+  auto leaderCommit = (uint32_t) data[COMMIT_INDEX_FIELD_KEY];
+  auto lastLogIndex = (uint32_t) data[LAST_LOG_INDEX_FIELD_KEY];
+  auto lastLogTerm = (uint32_t) data[LAST_LOG_TERM_FIELD_KEY];
+
+  if(this->_term == (uint32_t) data[TERM_FIELD_KEY]) {
+    // Time out based on the heart beat period of the leader
+    this->followHeartBeatPeriod(data[HEART_BEAT_PERIOD_FIELD_KEY]);
+
+    this->setElectionAlarmValue();
+    this->_last_known_leader = sender;
+
+    // Stay quiet if the log has the last entry of the leader, only the
+    // entries up to that point are known to match the leader's log
+    if(lastLogIndex <= this->_log.getLogSize() &&
+       this->_log.getLogTerm(lastLogIndex) == lastLogTerm) {
+      this->advanceCommitIndex(std::min(leaderCommit, lastLogIndex));
+      return;
+    }
+  }
+
+  // Ask for entries, or let a stale leader know about the newer term. The
+  // log size tells the leader where to continue from.
+  Message message(RESPOND_APPEND_ENTRY, this->_term);
+  message.addFields(false, this->_log.getLogSize());
+
+  this->sendMessage(sender, message);
+  RAMEN_LOG(this->_logger, DEBUG, "Responded to heart beat from %u\n", sender);
 };
 
 void _server::handleAppendEntriesResponse(uint32_t sender,
-                                          DynamicJsonDocument& data) {
+                                          json_document_t& data) {
   auto sender_term = (uint32_t) data[TERM_FIELD_KEY];
   auto success = (bool) data[SUCCESS_FIELD_KEY];
   auto sender_match_index = (uint32_t) data[MATCH_INDEX_FIELD_KEY];
+  auto sender_conflict_term = (uint32_t) data[CONFLICT_TERM_FIELD_KEY];
+
+  this->_trace.record(this->_mesh.getNodeTime(),
+                      TRACE_APPEND_ENTRIES_RESPONSE,
+                      sender,
+                      success,
+                      sender_match_index);
 
   // Equalize term with sender if term is lower
   if(this->_term < sender_term) {
@@ -458,34 +894,121 @@ void _server::handleAppendEntriesResponse(uint32_t sender,
   }
 
   if(this->_term == sender_term) {
+    // Only the response to the entries in flight steers the window, the
+    // responses to heart beats and to older requests don't
+    auto request_id = (uint32_t) data[REQUEST_ID_FIELD_KEY];
+    bool awaited = request_id > 0 &&
+                   this->_awaiting_append_entry_response[sender] == request_id;
+    if(awaited) {
+      this->_awaiting_append_entry_response[sender] = 0;
+    }
+
+    // Every response tells whether the follower can decompress entries
+    this->_peer_compression[sender] = (bool) data[COMPRESSION_FIELD_KEY];
+
+    // Only the response to the last timed request measures the round trip
+    // time, responses to heart beats and to older requests don't
+    auto probe = this->_rtt_probe.find(sender);
+    if(request_id > 0 && probe != this->_rtt_probe.end() &&
+       probe->second.first == request_id) {
+      uint32_t rtt = this->_mesh.getNodeTime() - probe->second.second;
+      this->_peer_rtt[sender].addSample(rtt);
+      this->_metrics.getRpcLatency().add(rtt);
+      this->updateHeartBeatPeriod();
+      this->_rtt_probe.erase(probe);
+    }
+
+    if(awaited) {
+      if(success) {
+        this->_replication_window[sender].increase();
+      } else {
+        this->_replication_window[sender].decrease();
+      }
+    }
+
     if(success) {
       this->_log.setMatchIndex(sender, sender_match_index);
       this->_log.setNextIndex(sender, sender_match_index + 1);
-      this->_logger(
+      RAMEN_LOG(
+          this->_logger,
           DEBUG,
           "Set follower %u match index to %u since append entry succeeded\n",
           sender,
           sender_match_index);
 
+      this->advanceCommitIndex(this->_log.getMajorityCommitIndex());
+
+    } else if(request_id == 0) {
+      // Heart beats are answered with the log size of a follower that misses
+      // the last entry of the leader, continue right after it. The next
+      // request checks whether the entries before it match.
+      this->_log.setNextIndex(
+          sender,
+          std::min(sender_match_index + 1, this->_log.getLogSize() + 1));
+      RAMEN_LOG(this->_logger,
+                DEBUG,
+                "Moved follower %u next index to %u since it missed the heart "
+                "beat\n",
+                sender,
+                this->_log.getNextIndex(sender));
     } else {
+      // The match index of a failed response is the log size of the
+      // follower, or the entry before its conflicting term, so there is no
+      // need to step back beyond it one by one
+      uint32_t next_index = sender_match_index + 1;
+
+      // The follower may already have the leader's entries of the
+      // conflicting term
+      uint32_t last_index_of_term =
+          this->_log.getLastLogIndexOfTerm(sender_conflict_term);
+      if(sender_conflict_term > 0 && last_index_of_term > 0) {
+        next_index = last_index_of_term + 1;
+      }
+
       this->_log.setNextIndex(
           sender,
-          std::max((uint32_t) 1, this->_log.getNextIndex(sender) - 1));
-      this->_logger(DEBUG,
-                    "Decremented follower %u next index to %u since append "
-                    "entry failed\n",
-                    sender,
-                    this->_log.getNextIndex(sender));
+          std::max((uint32_t) 1,
+                   std::min(this->_log.getNextIndex(sender) - 1, next_index)));
+      RAMEN_LOG(this->_logger,
+                DEBUG,
+                "Decremented follower %u next index to %u since append "
+                "entry failed\n",
+                sender,
+                this->_log.getNextIndex(sender));
+    }
+
+    // Keep the follower busy if it still has entries to catch up with, the
+    // entries in flight are sent again once the follower is idle
+    if(this->getState() == LEADER &&
+       !this->_awaiting_append_entry_response[sender] &&
+       this->_log.getNextIndex(sender) <= this->_log.getLogSize()) {
+      this->requestAppendEntries(sender);
     }
   }
 };
 
 bool _server::distribute(string_t data, bool ack) {
+  RAMEN_ALLOCATION_SCOPE(SERVER);
+
   bool success = false;
 
+  // Entries are sent at least one at a time, larger ones would not fit in
+  // the documents of the followers and be sent again forever
+  if(data.length() + ENTRY_FRAMING_SIZE > MAX_REPLICATION_WINDOW) {
+    RAMEN_LOG(this->_logger,
+              WARNING,
+              "Refused to distribute %u bytes, more than a replication "
+              "window\n",
+              (uint32_t) data.length());
+    return false;
+  }
+
   // TODO: Check for ack and push ack into the queue
   this->_data_queue.push(data);
 
+  // Move the data towards the leader on the next scheduler pass
+  this->_task_data_queue.enableIfNot();
+
   // this->_logger(DEBUG, "I called distribute to share: \n");
   // this->_logger(DEBUG, data);
   // this->_logger(DEBUG, "\n");
@@ -493,20 +1016,29 @@ bool _server::distribute(string_t data, bool ack) {
   return ((ack == false) ? true : success);
 };
 
-void _server::moveDataFromQueueToLog(uint32_t sender,
-                                     DynamicJsonDocument& data) {
-  string_t received_data = data[DISTRIBUTE_ENTRY_KEY];
+void _server::moveDataFromQueueToLog(uint32_t sender, json_document_t& data) {
   bool send_ack = data[DISTRIBUTE_ENTRY_SEND_ACK_KEY];
 
   // Use leader's term instead of sender term
-  this->_log.pushEntry(std::make_pair(this->_term, received_data));
+  this->_log.pushEntry(
+      std::make_pair(this->_term, data[DISTRIBUTE_ENTRY_KEY].as<string_t>()));
+
+  // Replicate the new entry right away instead of waiting for a heart beat
+  if(this->getState() == LEADER) {
+    this->_metrics.increment(ENTRIES_APPENDED);
+    this->_metrics.trackEntry(this->_log.getLogSize(),
+                              this->_mesh.getNodeTime());
+    // The leader counts towards the majority, alone it commits right away
+    this->advanceCommitIndex(this->_log.getMajorityCommitIndex());
+    this->broadcastRequestAppendEntries(false);
+  }
 
   if(send_ack) {
     // Generate the message
     Message message(DISTRIBUTE_ENTRY_ACK, this->_term);
     // TODO: Grab real message id once we have it
     message.addFields(666, true);
-    this->_mesh.sendMessageToNode(sender, message.serialize());
+    this->sendMessage(sender, message, CLIENT);
   }
 
   // this->_logger(DEBUG, "I moved data from my queue to  my log: \n");
@@ -515,34 +1047,208 @@ void _server::moveDataFromQueueToLog(uint32_t sender,
 };
 
 void _server::sendLocalQueueDataToLeaderQueue() {
+  bool pushed_to_own_log = false;
+
   // Pop from data queue only if it is not empty
-  if(!(this->_data_queue.checkEmpty())) {
+  while(!(this->_data_queue.checkEmpty())) {
     if(this->getState() == LEADER) {
-      string_t data = this->_data_queue.pop();
-
       // Push to own log
-      this->_log.pushEntry(std::make_pair(this->_term, data));
-      this->_logger(DEBUG,
-                    "I sent data from my local queue to my own log, since I'm "
-                    "the beloved leader\n");
+      this->_log.pushEntry(
+          std::make_pair(this->_term, this->_data_queue.pop()));
+      this->_metrics.increment(ENTRIES_APPENDED);
+      this->_metrics.trackEntry(this->_log.getLogSize(),
+                                this->_mesh.getNodeTime());
+      pushed_to_own_log = true;
+      RAMEN_LOG(this->_logger,
+                DEBUG,
+                "I sent data from my local queue to my own log, since I'm "
+                "the beloved leader\n");
     } else if(this->_last_known_leader != INFINITY) {
-      string_t data = this->_data_queue.pop();
-
       // Generate the message
       Message message(DISTRIBUTE_ENTRY, this->_term);
       // TODO: read ack/nack from data queue
-      message.addFields(data, false);
-      this->_mesh.sendMessageToNode(this->_last_known_leader,
-                                    message.serialize());
-      this->_logger(
+      message.addFields(this->_data_queue.peek(), false);
+
+      // The data stays in the queue until the mesh takes it, try again on
+      // the next run
+      if(!this->sendMessage(this->_last_known_leader, message, CLIENT)) {
+        return;
+      }
+      this->_data_queue.pop();
+      RAMEN_LOG(
+          this->_logger,
           DEBUG,
           "I sent data from my local queue to my beloved leader's queue\n");
+    } else {
+      // Try again on the next run when there might be a known leader
+      return;
     }
   }
+
+  // Nothing left to send, sleep until distribute() is called again
+  this->_task_data_queue.disable();
+
+  // Replicate the new entries right away instead of waiting for a heart beat
+  if(pushed_to_own_log) {
+    // The leader counts towards the majority, alone it commits right away
+    this->advanceCommitIndex(this->_log.getMajorityCommitIndex());
+    this->broadcastRequestAppendEntries(false);
+  }
 };
 
-void _server::handleAckFromLeaderQueue(uint32_t sender,
-                                       DynamicJsonDocument& data) {
+void _server::handleAckFromLeaderQueue(uint32_t sender, json_document_t& data) {
   // TODO: parse the message and then send ack/nack result to callback
   // function
 }
+
+MetricsSnapshot _server::getMetrics() {
+  MetricsSnapshot snapshot;
+  snapshot.metrics = this->_metrics;
+  snapshot.state = this->_state;
+  snapshot.term = this->_term;
+  snapshot.log_size = this->_log.getLogSize();
+  snapshot.commit_index = this->_commit_index;
+  snapshot.commit_lag =
+      (snapshot.log_size > this->_commit_index)
+          ? snapshot.log_size - this->_commit_index
+          : 0;
+  snapshot.queue_depth = this->_data_queue.getSize();
+  snapshot.heart_beat_period = this->_heart_beat_period;
+
+  return snapshot;
+};
+
+Trace& _server::getTrace() {
+  return this->_trace;
+};
+
+void _server::dumpTrace() {
+  this->_trace.dump(this->_id);
+};
+
+HealthSummary _server::getHealthSummary() {
+  HealthSummary health;
+  health.term = this->_term;
+  health.state = this->_state;
+  health.commit_index = this->_commit_index;
+  health.log_size = this->_log.getLogSize();
+  health.queue_depth = this->_data_queue.getSize();
+  health.elections = this->_metrics.get(ELECTIONS_STARTED);
+  health.send_failures = this->_metrics.get(SEND_FAILURES);
+  health.rpc_latency = this->_metrics.getRpcLatency().getPercentile(50);
+  health.commit_latency = this->_metrics.getCommitLatency().getPercentile(50);
+
+  return health;
+};
+
+void _server::setHealthBroadcastPeriod(uint32_t period) {
+  if(period > 0 && period < MIN_HEALTH_BROADCAST_PERIOD) {
+    period = MIN_HEALTH_BROADCAST_PERIOD;
+  }
+
+  this->_health_broadcast_period = period;
+  this->_task_health.setInterval(period / 1000);
+
+  // Before init() the task is enabled once it is on the scheduler
+  if(period > 0) {
+    this->_task_health.restartDelayed();
+  } else {
+    this->_task_health.disable();
+  }
+};
+
+void _server::setHealthCallback(health_callback_t health_callback) {
+  this->_health_callback = health_callback;
+};
+
+void _server::broadcastHealth() {
+  // Generate the message
+  Message message(HEALTH, this->_term);
+  message.addFields(this->getHealthSummary());
+
+  this->broadcastMessage(message);
+
+  RAMEN_LOG(this->_logger, DEBUG, "Broadcasted health summary to everyone!\n");
+};
+
+void _server::handleHealth(uint32_t sender, json_document_t& data) {
+  if(!this->_health_callback) {
+    return;
+  }
+
+  HealthSummary health;
+  health.term = data[TERM_FIELD_KEY];
+  health.state = data[STATE_FIELD_KEY];
+  health.commit_index = data[COMMIT_INDEX_FIELD_KEY];
+  health.log_size = data[LOG_SIZE_FIELD_KEY];
+  health.queue_depth = data[QUEUE_DEPTH_FIELD_KEY];
+  health.elections = data[ELECTIONS_FIELD_KEY];
+  health.send_failures = data[SEND_FAILURES_FIELD_KEY];
+  health.rpc_latency = data[RPC_LATENCY_FIELD_KEY];
+  health.commit_latency = data[COMMIT_LATENCY_FIELD_KEY];
+
+  this->_health_callback(sender, health);
+};
+
+  /////////////////////////////////////////////////
+  // Methods used only during testing
+  /////////////////////////////////////////////////
+
+#ifdef _RAMEN_UNIT_TESTING_
+
+uint32_t _server::getTimeUntilNextTask() {
+  Scheduler& scheduler = this->_mesh.getScheduler();
+  Task* tasks[] = {&this->_task_election,
+                   &this->_task_request_vote,
+                   &this->_task_heart_beat,
+                   &this->_task_data_queue,
+                   &this->_task_health};
+
+  uint32_t time_until_next_task = INFINITY;
+  for(auto task : tasks) {
+    long time_until_task = scheduler.timeUntilNextIteration(*task);
+
+    // Disabled tasks are -1
+    if(time_until_task >= 0) {
+      time_until_next_task =
+          std::min(time_until_next_task, (uint32_t) time_until_task * 1000);
+    }
+  }
+
+  return time_until_next_task;
+};
+
+void _server::restart() {
+  this->_state = FOLLOWER;
+  this->_term = 0;
+  this->_voted_for = 0;
+  this->_last_known_leader = INFINITY;
+  this->_commit_index = 0;
+  this->_node_list_generation = 0;
+
+  this->_log = LogHolder();
+  this->_data_queue = DataQueue();
+  delete this->_votes_received_ptr;
+  this->_votes_received_ptr = NULL;
+  this->_last_append_entry_time.clear();
+  this->_awaiting_append_entry_response.clear();
+  this->_rtt_probe.clear();
+  this->_peer_rtt.clear();
+  this->_replication_window.clear();
+  this->_peer_compression.clear();
+  this->_replication_bucket.init(REPLICATION_RATE, REPLICATION_BURST);
+  this->_metrics = Metrics();
+  this->_trace.clear();
+  this->_mesh.dropMessages();
+
+  this->_task_request_vote.disable();
+  this->_task_heart_beat.disable();
+  this->_task_data_queue.disable();
+
+  // The heart beat period is kept, tests set it before init() to speed up
+  // the elections
+  this->setElectionAlarmValue();
+  RAMEN_LOG(this->_logger, DEBUG, "Just restarted the node!\n");
+};
+
+#endif
@@ -7,6 +7,7 @@
 #define _RAMEN_SERVER_HPP_
 
 #include <ctime>
+#include <memory>
 #include <unordered_map>
 #include <vector>
 
@@ -16,6 +17,8 @@
 #include "ramen/logger.hpp"
 #include "ramen/mesh_network.hpp"
 #include "ramen/message.hpp"
+#include "ramen/metrics.hpp"
+#include "ramen/trace.hpp"
 #include "ramen/utils.hpp"
 
 namespace broth {
@@ -24,6 +27,7 @@ namespace server {
   using namespace broth::logholder;
   using namespace broth::meshnetwork;
   using namespace broth::logger;
+  using namespace broth::metrics;
   using namespace broth::utils;
 
   /**
@@ -32,6 +36,20 @@ namespace server {
    */
   typedef enum { FOLLOWER = 0, CANDIDATE = 1, LEADER = 2 } ServerState;
 
+  /**
+   * @brief Structure for defining the election cost callback type, lower
+   * costs make a node more eligible to become the leader
+   *
+   */
+  typedef std::function<float()> election_cost_callback_t;
+
+  /**
+   * @brief Structure for defining the health callback type, which gets the
+   * sender and its health summary
+   *
+   */
+  typedef std::function<void(uint32_t, HealthSummary&)> health_callback_t;
+
   /**
    * @brief Class that manages the consensus on the mesh network
    *
@@ -47,18 +65,44 @@ namespace server {
     LogHolder _log;
     DataQueue _data_queue;
     uint32_t _election_alarm;
-    uint32_t _previous_node_time;
-    bool _received_new_append_entry_request;
+    Random _random;
     std::unordered_map<uint32_t, bool>* _votes_received_ptr = NULL;
+    // last_append_entry_time:{server_id, time_of_last_append_entry_request}
+    std::unordered_map<uint32_t, uint32_t> _last_append_entry_time;
+    // awaiting_append_entry_response:{server_id, request_id_in_flight}, 0 once
+    // the last entries were acknowledged
+    std::unordered_map<uint32_t, uint32_t> _awaiting_append_entry_response;
+    // rtt_probe:{server_id, {request_id, send_time}} of the last request to
+    // each follower that is timed, request ID 0 is not timed
+    std::unordered_map<uint32_t, std::pair<uint32_t, uint32_t>> _rtt_probe;
+    uint32_t _last_request_id = 0;
+    // peer_rtt:{server_id, round_trip_time_estimates_of_server_id}
+    std::unordered_map<uint32_t, RoundTripTimeEstimator> _peer_rtt;
+    // replication_window:{server_id, bytes_of_entries_per_request}
+    std::unordered_map<uint32_t, ReplicationWindow> _replication_window;
+    // Budget of the entries sent to all followers together
+    TokenBucket _replication_bucket;
+    // peer_compression:{server_id, can_decompress_entries}
+    std::unordered_map<uint32_t, bool> _peer_compression;
+    uint32_t _heart_beat_period;
+    election_cost_callback_t _election_cost_callback = NULL;
     uint32_t _last_heart_beat;
     Logger _logger;
     MeshNetwork _mesh;
-    Task* _task_election_ptr;
     uint32_t _commit_index;
-    Timer _raft_timer;
-    Timer _heart_beat_timer;
-    Timer _request_vote_timer;
-    Timer _request_append_entry_timer;
+    // Generation of the node list that the leader last went through
+    uint32_t _node_list_generation = 0;
+    Metrics _metrics;
+    Trace _trace;
+    uint32_t _health_broadcast_period = HEALTH_BROADCAST_PERIOD;
+    health_callback_t _health_callback = NULL;
+    // Tasks are declared after _mesh, so they are removed from its scheduler
+    // before the scheduler itself is destroyed
+    Task _task_election;
+    Task _task_request_vote;
+    Task _task_heart_beat;
+    Task _task_data_queue;
+    Task _task_health;
 
    public:
     /**
@@ -82,9 +126,32 @@ namespace server {
               uint16_t mesh_port,
               uint8_t logging_level = INFO);
 
+    /**
+     * @brief Select one of the built-in transports to run on, call it before
+     * init(). painlessMesh is used if no transport is selected.
+     * Return true if the operation was successful, false otherwise
+     *
+     * @param mesh_network_type Type of the mesh network to use
+     * @return true
+     * @return false
+     */
+    bool setTransport(MeshNetworkType mesh_network_type);
+
+    /**
+     * @brief Select a user-defined transport to run on, call it before
+     * init(). The transport has to outlive the server.
+     *
+     * @param transport_ptr
+     */
+    void setTransport(Transport* transport_ptr);
+
     /**
      * @brief Perform crucial maintenance task.
      *
+     * Raft work is event driven, the election alarm, heart beats and data
+     * queue are tasks on the scheduler of the mesh network, which only run
+     * when they are due.
+     *
      * Add this to your loop() function.
      */
     void update();
@@ -108,16 +175,58 @@ namespace server {
     /**
      * @brief Set the election alarm value
      *
-     * @param min_val Defaults to 1
+     * The alarm is randomized between one and two times a base value, which
+     * is derived from the heart beat period within the configured bounds, and
+     * delayed by up to one more base value depending on the election cost
+     */
+    void setElectionAlarmValue();
+
+    /**
+     * @brief Set a user-defined election cost, which replaces the default
+     * cost based on the position of the node in the mesh network
+     *
+     * The candidacy of a node is delayed by its cost, so the node with the
+     * lowest cost usually becomes the leader. A cost of 1 delays the
+     * candidacy as much as being one hop further away from the other nodes
+     * on average does. The callback runs every time the election alarm is
+     * set, so it should be cheap.
+     *
+     * @param election_cost_callback A function that returns the cost, you can
+     * use a lambda function
      */
-    void setElectionAlarmValue(uint32_t min_val = 1);
+    void setElectionCostCallback(
+        election_cost_callback_t election_cost_callback);
 
     /**
-     * @brief Checks for whether the timeout interval has elapsed for an
-     * election
+     * @brief Get the election cost of the node, which is by default the
+     * average hop count to the other nodes minus one, so a node that is
+     * directly connected to all other nodes has no cost
      *
+     * @return float
      */
-    void checkForElectionAlarmTimeout();
+    float getElectionCost();
+
+    /**
+     * @brief Derive the heart beat period from the round trip times measured
+     * between append entry requests and their responses
+     *
+     */
+    void updateHeartBeatPeriod();
+
+    /**
+     * @brief Follow the heart beat period advertised by the leader, bounded by
+     * MIN_HEART_BEAT_TIMER_PERIOD and MAX_HEART_BEAT_TIMER_PERIOD
+     *
+     * @param heart_beat_period 0 if the leader didn't advertise any
+     */
+    void followHeartBeatPeriod(uint32_t heart_beat_period);
+
+    /**
+     * @brief Starts a new election when the election alarm goes off, called by
+     * the election task
+     *
+     */
+    void handleElectionAlarmTimeout();
 
     /**
      * @brief Start a new election
@@ -165,50 +274,141 @@ namespace server {
      * @brief Handle incoming vote request as a follower
      *
      * @param sender Address of the sender node
-     * @param data Data received in DynamicJsonDocument format
+     * @param data Data received in json_document_t format
      */
-    void handleVoteRequest(uint32_t sender, DynamicJsonDocument& data);
+    void handleVoteRequest(uint32_t sender, json_document_t& data);
 
     /**
      * @brief Handle the response of a follower to the vote request
      *
      * @param sender Address of the sender node
-     * @param data Data received in DynamicJsonDocument format
+     * @param data Data received in json_document_t format
      */
-    void handleVoteResponse(uint32_t sender, DynamicJsonDocument& data);
+    void handleVoteResponse(uint32_t sender, json_document_t& data);
 
     /**
-     * @brief Request a follower to append an entry to its log
+     * @brief Request a follower to append entries to its log. The request
+     * carries as many entries as fit in the replication window of the
+     * follower, and nothing is sent while the leader is over its replication
+     * budget.
      *
      * @param receiver Address of the receiver node
-     * @param data Data to send in JSON format
+     * @return true If a request was sent
+     * @return false If the receiver has no pending entries, or they were held
+     * back
      */
-    void requestAppendEntries(uint32_t receiver, bool heart_beat = true);
+    bool requestAppendEntries(uint32_t receiver);
 
     /**
      * @brief Parent function of requestAppendEntries
      * Sends append entry request to all nodes in the network
      *
-     * @param data
+     * Followers that received any append entry request within the last heart
+     * beat period are skipped during a heart beat round, since that request
+     * already served as their heart beat. Idle followers with pending entries
+     * get their entries instead of a heart beat, the other idle followers
+     * share a single broadcast heart beat.
+     *
+     * @param heart_beat If false, followers with pending entries are sent
+     * their entries even if they are not idle
      */
     void broadcastRequestAppendEntries(bool heart_beat = true);
 
+    /**
+     * @brief Broadcast a heart beat to all nodes in the network with a single
+     * message, instead of sending an append entry request to each of them
+     *
+     */
+    void broadcastHeartBeat();
+
+    /**
+     * @brief Checks whether a follower has not been sent any append entry
+     * request for a heart beat period
+     *
+     * @param follower Address of the follower node
+     * @param current_time Current node time
+     * @return true If the follower needs a heart beat
+     * @return false If the follower was contacted recently
+     */
+    bool checkFollowerIdle(uint32_t follower, uint32_t current_time);
+
     /**
      * @brief Handle the incoming request to append an entry as a follower
      *
      * @param sender Address of the sender node
-     * @param data Data received in DynamicJsonDocument format
+     * @param data Data received in json_document_t format
+     */
+    void handleAppendEntriesRequest(uint32_t sender, json_document_t& data);
+
+    /**
+     * @brief Get the entries of an append entry request without copying
+     * them, decompressing them if needed
+     * Return true if the operation was successful, false otherwise
+     *
+     * @param data Append entry request
+     * @param batch_ptr Output, the document of the decompressed entries, which
+     * has to outlive the entries. Empty if the entries were not compressed.
+     * @param entries Output, points into data or batch_ptr, null for heart
+     * beats
+     * @return true
+     * @return false If the entries are malformed
      */
-    void handleAppendEntriesRequest(uint32_t sender, DynamicJsonDocument& data);
+    bool decodeEntries(json_document_t& data,
+                       std::unique_ptr<json_document_t>& batch_ptr,
+                       JsonArray& entries);
+
+    /**
+     * @brief Serialize a message and send it to a node in the mesh network,
+     * counting it in the metrics
+     * Return true if the mesh network took the message, false otherwise
+     *
+     * @param receiver Address of the receiver node
+     * @param message
+     * @param priority Priority class of the message
+     * @return true
+     * @return false
+     */
+    bool sendMessage(uint32_t receiver,
+                     Message& message,
+                     MessagePriority priority = CONTROL);
+
+    /**
+     * @brief Serialize a message and broadcast it to the whole mesh network,
+     * counting it in the metrics
+     * Return true if the mesh network took the message, false otherwise
+     *
+     * @param message
+     * @return true
+     * @return false
+     */
+    bool broadcastMessage(Message& message);
+
+    /**
+     * @brief Raise the commit index, and time the commits of the entries the
+     * leader appended
+     *
+     * @param commit_index The commit index is never lowered
+     */
+    void advanceCommitIndex(uint32_t commit_index);
+
+    /**
+     * @brief Handle the incoming heart beat as a follower
+     *
+     * Followers only respond if their log does not have the last entry of the
+     * leader, so that they get the entries they miss
+     *
+     * @param sender Address of the sender node
+     * @param data Data received in json_document_t format
+     */
+    void handleHeartBeat(uint32_t sender, json_document_t& data);
 
     /**
      * @brief Handle the response of a follower to append an entry
      *
      * @param sender Address of the sender node
-     * @param data Data received in DynamicJsonDocument format
+     * @param data Data received in json_document_t format
      */
-    void handleAppendEntriesResponse(uint32_t sender,
-                                     DynamicJsonDocument& data);
+    void handleAppendEntriesResponse(uint32_t sender, json_document_t& data);
 
     /**
      * @brief For a leader, move the data available in the queue to the
@@ -217,7 +417,7 @@ namespace server {
      * @param sender
      * @param data
      */
-    void moveDataFromQueueToLog(uint32_t sender, DynamicJsonDocument& data);
+    void moveDataFromQueueToLog(uint32_t sender, json_document_t& data);
 
     /**
      * @brief  Send the data available in the local queue to the consensus
@@ -234,6 +434,9 @@ namespace server {
      *
      * If ack = false, it will always return true
      *
+     * Data that does not fit in a replication window with its framing is
+     * refused with false, see MAX_REPLICATION_WINDOW.
+     *
      * @param data
      * @param ack
      * @return true
@@ -241,6 +444,71 @@ namespace server {
      */
     bool distribute(string_t data, bool ack = true);
 
+    /**
+     * @brief Get a copy of the counters and latency histograms of the node,
+     * along with its current state
+     *
+     * Nothing is allocated by counting, the metrics have a fixed size.
+     *
+     * @return MetricsSnapshot
+     */
+    MetricsSnapshot getMetrics();
+
+    /**
+     * @brief Get the trace of the state changes and the handled requests of
+     * the node
+     *
+     * @return Trace&
+     */
+    Trace& getTrace();
+
+    /**
+     * @brief Print the trace of the node over the serial port, decode it with
+     * simulation/scripts/decode_trace.py
+     *
+     */
+    void dumpTrace();
+
+    /**
+     * @brief Get the summary of the metrics that the node broadcasts
+     *
+     * @return HealthSummary
+     */
+    HealthSummary getHealthSummary();
+
+    /**
+     * @brief Broadcast the health summary of the node periodically, so that a
+     * gateway node can collect the stats of the whole mesh network
+     *
+     * @param period Microseconds between the broadcasts, 0 stops them.
+     * Shorter periods than MIN_HEALTH_BROADCAST_PERIOD are raised to it.
+     */
+    void setHealthBroadcastPeriod(uint32_t period);
+
+    /**
+     * @brief Set a user-defined callback for the health summaries broadcast
+     * by the other nodes
+     *
+     * @param health_callback A function that takes the sender and its
+     * summary, you can use a lambda function
+     */
+    void setHealthCallback(health_callback_t health_callback);
+
+    /**
+     * @brief Broadcast the health summary of the node, called by the health
+     * task
+     *
+     */
+    void broadcastHealth();
+
+    /**
+     * @brief Pass the health summary of another node to the health callback
+     *
+     * @param sender Address of the sender node
+     * @param data Data received in json_document_t format
+     */
+    void handleHealth(uint32_t sender, json_document_t& data);
+
     /**
      * @brief Call the user-defined callback when the acknowledgement from the
      * leader is received
@@ -248,7 +516,33 @@ namespace server {
      * @param sender
      * @param data
      */
-    void handleAckFromLeaderQueue(uint32_t sender, DynamicJsonDocument& data);
+    void handleAckFromLeaderQueue(uint32_t sender, json_document_t& data);
+
+    /////////////////////////////////////////////////
+    // Methods used only during testing
+    /////////////////////////////////////////////////
+
+#ifdef _RAMEN_UNIT_TESTING_
+
+    /**
+     * @brief Get the time until the next Raft task is due, so that a simulator
+     * can skip the time in between
+     * [NOTE: Used for testing purposes only]
+     *
+     * @return uint32_t Microseconds, rounded to the milliseconds of the
+     * scheduler. INFINITY if no task is enabled.
+     */
+    uint32_t getTimeUntilNextTask();
+
+    /**
+     * @brief Forget everything a reboot would, which is all of the Raft state
+     * since nothing is persisted, and start over as a follower
+     * [NOTE: Used for testing purposes only]
+     *
+     */
+    void restart();
+
+#endif
   };
 
 } // namespace server
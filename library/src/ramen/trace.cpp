@@ -0,0 +1,132 @@
+/**
+ * @file trace.cpp
+ * @brief trace.cpp
+ *
+ */
+#include "ramen/trace.hpp"
+
+#include <algorithm>
+
+using _trace = broth::logger::Trace;
+using namespace broth::logger;
+
+#define TRACE_VERSION     1
+#define TRACE_HEADER_SIZE 16
+#define TRACE_EVENT_SIZE  20
+
+/**
+ * @brief Write a little endian integer of the given number of bytes
+ *
+ */
+static void writeInteger(uint8_t* buffer_ptr, uint32_t value, uint32_t bytes) {
+  for(uint32_t i = 0; i < bytes; ++i) {
+    buffer_ptr[i] = (value >> (8 * i)) & 0xFF;
+  }
+}
+
+_trace::Trace() {};
+
+void _trace::record(uint32_t time,
+                    TraceEventType type,
+                    uint32_t arg0,
+                    uint32_t arg1,
+                    uint32_t arg2) {
+  TraceEvent& event = this->_events[this->_recorded % TRACE_SIZE];
+  event.time = time;
+  event.args[0] = arg0;
+  event.args[1] = arg1;
+  event.args[2] = arg2;
+  event.type = type;
+  event.sequence = this->_recorded;
+
+  ++this->_recorded;
+};
+
+uint32_t _trace::getSize() {
+  return (this->_recorded < TRACE_SIZE) ? this->_recorded : TRACE_SIZE;
+};
+
+uint32_t _trace::getRecorded() {
+  return this->_recorded;
+};
+
+TraceEvent& _trace::getEvent(uint32_t index) {
+  // The oldest event is the next one to be overwritten once the trace is full
+  uint32_t oldest = this->_recorded - this->getSize();
+  return this->_events[(oldest + index) % TRACE_SIZE];
+};
+
+void _trace::clear() {
+  this->_recorded = 0;
+};
+
+uint32_t _trace::getSerializedSize() {
+  return TRACE_HEADER_SIZE + TRACE_EVENT_SIZE * this->getSize();
+};
+
+uint32_t _trace::serialize(uint32_t node_id,
+                           uint8_t* buffer_ptr,
+                           uint32_t size) {
+  if(size < TRACE_HEADER_SIZE) {
+    return 0;
+  }
+
+  uint32_t count = std::min(this->getSize(),
+                            (size - TRACE_HEADER_SIZE) / TRACE_EVENT_SIZE);
+  this->serializeHeader(node_id, count, buffer_ptr);
+  for(uint32_t i = 0; i < count; ++i) {
+    serializeEvent(this->getEvent(i),
+                   buffer_ptr + TRACE_HEADER_SIZE + TRACE_EVENT_SIZE * i);
+  }
+
+  return TRACE_HEADER_SIZE + TRACE_EVENT_SIZE * count;
+};
+
+void _trace::dump(uint32_t node_id) {
+  uint8_t line[TRACE_EVENT_SIZE];
+
+  this->serializeHeader(node_id, this->getSize(), line);
+  printLine(line, TRACE_HEADER_SIZE);
+  for(uint32_t i = 0; i < this->getSize(); ++i) {
+    serializeEvent(this->getEvent(i), line);
+    printLine(line, TRACE_EVENT_SIZE);
+  }
+};
+
+void _trace::serializeHeader(uint32_t node_id,
+                             uint16_t count,
+                             uint8_t* buffer_ptr) {
+  buffer_ptr[0] = 'R';
+  buffer_ptr[1] = 'T';
+  buffer_ptr[2] = 'R';
+  buffer_ptr[3] = 'C';
+  buffer_ptr[4] = TRACE_VERSION;
+  buffer_ptr[5] = TRACE_EVENT_SIZE;
+  writeInteger(buffer_ptr + 6, count, 2);
+  writeInteger(buffer_ptr + 8, node_id, 4);
+  writeInteger(buffer_ptr + 12, this->_recorded, 4);
+};
+
+void _trace::serializeEvent(TraceEvent& event, uint8_t* buffer_ptr) {
+  writeInteger(buffer_ptr, event.time, 4);
+  writeInteger(buffer_ptr + 4, event.type, 2);
+  writeInteger(buffer_ptr + 6, event.sequence, 2);
+  writeInteger(buffer_ptr + 8, event.args[0], 4);
+  writeInteger(buffer_ptr + 12, event.args[1], 4);
+  writeInteger(buffer_ptr + 16, event.args[2], 4);
+};
+
+void _trace::printLine(uint8_t* buffer_ptr, uint32_t size) {
+  static const char digits[] = "0123456789abcdef";
+
+  // "RAMEN_TRACE " and two digits per byte
+  char line[12 + 2 * TRACE_EVENT_SIZE + 2] = "RAMEN_TRACE ";
+  for(uint32_t i = 0; i < size; ++i) {
+    line[12 + 2 * i] = digits[buffer_ptr[i] >> 4];
+    line[12 + 2 * i + 1] = digits[buffer_ptr[i] & 0x0F];
+  }
+  line[12 + 2 * size] = '\n';
+  line[12 + 2 * size + 1] = '\0';
+
+  Serial.print(line);
+};
@@ -0,0 +1,182 @@
+/**
+ * @file trace.hpp
+ * @brief trace.hpp
+ *
+ */
+#ifndef _RAMEN_TRACE_HPP_
+#define _RAMEN_TRACE_HPP_
+
+#include "ramen/configuration.hpp"
+
+namespace broth {
+namespace logger {
+
+  /**
+   * @brief Events of a node that are kept in its trace. The host decoder in
+   * simulation/scripts/decode_trace.py names them the same way, keep both in
+   * sync.
+   *
+   */
+  typedef enum {
+    // The node joined the mesh network
+    TRACE_STARTED = 1,
+    // {new_state, term, previous_state}
+    TRACE_STATE_CHANGED = 2,
+    // {term, last_log_term, log_size}
+    TRACE_ELECTION_STARTED = 3,
+    // {sender, term, granted}
+    TRACE_VOTE_REQUEST = 4,
+    // {sender, term, granted}
+    TRACE_VOTE_RESPONSE = 5,
+    // {sender, success, match_index}
+    TRACE_APPEND_ENTRIES_REQUEST = 6,
+    // {sender, success, match_index}
+    TRACE_APPEND_ENTRIES_RESPONSE = 7,
+    // {commit_index, previous_commit_index}
+    TRACE_COMMIT_ADVANCED = 8,
+    // {sender}
+    TRACE_MALFORMED_MESSAGE = 9,
+  } TraceEventType;
+
+  /**
+   * @brief An event in the trace
+   *
+   */
+  struct TraceEvent {
+    // Time of the node in microseconds
+    uint32_t time = 0;
+    uint32_t args[3] = {0};
+    uint16_t type = 0;
+    // Lower bits of the number of events recorded before this one
+    uint16_t sequence = 0;
+  };
+
+  /**
+   * @brief Fixed-size ring of the newest TRACE_SIZE events of a node. Unlike
+   * the logger it formats and prints nothing while recording, so it can stay
+   * on in production and be dumped after something went wrong.
+   *
+   * The serialized trace is a 16 byte header {"RTRC", version, event_size,
+   * count (2 bytes), node_id (4 bytes), recorded (4 bytes)} followed by the
+   * events from the oldest to the newest, 20 bytes each {time (4 bytes), type
+   * (2 bytes), sequence (2 bytes), args (3 x 4 bytes)}, all little endian.
+   *
+   */
+  class Trace {
+   private:
+    TraceEvent _events[TRACE_SIZE];
+    // Number of events recorded so far, the next one goes to
+    // _recorded % TRACE_SIZE
+    uint32_t _recorded = 0;
+
+   public:
+    /**
+     * @brief Construct a new Trace object
+     *
+     */
+    Trace();
+
+    /**
+     * @brief Record an event, overwriting the oldest one if the trace is full
+     *
+     * @param time Current time in microseconds
+     * @param type
+     * @param arg0
+     * @param arg1
+     * @param arg2
+     */
+    void record(uint32_t time,
+                TraceEventType type,
+                uint32_t arg0 = 0,
+                uint32_t arg1 = 0,
+                uint32_t arg2 = 0);
+
+    /**
+     * @brief Get the number of events held by the trace
+     *
+     * @return uint32_t At most TRACE_SIZE
+     */
+    uint32_t getSize();
+
+    /**
+     * @brief Get the number of events recorded so far, including the
+     * overwritten ones
+     *
+     * @return uint32_t
+     */
+    uint32_t getRecorded();
+
+    /**
+     * @brief Get an event held by the trace
+     *
+     * @param index 0 is the oldest event
+     * @return TraceEvent&
+     */
+    TraceEvent& getEvent(uint32_t index);
+
+    /**
+     * @brief Drop all events
+     *
+     */
+    void clear();
+
+    /**
+     * @brief Get the length of the serialized trace
+     *
+     * @return uint32_t
+     */
+    uint32_t getSerializedSize();
+
+    /**
+     * @brief Serialize the trace into a buffer, for example to keep it in
+     * the RTC memory or the flash after a crash
+     *
+     * @param node_id
+     * @param buffer_ptr
+     * @param size Size of the buffer, the newest events that do not fit are
+     * left out
+     * @return uint32_t Number of bytes written, 0 if not even the header fits
+     */
+    uint32_t serialize(uint32_t node_id, uint8_t* buffer_ptr, uint32_t size);
+
+    /**
+     * @brief Print the serialized trace over the serial port in hex, one
+     * line of "RAMEN_TRACE <hex>" for the header and for each event. It
+     * allocates nothing, so it can also be called from the
+     * custom_crash_callback() of the ESP8266 core.
+     *
+     * @param node_id
+     */
+    void dump(uint32_t node_id);
+
+   private:
+    /**
+     * @brief Write the header of the serialized trace
+     *
+     * @param node_id
+     * @param count Number of events that follow
+     * @param buffer_ptr 16 bytes
+     */
+    void serializeHeader(uint32_t node_id, uint16_t count, uint8_t* buffer_ptr);
+
+    /**
+     * @brief Write an event of the serialized trace
+     *
+     * @param event
+     * @param buffer_ptr 20 bytes
+     */
+    static void serializeEvent(TraceEvent& event, uint8_t* buffer_ptr);
+
+    /**
+     * @brief Print a line of the dump
+     *
+     * @param buffer_ptr
+     * @param size At most 20 bytes
+     */
+    static void printLine(uint8_t* buffer_ptr, uint32_t size);
+  };
+
+} // namespace logger
+} // namespace broth
+
+#endif
@@ -0,0 +1,214 @@
+/**
+ * @file transport.hpp
+ * @brief transport.hpp
+ *
+ */
+#ifndef _RAMEN_TRANSPORT_HPP_
+#define _RAMEN_TRANSPORT_HPP_
+
+#include <list>
+
+#include "ramen/configuration.hpp"
+
+namespace broth {
+namespace transport {
+
+  /**
+   * @brief Structure for defining the callback argument type
+   *
+   */
+  typedef std::function<void(uint32_t from, string_t& data)>
+      received_callback_t;
+
+  /**
+   * @brief Structure for defining the changed connections callback type
+   *
+   */
+  typedef std::function<void()> changed_connections_callback_t;
+
+  /**
+   * @brief Interface for the link layers that MeshNetwork can run on, such as
+   * painlessMesh. Each transport implements these methods once, instead of
+   * MeshNetwork checking for the selected transport on every call.
+   *
+   */
+  class Transport {
+   public:
+    /**
+     * @brief Destroy the Transport object
+     *
+     */
+    virtual ~Transport() {};
+
+    /**
+     * @brief Initializes the transport
+     * Return true if the operation was successful, false otherwise
+     *
+     * @param mesh_name Name of the mesh network
+     * @param mesh_password Password for the mesh network
+     * @param scheduler_ptr Scheduler that has to be executed on every update()
+     * @param mesh_port Port for the mesh network
+     * @return true
+     * @return false
+     */
+    virtual bool init(string_t mesh_name,
+                      string_t mesh_password,
+                      Scheduler* scheduler_ptr,
+                      uint16_t mesh_port) = 0;
+
+    /**
+     * @brief Receive the new messages and execute the scheduler given to
+     * init()
+     *
+     */
+    virtual void update() = 0;
+
+    /**
+     * @brief Get the ID of the current node
+     *
+     * @return uint32_t
+     */
+    virtual uint32_t getNodeId() = 0;
+
+    /**
+     * @brief Get the current node time in microseconds
+     *
+     * @return uint32_t
+     */
+    virtual uint32_t getNodeTime() = 0;
+
+    /**
+     * @brief Get the current list of nodes in the network
+     *
+     * @param include_self Whether to include the current node to the list or
+     * not
+     * @return std::list<uint32_t>
+     */
+    virtual std::list<uint32_t> getNodeList(bool include_self = false) = 0;
+
+    /**
+     * @brief Send data to all nodes in the network
+     *
+     * @param data Data to send
+     * @return true
+     * @return false
+     */
+    virtual bool sendBroadcast(string_t data) = 0;
+
+    /**
+     * @brief Send data to a specific node with the given node ID
+     *
+     * @param destination_node_id The node to deliver the data to
+     * @param data Data to send
+     * @return true
+     * @return false
+     */
+    virtual bool sendSingle(uint32_t destination_node_id, string_t data) = 0;
+
+    /**
+     * @brief Set the callback function which will be called when data is
+     * received from another node
+     *
+     * @param on_receive
+     */
+    virtual void onReceive(received_callback_t on_receive) = 0;
+
+    /**
+     * @brief Set the callback function which will be called when the
+     * connections in the network change. Transports that don't keep track of
+     * the connections never call it.
+     *
+     * @param on_changed_connections
+     */
+    virtual void onChangedConnections(
+        changed_connections_callback_t on_changed_connections) {};
+
+    /**
+     * @brief Get the node tree rooted at the current node, in the format of
+     * painlessMesh's subConnectionJson(). Transports that don't know the
+     * topology report every node as directly connected.
+     *
+     * @return string_t
+     */
+    virtual string_t subConnectionJson() {
+      auto nodeList = this->getNodeList(false);
+      char node_id[11];
+
+      snprintf(node_id, sizeof(node_id), "%u", this->getNodeId());
+      string_t tree = "{\"nodeId\":";
+      tree += node_id;
+      tree += ",\"subs\":[";
+      for(auto it = nodeList.begin(); it != nodeList.end(); ++it) {
+        if(it != nodeList.begin()) {
+          tree += ",";
+        }
+        snprintf(node_id, sizeof(node_id), "%u", *it);
+        tree += "{\"nodeId\":";
+        tree += node_id;
+        tree += ",\"subs\":[]}";
+      }
+      tree += "]}";
+
+      return tree;
+    };
+
+    /////////////////////////////////////////////////
+    // Methods used only during testing
+    /////////////////////////////////////////////////
+
+#ifdef _RAMEN_UNIT_TESTING_
+
+    /**
+     * @brief Force set the node time to given value
+     * [NOTE: Used for testing purposes only]
+     *
+     * @param time
+     */
+    virtual void setMeshTime(uint32_t time) = 0;
+
+    /**
+     * @brief Force increment the node time by given value
+     * [NOTE: Used for testing purposes only]
+     *
+     * @param time
+     */
+    virtual void incrementMeshTimeBy(uint32_t time) = 0;
+
+    /**
+     * @brief Force set the current node's ID
+     * [NOTE: Used for testing purposes only]
+     *
+     * @param node_id
+     */
+    virtual void setNodeId(uint32_t node_id) = 0;
+
+    /**
+     * @brief Force add a neighbour node to the current node, the neighbour
+     * has to use the same type of transport
+     * [NOTE: Used for testing purposes only]
+     *
+     * @param neighbour_node
+     */
+    virtual void addNeighbourNode(Transport& neighbour_node) = 0;
+
+    /**
+     * @brief Go through the message buffer and see if there is any new message
+     * [NOTE: Used for testing purposes only]
+     */
+    virtual void checkForNewMessages() = 0;
+
+    /**
+     * @brief Get the buffer of the messages that are not received yet
+     * [NOTE: Used for testing purposes only]
+     *
+     * @return std::list<std::pair<uint32_t, string_t>>&
+     */
+    virtual std::list<std::pair<uint32_t, string_t>>& getMessageBuffer() = 0;
+
+#endif
+  };
+
+} // namespace transport
+} // namespace broth
+
+#endif
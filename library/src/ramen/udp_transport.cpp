@@ -0,0 +1,216 @@
+/**
+ * @file udp_transport.cpp
+ * @brief udp_transport.cpp
+ *
+ */
+#include "ramen/udp_transport.hpp"
+
+#ifdef _RAMEN_UNIT_TESTING_
+
+  #include <arpa/inet.h>
+  #include <fcntl.h>
+  #include <netinet/in.h>
+  #include <sys/socket.h>
+  #include <unistd.h>
+
+  #include <cstring>
+
+using _udp_transport = broth::transport::UdpTransport;
+using namespace broth::transport;
+
+// Largest payload of a UDP datagram over IPv4
+static const size_t UDP_MAX_DATAGRAM_SIZE = 65507;
+static const size_t UDP_HEADER_SIZE = sizeof(uint32_t);
+
+_udp_transport::UdpTransport(uint32_t node_id, std::list<uint32_t> node_list) :
+    _node_id(node_id), _node_list(node_list),
+    _receive_buffer(UDP_MAX_DATAGRAM_SIZE) {};
+
+_udp_transport::~UdpTransport() {
+  if(this->_socket >= 0) {
+    close(this->_socket);
+  }
+};
+
+bool _udp_transport::init(string_t mesh_name,
+                          string_t mesh_password,
+                          Scheduler* scheduler_ptr,
+                          uint16_t mesh_port) {
+  this->_scheduler_ptr = scheduler_ptr;
+  this->_base_port = mesh_port;
+
+  uint16_t port;
+  if(!this->getPort(this->_node_id, port)) {
+    return false;
+  }
+
+  this->_socket = socket(AF_INET, SOCK_DGRAM, 0);
+  if(this->_socket < 0) {
+    return false;
+  }
+
+  // Never block the loop, update() reads whatever has arrived
+  fcntl(this->_socket, F_SETFL, fcntl(this->_socket, F_GETFL) | O_NONBLOCK);
+
+  sockaddr_in address = {};
+  address.sin_family = AF_INET;
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  address.sin_port = htons(port);
+
+  if(bind(this->_socket, (sockaddr*) &address, sizeof(address)) < 0) {
+    close(this->_socket);
+    this->_socket = -1;
+    return false;
+  }
+
+  return true;
+};
+
+void _udp_transport::update() {
+  this->checkForNewMessages();
+
+  if(this->_scheduler_ptr) {
+    this->_scheduler_ptr->execute();
+  }
+};
+
+uint32_t _udp_transport::getNodeId() {
+  return this->_node_id;
+};
+
+uint32_t _udp_transport::getNodeTime() {
+  return micros() + this->_time_offset;
+};
+
+std::list<uint32_t> _udp_transport::getNodeList(bool include_self) {
+  std::list<uint32_t> node_list = this->_node_list;
+
+  if(include_self) {
+    node_list.push_back(this->_node_id);
+  }
+
+  return node_list;
+};
+
+bool _udp_transport::sendBroadcast(string_t data) {
+  bool success = true;
+
+  for(auto it = this->_node_list.begin(); it != this->_node_list.end(); ++it) {
+    success = this->sendSingle(*it, data) && success;
+  }
+
+  return success;
+};
+
+bool _udp_transport::sendSingle(uint32_t destination_node_id, string_t data) {
+  uint16_t port;
+  if(this->_socket < 0 ||
+     data.length() > UDP_MAX_DATAGRAM_SIZE - UDP_HEADER_SIZE ||
+     !this->getPort(destination_node_id, port)) {
+    return false;
+  }
+
+  std::vector<char> datagram(UDP_HEADER_SIZE + data.length());
+  uint32_t sender = htonl(this->_node_id);
+  std::memcpy(datagram.data(), &sender, UDP_HEADER_SIZE);
+  std::memcpy(datagram.data() + UDP_HEADER_SIZE, data.c_str(), data.length());
+
+  sockaddr_in address = {};
+  address.sin_family = AF_INET;
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  address.sin_port = htons(port);
+
+  return sendto(this->_socket,
+                datagram.data(),
+                datagram.size(),
+                0,
+                (sockaddr*) &address,
+                sizeof(address)) == (ssize_t) datagram.size();
+};
+
+void _udp_transport::onReceive(received_callback_t on_receive) {
+  this->_received_callback = on_receive;
+};
+
+bool _udp_transport::getPort(uint32_t node_id, uint16_t& port) {
+  // Larger node IDs would wrap around onto the ports of other nodes
+  if(node_id > UINT16_MAX - this->_base_port) {
+    return false;
+  }
+
+  port = this->_base_port + node_id;
+  return true;
+};
+
+void _udp_transport::receiveDatagrams() {
+  if(this->_socket < 0) {
+    return;
+  }
+
+  while(true) {
+    ssize_t size = recv(this->_socket,
+                        this->_receive_buffer.data(),
+                        this->_receive_buffer.size(),
+                        0);
+
+    // Nothing left to read
+    if(size < 0) {
+      break;
+    }
+
+    // Drop datagrams that don't even have a header
+    if((size_t) size < UDP_HEADER_SIZE) {
+      continue;
+    }
+
+    uint32_t sender;
+    std::memcpy(&sender, this->_receive_buffer.data(), UDP_HEADER_SIZE);
+
+    this->_message_buffer.push_back(std::make_pair(
+        ntohl(sender),
+        string_t(this->_receive_buffer.data() + UDP_HEADER_SIZE,
+                 size - UDP_HEADER_SIZE)));
+  }
+};
+
+  /////////////////////////////////////////////////
+  // Methods used only during testing
+  /////////////////////////////////////////////////
+
+void _udp_transport::setMeshTime(uint32_t time) {
+  this->_time_offset = time - micros();
+};
+
+void _udp_transport::incrementMeshTimeBy(uint32_t time) {
+  this->_time_offset += time;
+};
+
+void _udp_transport::setNodeId(uint32_t node_id) {
+  this->_node_id = node_id;
+};
+
+void _udp_transport::addNeighbourNode(Transport& neighbour_node) {
+  this->_node_list.push_back(neighbour_node.getNodeId());
+};
+
+void _udp_transport::checkForNewMessages() {
+  this->receiveDatagrams();
+
+  // Process all new messages
+  while(this->_message_buffer.size() > 0) {
+    auto message = this->_message_buffer.front();
+    this->_message_buffer.pop_front();
+
+    if(this->_received_callback) {
+      this->_received_callback(message.first, message.second);
+    }
+  }
+};
+
+std::list<std::pair<uint32_t, string_t>>& _udp_transport::getMessageBuffer() {
+  this->receiveDatagrams();
+
+  return this->_message_buffer;
+};
+
+#endif
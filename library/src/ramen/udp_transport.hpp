@@ -0,0 +1,112 @@
+/**
+ * @file udp_transport.hpp
+ * @brief udp_transport.hpp
+ *
+ */
+#ifndef _RAMEN_UDP_TRANSPORT_HPP_
+#define _RAMEN_UDP_TRANSPORT_HPP_
+
+#include "ramen/configuration.hpp"
+#include "ramen/transport.hpp"
+
+// Sockets are only available on the host, where the library is built for
+// testing
+#ifdef _RAMEN_UNIT_TESTING_
+
+  #include <vector>
+
+namespace broth {
+namespace transport {
+
+  /**
+   * @brief Transport that runs on UDP over the loopback interface, so every
+   * node can run as its own process. Node n listens on port base + n, where
+   * base is the mesh port. Every datagram starts with the 4 byte ID of the
+   * sender in network byte order, followed by the data.
+   *
+   */
+  class UdpTransport : public Transport {
+   private:
+    uint32_t _node_id;
+    std::list<uint32_t> _node_list;
+    uint16_t _base_port = 0;
+    int _socket = -1;
+    uint32_t _time_offset = 0;
+    Scheduler* _scheduler_ptr = NULL;
+    received_callback_t _received_callback;
+    std::list<std::pair<uint32_t, string_t>> _message_buffer;
+    std::vector<char> _receive_buffer;
+
+    /**
+     * @brief Read all datagrams waiting on the socket into the message buffer
+     *
+     */
+    void receiveDatagrams();
+
+    /**
+     * @brief Get the port of a node, base port + node ID
+     *
+     * @param node_id
+     * @param port
+     * @return true
+     * @return false If the port would be beyond the last port
+     */
+    bool getPort(uint32_t node_id, uint16_t& port);
+
+   public:
+    /**
+     * @brief Construct a new Udp Transport object
+     *
+     * @param node_id ID of the current node, the port is derived from it
+     * @param node_list IDs of the other nodes in the network
+     */
+    UdpTransport(uint32_t node_id, std::list<uint32_t> node_list);
+
+    /**
+     * @brief Destroy the Udp Transport object
+     *
+     */
+    ~UdpTransport();
+
+    bool init(string_t mesh_name,
+              string_t mesh_password,
+              Scheduler* scheduler_ptr,
+              uint16_t mesh_port) override;
+
+    void update() override;
+
+    uint32_t getNodeId() override;
+
+    uint32_t getNodeTime() override;
+
+    std::list<uint32_t> getNodeList(bool include_self = false) override;
+
+    bool sendBroadcast(string_t data) override;
+
+    bool sendSingle(uint32_t destination_node_id, string_t data) override;
+
+    void onReceive(received_callback_t on_receive) override;
+
+    /////////////////////////////////////////////////
+    // Methods used only during testing
+    /////////////////////////////////////////////////
+
+    void setMeshTime(uint32_t time) override;
+
+    void incrementMeshTimeBy(uint32_t time) override;
+
+    void setNodeId(uint32_t node_id) override;
+
+    void addNeighbourNode(Transport& neighbour_node) override;
+
+    void checkForNewMessages() override;
+
+    std::list<std::pair<uint32_t, string_t>>& getMessageBuffer() override;
+  };
+
+} // namespace transport
+} // namespace broth
+
+#endif
+
+#endif
@@ -5,7 +5,14 @@
  */
 #include "ramen/utils.hpp"
 
+#include <algorithm>
+#include <cstring>
+
 using _timer = broth::utils::Timer;
+using _rtt_estimator = broth::utils::RoundTripTimeEstimator;
+using _token_bucket = broth::utils::TokenBucket;
+using _replication_window = broth::utils::ReplicationWindow;
+using _random = broth::utils::Random;
 using namespace broth::logger;
 
 _timer::Timer() {};
@@ -22,4 +29,146 @@ bool _timer::check(uint32_t current_time) {
   } else {
     return false;
   }
-};
\ No newline at end of file
+};
+
+_rtt_estimator::RoundTripTimeEstimator() {};
+
+void _rtt_estimator::addSample(uint32_t rtt) {
+  if(!this->_has_samples) {
+    this->_smoothed_rtt = rtt;
+    this->_rtt_variation = rtt / 2;
+    this->_has_samples = true;
+  } else {
+    uint32_t difference = (this->_smoothed_rtt > rtt)
+                              ? this->_smoothed_rtt - rtt
+                              : rtt - this->_smoothed_rtt;
+
+    // rtt_variation = 3/4 * rtt_variation + 1/4 * difference
+    this->_rtt_variation =
+        this->_rtt_variation - (this->_rtt_variation / 4) + (difference / 4);
+
+    // smoothed_rtt = 7/8 * smoothed_rtt + 1/8 * rtt
+    this->_smoothed_rtt =
+        this->_smoothed_rtt - (this->_smoothed_rtt / 8) + (rtt / 8);
+  }
+};
+
+bool _rtt_estimator::hasSamples() {
+  return this->_has_samples;
+};
+
+uint32_t _rtt_estimator::getSmoothedRtt() {
+  return this->_smoothed_rtt;
+};
+
+uint32_t _rtt_estimator::getRttVariation() {
+  return this->_rtt_variation;
+};
+
+uint32_t _rtt_estimator::getTimeout() {
+  return this->_smoothed_rtt + (4 * this->_rtt_variation);
+};
+
+_token_bucket::TokenBucket() {};
+
+void _token_bucket::init(uint32_t rate, uint32_t capacity) {
+  this->_rate = rate;
+  this->_capacity = capacity;
+  this->_tokens = capacity;
+  this->_started = false;
+};
+
+void _token_bucket::refill(uint32_t current_time) {
+  if(this->_started) {
+    uint32_t elapsed = current_time - this->_previous_time;
+    this->_tokens += (float) elapsed * this->_rate / 1000000;
+    this->_tokens = std::min(this->_tokens, (float) this->_capacity);
+  }
+
+  this->_previous_time = current_time;
+  this->_started = true;
+};
+
+bool _token_bucket::consume(uint32_t amount, uint32_t current_time) {
+  this->refill(current_time);
+
+  // A full bucket lets anything through, otherwise amounts larger than the
+  // capacity could never be taken
+  if(this->_tokens >= amount || this->_tokens >= this->_capacity) {
+    this->_tokens -= amount;
+    return true;
+  }
+
+  return false;
+};
+
+float _token_bucket::getTokens(uint32_t current_time) {
+  this->refill(current_time);
+
+  return this->_tokens;
+};
+
+_replication_window::ReplicationWindow() {};
+
+void _replication_window::increase() {
+  this->_size = std::min(this->_size + REPLICATION_WINDOW_INCREASE,
+                         (uint32_t) MAX_REPLICATION_WINDOW);
+};
+
+void _replication_window::decrease() {
+  this->_size = std::max(this->_size / 2, (uint32_t) MIN_REPLICATION_WINDOW);
+};
+
+uint32_t _replication_window::getSize() {
+  return this->_size;
+};
+
+_random::Random() {};
+
+void _random::seed(uint32_t seed) {
+  // Spread nearby seeds, like the IDs of neighbouring nodes, over the whole
+  // state, which must not be zero
+  this->_state = (seed ^ 0x9E3779B9) * 2654435761u;
+  if(this->_state == 0) {
+    this->_state = 1;
+  }
+};
+
+uint32_t _random::next() {
+  this->_state ^= this->_state << 13;
+  this->_state ^= this->_state >> 17;
+  this->_state ^= this->_state << 5;
+  return this->_state;
+};
+
+float broth::utils::getAverageNodeTreeDepth(const string_t& node_tree) {
+  const char* key = "\"nodeId\"";
+  const size_t key_length = std::strlen(key);
+
+  // Every level of the tree is nested in one more "subs" array, so the depth
+  // of a node is the number of arrays that are open at its "nodeId" key
+  uint32_t depth = 0;
+  uint32_t total_depth = 0;
+  uint32_t node_count = 0;
+
+  for(const char* it = node_tree.c_str(); *it != '\0'; ++it) {
+    if(*it == '[') {
+      ++depth;
+    } else if(*it == ']' && depth > 0) {
+      --depth;
+    } else if(std::strncmp(it, key, key_length) == 0) {
+      // The root node has depth 0, so it doesn't count
+      if(depth > 0) {
+        total_depth += depth;
+        ++node_count;
+      }
+      it += key_length - 1;
+    }
+  }
+
+  if(node_count == 0) {
+    return 0;
+  }
+
+  return (float) total_depth / node_count;
+};
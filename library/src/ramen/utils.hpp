@@ -47,6 +47,200 @@ namespace utils {
      */
     bool check(uint32_t current_time);
   };
+
+  /**
+   * @brief Keeps a smoothed round trip time and its variation for a peer, as
+   * described in RFC 6298. All values are in microseconds.
+   *
+   */
+  class RoundTripTimeEstimator {
+   private:
+    uint32_t _smoothed_rtt = 0;
+    uint32_t _rtt_variation = 0;
+    bool _has_samples = false;
+
+   public:
+    /**
+     * @brief Construct a new Round Trip Time Estimator object
+     *
+     */
+    RoundTripTimeEstimator();
+
+    /**
+     * @brief Update the estimates with a newly measured round trip time
+     *
+     * @param rtt Measured round trip time
+     */
+    void addSample(uint32_t rtt);
+
+    /**
+     * @brief Checks if any round trip time was measured yet
+     *
+     * @return true
+     * @return false
+     */
+    bool hasSamples();
+
+    /**
+     * @brief Get the smoothed round trip time
+     *
+     * @return uint32_t
+     */
+    uint32_t getSmoothedRtt();
+
+    /**
+     * @brief Get the round trip time variation
+     *
+     * @return uint32_t
+     */
+    uint32_t getRttVariation();
+
+    /**
+     * @brief Get the time after which a response can be considered late,
+     * which is the smoothed round trip time plus four times its variation
+     *
+     * @return uint32_t
+     */
+    uint32_t getTimeout();
+  };
+
+  /**
+   * @brief Token bucket for limiting a rate, such as bytes per second. The
+   * bucket starts full, and while it is full an amount larger than the
+   * capacity can be taken at once, which is paid back before anything else
+   * can be taken.
+   *
+   */
+  class TokenBucket {
+   private:
+    float _tokens = 0;
+    uint32_t _rate = 0;
+    uint32_t _capacity = 0;
+    uint32_t _previous_time = 0;
+    bool _started = false;
+
+    /**
+     * @brief Add the tokens for the time elapsed since the last call
+     *
+     * @param current_time Current time in microseconds
+     */
+    void refill(uint32_t current_time);
+
+   public:
+    /**
+     * @brief Construct a new Token Bucket object
+     *
+     */
+    TokenBucket();
+
+    /**
+     * @brief Initialize the bucket with the given rate and capacity, and fill
+     * it up
+     *
+     * @param rate Tokens added per second
+     * @param capacity Largest number of tokens the bucket can hold
+     */
+    void init(uint32_t rate, uint32_t capacity);
+
+    /**
+     * @brief Take the given amount of tokens if there are enough of them
+     *
+     * @param amount
+     * @param current_time Current time in microseconds
+     * @return true If the tokens were taken
+     * @return false If the caller has to wait
+     */
+    bool consume(uint32_t amount, uint32_t current_time);
+
+    /**
+     * @brief Get the number of tokens available at the given time
+     *
+     * @param current_time Current time in microseconds
+     * @return float
+     */
+    float getTokens(uint32_t current_time);
+  };
+
+  /**
+   * @brief Number of bytes of entries the leader may send to a follower in a
+   * single append entry request. It grows additively while the follower keeps
+   * up, and shrinks multiplicatively when requests fail or get lost.
+   *
+   */
+  class ReplicationWindow {
+   private:
+    uint32_t _size = INITIAL_REPLICATION_WINDOW;
+
+   public:
+    /**
+     * @brief Construct a new Replication Window object
+     *
+     */
+    ReplicationWindow();
+
+    /**
+     * @brief Grow the window after an acknowledged request
+     *
+     */
+    void increase();
+
+    /**
+     * @brief Halve the window after a failed or lost request
+     *
+     */
+    void decrease();
+
+    /**
+     * @brief Get the size of the window in bytes
+     *
+     * @return uint32_t
+     */
+    uint32_t getSize();
+  };
+
+  /**
+   * @brief Small pseudo random number generator (xorshift32). Every server
+   * draws from its own generator instead of sharing the state of std::rand(),
+   * so the numbers of a node only depend on its own seed.
+   *
+   */
+  class Random {
+   private:
+    uint32_t _state = 1;
+
+   public:
+    /**
+     * @brief Construct a new Random object
+     *
+     */
+    Random();
+
+    /**
+     * @brief Seed the generator, the same seed always gives the same numbers
+     *
+     * @param seed
+     */
+    void seed(uint32_t seed);
+
+    /**
+     * @brief Get the next number of the sequence
+     *
+     * @return uint32_t
+     */
+    uint32_t next();
+  };
+
+  /**
+   * @brief Get the average depth of the nodes in a node tree, as given by
+   * painlessMesh's subConnectionJson(), which is the average hop count from
+   * the root node to the other nodes. The tree is scanned without building a
+   * JSON document, so deep trees don't need a large buffer.
+   *
+   * @param node_tree Node tree in {"nodeId":1,"subs":[{"nodeId":2,...}]}
+   * format
+   * @return float 0 if there are no nodes other than the root
+   */
+  float getAverageNodeTreeDepth(const string_t& node_tree);
 } // namespace utils
 } // namespace broth
 
@@ -19,7 +19,28 @@
   #define INFINITY ((unsigned) ~0)
 #endif
 
+/**
+ * Virtual clock for the simulator. When it is enabled, millis() and micros()
+ * report the virtual time in microseconds instead of the wall clock time, so
+ * the scheduled tasks follow the simulated mesh time. Every thread has a
+ * clock of its own, so that nodes simulated in parallel can be at different
+ * times.
+ */
+inline bool& virtualClockEnabled() {
+  static bool enabled = false;
+  return enabled;
+}
+
+inline unsigned long long& virtualClockMicros() {
+  static thread_local unsigned long long time = 0;
+  return time;
+}
+
 inline unsigned long millis() {
+  if(virtualClockEnabled()) {
+    return virtualClockMicros() / 1000;
+  }
+
   struct timeval te;
   gettimeofday(&te, NULL); // get current time
   long long milliseconds =
@@ -29,6 +50,10 @@ inline unsigned long millis() {
 }
 
 inline unsigned long micros() {
+  if(virtualClockEnabled()) {
+    return virtualClockMicros();
+  }
+
   struct timeval te;
   gettimeofday(&te, NULL); // get current time
   long long milliseconds = te.tv_sec * 1000000LL + te.tv_usec;
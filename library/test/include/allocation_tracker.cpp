@@ -0,0 +1,276 @@
+#include "allocation_tracker.hpp"
+
+#include <cstdlib>
+#include <new>
+
+using namespace allocation_tracker;
+
+namespace {
+
+/**
+ * Kept in front of every allocation, as long as the alignment of malloc so
+ * the memory after it stays aligned
+ */
+struct alignas(std::max_align_t) Header {
+  uint64_t size;
+  uint32_t generation;
+  uint16_t slot;
+  uint8_t subsystem;
+};
+
+void* allocateOrThrow(size_t size) {
+  void* pointer = allocation_tracker::allocate(size, size);
+  if(pointer == NULL) {
+    throw std::bad_alloc();
+  }
+
+  return pointer;
+}
+
+} // namespace
+
+void* allocation_tracker::allocate(size_t size, size_t charged_size) noexcept {
+  Header* header_ptr = (Header*) std::malloc(sizeof(Header) + size);
+  if(header_ptr == NULL) {
+    return NULL;
+  }
+
+  AllocationTracker::get().allocated(header_ptr, charged_size);
+  return header_ptr + 1;
+}
+
+void allocation_tracker::release(void* pointer) noexcept {
+  if(pointer == NULL) {
+    return;
+  }
+
+  Header* header_ptr = ((Header*) pointer) - 1;
+  AllocationTracker::get().freed(header_ptr);
+  std::free(header_ptr);
+}
+
+void* operator new(size_t size) {
+  return allocateOrThrow(size);
+}
+
+void* operator new[](size_t size) {
+  return allocateOrThrow(size);
+}
+
+// The nothrow forms have to be replaced as well, the default ones would take
+// memory without a header, which the replaced delete then reads
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+  return allocation_tracker::allocate(size, size);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+  return allocation_tracker::allocate(size, size);
+}
+
+void operator delete(void* pointer) noexcept {
+  allocation_tracker::release(pointer);
+}
+
+void operator delete[](void* pointer) noexcept {
+  allocation_tracker::release(pointer);
+}
+
+void operator delete(void* pointer, size_t size) noexcept {
+  allocation_tracker::release(pointer);
+}
+
+void operator delete[](void* pointer, size_t size) noexcept {
+  allocation_tracker::release(pointer);
+}
+
+void operator delete(void* pointer, const std::nothrow_t&) noexcept {
+  allocation_tracker::release(pointer);
+}
+
+void operator delete[](void* pointer, const std::nothrow_t&) noexcept {
+  allocation_tracker::release(pointer);
+}
+
+AllocationTracker::AllocationTracker() {
+  this->_total_allocations = 0;
+  this->_total_bytes = 0;
+  this->_generation = 0;
+  this->reset();
+}
+
+AllocationTracker& AllocationTracker::get() {
+  // Constructed by the first allocation, and never destroyed, since memory is
+  // still freed after the end of main()
+  static AllocationTracker* tracker_ptr =
+      new(std::malloc(sizeof(AllocationTracker))) AllocationTracker();
+  return *tracker_ptr;
+}
+
+void AllocationTracker::raise(Counters& counters, int64_t size) {
+  int64_t live =
+      counters.live.fetch_add(size, std::memory_order_relaxed) + size;
+  int64_t peak = counters.peak.load(std::memory_order_relaxed);
+  while(live > peak && !counters.peak.compare_exchange_weak(
+                           peak, live, std::memory_order_relaxed)) {
+  }
+  counters.allocations.fetch_add(1, std::memory_order_relaxed);
+}
+
+void AllocationTracker::allocated(void* header_ptr, size_t size) {
+  Header* header = (Header*) header_ptr;
+  header->size = size;
+  header->generation = this->_generation.load(std::memory_order_relaxed);
+  header->slot = currentSlot();
+  header->subsystem = currentSubsystem();
+
+  this->_total_allocations.fetch_add(1, std::memory_order_relaxed);
+  this->_total_bytes.fetch_add(size, std::memory_order_relaxed);
+
+  raise(this->_nodes[header->slot], size);
+  raise(this->_subsystems[header->slot][header->subsystem], size);
+
+  int64_t heap_cap = this->_heap_cap.load(std::memory_order_relaxed);
+  if(heap_cap > 0 && header->slot > 0 &&
+     this->_nodes[header->slot].live.load(std::memory_order_relaxed) >
+         heap_cap &&
+     !this->_slot_exceeded[header->slot].exchange(true)) {
+    HeapViolation& violation = this->_violations[header->slot];
+    violation.node_id = this->_node_ids[header->slot];
+    violation.live =
+        this->_nodes[header->slot].live.load(std::memory_order_relaxed);
+    violation.subsystem = (Subsystem) header->subsystem;
+    this->_exceeded = true;
+  }
+}
+
+void AllocationTracker::freed(void* header_ptr) {
+  Header* header = (Header*) header_ptr;
+  if(header->generation != this->_generation.load(std::memory_order_relaxed)) {
+    return;
+  }
+
+  int64_t size = header->size;
+  this->_nodes[header->slot].live.fetch_sub(size, std::memory_order_relaxed);
+  this->_subsystems[header->slot][header->subsystem].live.fetch_sub(
+      size, std::memory_order_relaxed);
+}
+
+void AllocationTracker::reset() {
+  this->_generation.fetch_add(1);
+  this->_slots = 1;
+  this->_node_ids[0] = 0;
+  this->_heap_cap = 0;
+  this->_exceeded = false;
+
+  for(uint32_t slot = 0; slot < ALLOCATION_TRACKER_MAX_NODES; ++slot) {
+    this->_slot_exceeded[slot] = false;
+    this->_violations[slot] = HeapViolation();
+    this->_nodes[slot].live = 0;
+    this->_nodes[slot].peak = 0;
+    this->_nodes[slot].allocations = 0;
+    for(uint32_t i = 0; i < ALLOCATION_TRACKER_SUBSYSTEMS; ++i) {
+      this->_subsystems[slot][i].live = 0;
+      this->_subsystems[slot][i].peak = 0;
+      this->_subsystems[slot][i].allocations = 0;
+    }
+  }
+}
+
+bool AllocationTracker::registerNode(uint32_t node_id) {
+  if(this->findSlot(node_id) > 0) {
+    return true;
+  }
+
+  uint32_t slot = this->_slots;
+  if(slot >= ALLOCATION_TRACKER_MAX_NODES) {
+    return false;
+  }
+
+  this->_node_ids[slot] = node_id;
+  this->_slots = slot + 1;
+  return true;
+}
+
+uint32_t AllocationTracker::findSlot(uint32_t node_id) {
+  uint32_t slots = this->_slots;
+  for(uint32_t slot = 1; slot < slots; ++slot) {
+    if(this->_node_ids[slot] == node_id) {
+      return slot;
+    }
+  }
+
+  return 0;
+}
+
+void AllocationTracker::setHeapCap(int64_t bytes) {
+  this->_heap_cap = bytes;
+}
+
+bool AllocationTracker::isHeapCapExceeded() {
+  return this->_exceeded;
+}
+
+HeapViolation AllocationTracker::getViolation() {
+  uint32_t slots = this->_slots;
+  for(uint32_t slot = 1; slot < slots; ++slot) {
+    if(this->_slot_exceeded[slot]) {
+      return this->_violations[slot];
+    }
+  }
+
+  return HeapViolation();
+}
+
+HeapViolation AllocationTracker::getViolation(uint32_t node_id) {
+  uint32_t slot = this->findSlot(node_id);
+  if(slot == 0 || !this->_slot_exceeded[slot]) {
+    return HeapViolation();
+  }
+
+  return this->_violations[slot];
+}
+
+HeapUsage AllocationTracker::getUsage(uint32_t node_id) {
+  Counters& counters = this->_nodes[this->findSlot(node_id)];
+
+  HeapUsage usage;
+  usage.live = counters.live;
+  usage.peak = counters.peak;
+  usage.allocations = counters.allocations;
+  return usage;
+}
+
+HeapUsage AllocationTracker::getUsage(uint32_t node_id, Subsystem subsystem) {
+  Counters& counters = this->_subsystems[this->findSlot(node_id)][subsystem];
+
+  HeapUsage usage;
+  usage.live = counters.live;
+  usage.peak = counters.peak;
+  usage.allocations = counters.allocations;
+  return usage;
+}
+
+uint64_t AllocationTracker::getTotalAllocations() {
+  return this->_total_allocations;
+}
+
+uint64_t AllocationTracker::getTotalBytes() {
+  return this->_total_bytes;
+}
+
+const char* AllocationTracker::getSubsystemName(Subsystem subsystem) {
+  switch(subsystem) {
+    case SERVER:
+      return "server";
+    case MESSAGE:
+      return "message";
+    case LOG_HOLDER:
+      return "log_holder";
+    case DATA_QUEUE:
+      return "data_queue";
+    case MESH_NETWORK:
+      return "mesh_network";
+    default:
+      return "other";
+  }
+}
@@ -0,0 +1,215 @@
+/**
+ * Keeps account of the heap on the host, for the unit tests and the
+ * simulator. Every allocation of the process goes through the replaced
+ * operator new, which charges it to the node and the subsystem that are
+ * running on the thread at the time. The library marks its subsystems with
+ * RAMEN_ALLOCATION_SCOPE(), which is empty on the devices.
+ *
+ * Memory stays charged to whoever allocated it, also after it is handed on,
+ * for example the data of a received entry is charged to the server that
+ * decoded it rather than to the log that keeps it.
+ *
+ * With a heap cap, every node keeps the first time it has more memory than the
+ * cap as its violation, so that a simulation can stop and fail, as the node
+ * would run out of memory on a device. Each node only crosses the cap on its
+ * own thread, so its violation doesn't depend on the other threads.
+ *
+ * The memory pools of the JSON documents are charged with the capacity they
+ * have on the devices, see json_document_t in catch_configuration.hpp.
+ *
+ */
+
+#ifndef _RAMEN_ALLOCATION_TRACKER_HPP_
+#define _RAMEN_ALLOCATION_TRACKER_HPP_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// Nodes that can be told apart, the others are charged as unattributed
+#ifndef ALLOCATION_TRACKER_MAX_NODES
+  #define ALLOCATION_TRACKER_MAX_NODES 256
+#endif
+
+namespace allocation_tracker {
+
+typedef enum {
+  OTHER = 0,
+  SERVER = 1,
+  MESSAGE = 2,
+  LOG_HOLDER = 3,
+  DATA_QUEUE = 4,
+  MESH_NETWORK = 5,
+} Subsystem;
+
+#define ALLOCATION_TRACKER_SUBSYSTEMS 6
+
+/**
+ * Memory of a node or of one of its subsystems, in bytes
+ */
+struct HeapUsage {
+  int64_t live = 0;
+  int64_t peak = 0;
+  uint64_t allocations = 0;
+};
+
+/**
+ * Node that exceeded the heap cap, node ID 0 if none did
+ */
+struct HeapViolation {
+  uint32_t node_id = 0;
+  int64_t live = 0;
+  Subsystem subsystem = OTHER;
+};
+
+class AllocationTracker {
+  // private:
+ public:
+  struct Counters {
+    std::atomic<int64_t> live;
+    std::atomic<int64_t> peak;
+    std::atomic<uint64_t> allocations;
+  };
+
+  // Slot 0 is unattributed, a node has the slot it was registered with
+  uint32_t _node_ids[ALLOCATION_TRACKER_MAX_NODES];
+  std::atomic<uint32_t> _slots;
+  Counters _nodes[ALLOCATION_TRACKER_MAX_NODES];
+  Counters _subsystems[ALLOCATION_TRACKER_MAX_NODES]
+                      [ALLOCATION_TRACKER_SUBSYSTEMS];
+  // Allocations since the start of the process, never reset
+  std::atomic<uint64_t> _total_allocations;
+  std::atomic<uint64_t> _total_bytes;
+  // Memory allocated before the last reset() is not counted when freed
+  std::atomic<uint32_t> _generation;
+  std::atomic<int64_t> _heap_cap;
+  // Set once any node exceeded the heap cap
+  std::atomic<bool> _exceeded;
+  // Violation of every slot that exceeded the heap cap
+  std::atomic<bool> _slot_exceeded[ALLOCATION_TRACKER_MAX_NODES];
+  HeapViolation _violations[ALLOCATION_TRACKER_MAX_NODES];
+
+  AllocationTracker();
+
+  static void raise(Counters& counters, int64_t size);
+
+ public:
+  static AllocationTracker& get();
+
+  /**
+   * Called by operator new and delete
+   */
+  void allocated(void* header_ptr, size_t size);
+  void freed(void* header_ptr);
+
+  /**
+   * Forget the nodes, the counters and the violation, and remove the cap
+   */
+  void reset();
+
+  /**
+   * Give the node a slot of its own, call it before the node runs. Return
+   * false if there are no slots left.
+   */
+  bool registerNode(uint32_t node_id);
+
+  /**
+   * Once the memory of a node exceeds the given bytes, its violation is
+   * kept. 0 is no cap.
+   */
+  void setHeapCap(int64_t bytes);
+
+  bool isHeapCapExceeded();
+
+  /**
+   * Violation of the node that was registered first among the ones that
+   * exceeded the heap cap
+   */
+  HeapViolation getViolation();
+
+  /**
+   * Violation of the given node, node ID 0 if it didn't exceed the heap cap
+   */
+  HeapViolation getViolation(uint32_t node_id);
+
+  HeapUsage getUsage(uint32_t node_id);
+
+  HeapUsage getUsage(uint32_t node_id, Subsystem subsystem);
+
+  uint64_t getTotalAllocations();
+
+  uint64_t getTotalBytes();
+
+  static const char* getSubsystemName(Subsystem subsystem);
+
+  uint32_t findSlot(uint32_t node_id);
+};
+
+/**
+ * Allocate memory like operator new, but charge it with another size, for
+ * memory that takes more space on the host than on the devices. NULL if there
+ * is no memory left.
+ */
+void* allocate(size_t size, size_t charged_size) noexcept;
+
+/**
+ * Free memory of operator new or allocate()
+ */
+void release(void* pointer) noexcept;
+
+/**
+ * Slot of the node and subsystem that the thread runs
+ */
+inline uint32_t& currentSlot() {
+  static thread_local uint32_t slot = 0;
+  return slot;
+}
+
+inline Subsystem& currentSubsystem() {
+  static thread_local Subsystem subsystem = OTHER;
+  return subsystem;
+}
+
+/**
+ * Charge the allocations of the thread to a node while in scope, the node is
+ * registered if it wasn't yet
+ */
+class NodeScope {
+  // private:
+ public:
+  uint32_t _previous_slot;
+
+ public:
+  NodeScope(uint32_t node_id) : _previous_slot(currentSlot()) {
+    AllocationTracker& tracker = AllocationTracker::get();
+    tracker.registerNode(node_id);
+    currentSlot() = tracker.findSlot(node_id);
+  };
+
+  ~NodeScope() {
+    currentSlot() = this->_previous_slot;
+  };
+};
+
+/**
+ * Charge the allocations of the thread to a subsystem while in scope
+ */
+class SubsystemScope {
+  // private:
+ public:
+  Subsystem _previous_subsystem;
+
+ public:
+  SubsystemScope(Subsystem subsystem)
+      : _previous_subsystem(currentSubsystem()) {
+    currentSubsystem() = subsystem;
+  };
+
+  ~SubsystemScope() {
+    currentSubsystem() = this->_previous_subsystem;
+  };
+};
+
+} // namespace allocation_tracker
+
+#endif
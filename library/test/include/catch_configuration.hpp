@@ -8,8 +8,20 @@
     #define _RAMEN_CONFIGURATION_HPP_
 
     #include "Arduino.h"
+    #include <cstring>
     #include <string>
 
+    // Standard headers of the simulator, they don't compile once private is
+    // made public below
+    #include <fstream>
+    #include <sstream>
+
+    // Charge the allocations of a function to a subsystem of ramen
+    #include "allocation_tracker.hpp"
+    #define RAMEN_ALLOCATION_SCOPE(subsystem) \
+        allocation_tracker::SubsystemScope _allocation_scope( \
+            allocation_tracker::subsystem)
+
     // Used for testing of pc
     typedef std::string string_t;
 
@@ -23,6 +35,35 @@
     #define ARDUINOJSON_ENABLE_ARDUINO_STRING 0
     #include <ArduinoJson.h>
 
+    // The pools of the JSON documents are charged to the allocation tracker.
+    // They hold pointers, which take twice the space of the ESP8266, so they
+    // get twice the capacity and are charged with the capacity of the device.
+    struct TrackingAllocator {
+        void* allocate(size_t size) {
+            return allocation_tracker::allocate(size, size / 2);
+        }
+
+        void deallocate(void* pointer) {
+            allocation_tracker::release(pointer);
+        }
+
+        // Only used to shrink a pool
+        void* reallocate(void* pointer, size_t size) {
+            void* resized_ptr = this->allocate(size);
+            if(resized_ptr != NULL) {
+                memcpy(resized_ptr, pointer, size);
+                this->deallocate(pointer);
+            }
+            return resized_ptr;
+        }
+    };
+
+    class json_document_t : public BasicJsonDocument<TrackingAllocator> {
+      public:
+        explicit json_document_t(size_t capacity)
+            : BasicJsonDocument<TrackingAllocator>(capacity * 2) {};
+    };
+
     // Arduino's Serial
     #include "fake_serial.hpp"
 
@@ -30,14 +71,15 @@
     #include "fake_painlessmesh.hpp"
     using painlessMesh = fake_painlessmesh::painlessMesh;
 
+    // ESP-NOW
+    #include "fake_espnow.hpp"
+    using EspNowRadio = fake_espnow::EspNowRadio;
+
     #include "catch_common.hpp"
 
     // Make everything public for testing
     #define private public
 
-    // Variavles for testing
-    #define RAMEN_UNIT_TESTING_PAYLOAD_SIZE 100000
-
     // ramen variables to overwrite
 
 #endif
@@ -0,0 +1,98 @@
+/**
+ * Writes what happens in a simulation as one JSON object per line, such as
+ *
+ *   {"time":1520345,"node":3,"event":"election","result":"won","term":2}
+ *
+ * so that the scripts read exact results instead of parsing the printed
+ * output. Every line has the time in microseconds, the node ID (0 for events
+ * of the whole network) and the event type, followed by the fields of the
+ * type.
+ *
+ */
+
+#ifndef _RAMEN_EVENT_SINK_HPP_
+#define _RAMEN_EVENT_SINK_HPP_
+
+#include <algorithm>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace simulator {
+
+/**
+ * An event that is not written yet
+ */
+struct Record {
+  uint64_t time;
+  // Records at the same time are written in the order of their nodes
+  uint32_t order;
+  std::string line;
+};
+
+class EventSink {
+  // private:
+ public:
+  std::ofstream _file;
+  uint64_t _written_records = 0;
+
+  static bool isEarlier(const Record& a, const Record& b) {
+    return a.time != b.time ? a.time < b.time : a.order < b.order;
+  };
+
+ public:
+  /**
+   * Open the file to write to, an existing file is overwritten
+   */
+  bool open(const std::string& path) {
+    this->_file.open(path, std::ios::out | std::ios::trunc);
+    return this->_file.is_open();
+  };
+
+  /**
+   * Format an event, the fields are a comma separated list of "key":value
+   * pairs, or empty
+   */
+  static Record format(uint64_t time,
+                       uint32_t order,
+                       uint32_t node_id,
+                       const char* event,
+                       const std::string& fields) {
+    Record record = {time, order, ""};
+    record.line = "{\"time\":" + std::to_string(time) +
+                  ",\"node\":" + std::to_string(node_id) + ",\"event\":\"" +
+                  event + "\"";
+    if(!fields.empty()) {
+      record.line += "," + fields;
+    }
+    record.line += "}\n";
+
+    return record;
+  };
+
+  /**
+   * Write the records ordered by time, records that are equal in time keep
+   * their order
+   */
+  void write(std::vector<Record>& records) {
+    std::stable_sort(records.begin(), records.end(), isEarlier);
+
+    for(auto& record : records) {
+      this->_file << record.line;
+    }
+    this->_written_records += records.size();
+    records.clear();
+  };
+
+  void flush() {
+    this->_file.flush();
+  };
+
+  uint64_t getWrittenRecords() {
+    return this->_written_records;
+  };
+};
+
+} // namespace simulator
+
+#endif
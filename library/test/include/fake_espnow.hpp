@@ -0,0 +1,126 @@
+/**
+ * Used to provide the functionality of ESP-NOW without actually having the
+ * hardware. All radios in the process share a single medium, which drops
+ * frames larger than what ESP-NOW allows and loses frames at a given rate.
+ *
+ */
+
+#ifndef _RAMEN_FAKE_ESPNOW_HPP_
+#define _RAMEN_FAKE_ESPNOW_HPP_
+
+#include <algorithm>
+#include <functional>
+#include <list>
+#include <random>
+#include <vector>
+
+// Largest frame ESP-NOW can send
+#define FAKE_ESPNOW_MAX_FRAME_SIZE 250
+
+namespace fake_espnow {
+
+typedef std::function<void(const uint8_t* data, uint8_t length)>
+    receivedFrameCallback_t;
+
+class EspNowRadio;
+
+class Medium {
+  // private:
+ public:
+  std::list<EspNowRadio*> _radios;
+  double _loss_rate = 0;
+  std::mt19937 _random_generator;
+
+ public:
+  static Medium& get() {
+    static Medium medium;
+    return medium;
+  };
+
+  void setLossRate(double loss_rate) {
+    this->_loss_rate = loss_rate;
+  };
+
+  void seed(uint32_t seed) {
+    this->_random_generator.seed(seed);
+  };
+
+  bool isLost() {
+    std::uniform_real_distribution<double> distribution(0, 1);
+    return distribution(this->_random_generator) < this->_loss_rate;
+  };
+};
+
+class EspNowRadio {
+  // private:
+ public:
+  uint32_t _node_id = 0;
+  bool _initialized = false;
+  receivedFrameCallback_t _received_callback;
+  std::list<std::vector<uint8_t>> _frame_buffer;
+
+ public:
+  ~EspNowRadio() {
+    Medium::get()._radios.remove(this);
+  };
+
+  ///////////////////////////////////////////////////
+  // Methods for faking ESP-NOW functionality      //
+  ///////////////////////////////////////////////////
+  bool init() {
+    if(!this->_initialized) {
+      Medium::get()._radios.push_back(this);
+      this->_initialized = true;
+    }
+
+    return true;
+  };
+
+  uint32_t getNodeId() {
+    return this->_node_id;
+  };
+
+  bool sendFrame(const uint8_t* data, uint8_t length) {
+    // ESP-NOW refuses to send frames that are too large
+    if(!this->_initialized || length > FAKE_ESPNOW_MAX_FRAME_SIZE) {
+      return false;
+    }
+
+    // Broadcast frames are not acknowledged, so a lost frame still counts as
+    // sent
+    for(auto radio : Medium::get()._radios) {
+      if(radio != this && !Medium::get().isLost()) {
+        radio->_frame_buffer.push_back(
+            std::vector<uint8_t>(data, data + length));
+      }
+    }
+
+    return true;
+  };
+
+  void onReceiveFrame(receivedFrameCallback_t on_receive) {
+    this->_received_callback = on_receive;
+  };
+
+  void update() {
+    while(this->_frame_buffer.size() > 0) {
+      auto frame = this->_frame_buffer.front();
+      this->_frame_buffer.pop_front();
+
+      if(this->_received_callback) {
+        this->_received_callback(frame.data(), frame.size());
+      }
+    }
+  };
+
+  /////////////////////////////////////////////////////
+  // Methods used for modifying the radio for testing //
+  /////////////////////////////////////////////////////
+  void setNodeId(uint32_t node_id) {
+    this->_node_id = node_id;
+  };
+};
+
+} // namespace fake_espnow
+
+#endif
@@ -7,7 +7,10 @@
 #ifndef _RAMEN_FAKE_PAINLESSMESH_HPP_
 #define _RAMEN_FAKE_PAINLESSMESH_HPP_
 
+#include <algorithm>
 #include <list>
+#include <map>
+#include <set>
 #include <vector>
 
 #include "catch_common.hpp"
@@ -23,12 +26,54 @@
 namespace fake_painlessmesh {
 
 typedef std::function<void(uint32_t from, string_t& msg)> receivedCallback_t;
+typedef std::function<void()> changedConnectionsCallback_t;
+
+class painlessMesh;
 
 struct Node {
   uint32_t node_id;
   std::list<std::pair<uint32_t, string_t>>* message_buffer_ptr;
+  painlessMesh* mesh_ptr;
 };
 
+typedef std::function<void(
+    painlessMesh& sender, const Node& destination, string_t& data)>
+    sendHook_t;
+
+/**
+ * When set, messages are handed to the hook instead of being put into the
+ * message buffer of the destination right away, so that a simulator can
+ * deliver them later
+ */
+inline sendHook_t& sendHook() {
+  static sendHook_t hook;
+  return hook;
+}
+
+/**
+ * Whether every sent and received message is printed in full, which takes
+ * most of the time of a large simulation
+ */
+inline bool& printMessages() {
+  static bool print = true;
+  return print;
+}
+
+/**
+ * When set, addNeighbourNode() only remembers the meshes that got new
+ * connections, and notifyChangedConnections() lets them know all at once.
+ * Building a large mesh one connection at a time is too slow otherwise.
+ */
+inline bool& deferChangedConnections() {
+  static bool deferred = false;
+  return deferred;
+}
+
+inline std::set<painlessMesh*>& changedMeshes() {
+  static std::set<painlessMesh*> meshes;
+  return meshes;
+}
+
 class painlessMesh {
   // private:
  public:
@@ -41,6 +86,35 @@ class painlessMesh {
   uint32_t _mesh_time = 0;
   uint32_t _node_id;
   receivedCallback_t _received_callback;
+  std::list<changedConnectionsCallback_t> _changed_connections_callbacks;
+  Scheduler* _scheduler_ptr = NULL;
+  // Marks the meshes that were visited by the current traversal
+  uint64_t _visit_mark = 0;
+
+  static uint64_t& visitEpoch() {
+    static uint64_t epoch = 0;
+    return epoch;
+  };
+
+  // Meshes that can be reached from this mesh in breadth first order, with
+  // the mesh each of them was first reached from
+  std::vector<std::pair<painlessMesh*, painlessMesh*>> traverse() {
+    uint64_t epoch = ++visitEpoch();
+    std::vector<std::pair<painlessMesh*, painlessMesh*>> visited = {
+        std::make_pair(this, (painlessMesh*) NULL)};
+    this->_visit_mark = epoch;
+
+    for(uint32_t i = 0; i < visited.size(); ++i) {
+      for(auto const& node : visited[i].first->_nodes) {
+        if(node.mesh_ptr->_visit_mark != epoch) {
+          node.mesh_ptr->_visit_mark = epoch;
+          visited.push_back(std::make_pair(node.mesh_ptr, visited[i].first));
+        }
+      }
+    }
+
+    return visited;
+  };
 
  public:
   ///////////////////////////////////////////////////
@@ -53,9 +127,7 @@ class painlessMesh {
     this->_mesh_name = mesh_name;
     this->_mesh_password = mesh_password;
     this->_mesh_port = mesh_port;
-    if(scheduler_ptr) {
-      // Needed to silence -Werror=unused-parameter here only
-    }
+    this->_scheduler_ptr = scheduler_ptr;
   };
 
   uint32_t getNodeId() {
@@ -72,6 +144,10 @@ class painlessMesh {
     // Check if there is a new message and notify the node via onReceive
     // callback
     this->checkForNewMessages();
+    // Run the tasks that are due, just like painlessMesh does
+    if(this->_scheduler_ptr) {
+      this->_scheduler_ptr->execute();
+    }
   };
 
   bool sendBroadcast(string_t data, bool include_self = false) {
@@ -109,6 +185,22 @@ class painlessMesh {
     this->_received_callback = on_receive;
   };
 
+  void onChangedConnections(changedConnectionsCallback_t on_changed) {
+    this->_changed_connections_callbacks.push_back(on_changed);
+  };
+
+  string_t subConnectionJson(bool pretty = false) {
+    // Build the tree rooted at this node breadth first, so that every node is
+    // placed at its shortest distance, just like painlessMesh routes
+    std::map<painlessMesh*, std::list<painlessMesh*>> subs;
+    auto visited = this->traverse();
+    for(uint32_t i = 1; i < visited.size(); ++i) {
+      subs[visited[i].second].push_back(visited[i].first);
+    }
+
+    return this->nodeTreeJson(subs);
+  };
+
   bool sendSingle(uint32_t destination_id, string_t data) {
     // Find the pointer to the message buffer of the destination node
     for(auto const& node : this->_nodes) {
@@ -116,14 +208,20 @@ class painlessMesh {
         // Insert the message into the target node
         // Here we use this node's id instead of the destination id because,
         // it will serve as the "from" address on the destination node
-        node.message_buffer_ptr->push_back(
-            std::make_pair(this->_node_id, data));
-        printf(ANSI_COLOR_GREEN
-               "[ID:%u @@ %u] Sent message to node %u: %s\n" ANSI_COLOR_RESET,
-               this->_node_id,
-               this->_mesh_time,
-               destination_id,
-               data.c_str());
+        if(sendHook()) {
+          sendHook()(*this, node, data);
+        } else {
+          node.message_buffer_ptr->push_back(
+              std::make_pair(this->_node_id, data));
+        }
+        if(printMessages()) {
+          printf(ANSI_COLOR_GREEN "[ID:%u @@ %u] Sent message to node %u: "
+                                  "%s\n" ANSI_COLOR_RESET,
+                 this->_node_id,
+                 this->_mesh_time,
+                 destination_id,
+                 data.c_str());
+        }
         return true;
       }
     }
@@ -162,8 +260,38 @@ class painlessMesh {
     node.node_id = neighbour_node._node_id;
     node.message_buffer_ptr = &neighbour_node._message_buffer;
 
+    node.mesh_ptr = &neighbour_node;
+
     this->_nodes.push_back(node);
     this->_node_list.push_back(neighbour_node._node_id);
+
+    if(deferChangedConnections()) {
+      changedMeshes().insert(this);
+      changedMeshes().insert(&neighbour_node);
+      return;
+    }
+
+    // Let every node that can reach this node know about the new connection
+    for(auto reachable : this->traverse()) {
+      for(auto& callback : reachable.first->_changed_connections_callbacks) {
+        callback();
+      }
+    }
+  };
+
+  string_t nodeTreeJson(
+      std::map<painlessMesh*, std::list<painlessMesh*>>& subs) {
+    string_t tree =
+        "{\"nodeId\":" + std::to_string(this->_node_id) + ",\"subs\":[";
+    for(auto it = subs[this].begin(); it != subs[this].end(); ++it) {
+      if(it != subs[this].begin()) {
+        tree += ",";
+      }
+      tree += (*it)->nodeTreeJson(subs);
+    }
+    tree += "]}";
+
+    return tree;
   };
 
   void checkForNewMessages() {
@@ -172,12 +300,14 @@ class painlessMesh {
       // Read the message
       auto message = this->_message_buffer.front();
 
-      printf(ANSI_COLOR_CYAN
-             "[ID:%u @@ %u] New message from %u: %s\n" ANSI_COLOR_RESET,
-             this->_node_id,
-             this->_mesh_time,
-             message.first,
-             message.second.c_str());
+      if(printMessages()) {
+        printf(ANSI_COLOR_CYAN
+               "[ID:%u @@ %u] New message from %u: %s\n" ANSI_COLOR_RESET,
+               this->_node_id,
+               this->_mesh_time,
+               message.first,
+               message.second.c_str());
+      }
 
       // Run the callback
       this->_received_callback(message.first, message.second);
@@ -188,6 +318,16 @@ class painlessMesh {
   };
 };
 
+inline void notifyChangedConnections() {
+  for(auto mesh_ptr : changedMeshes()) {
+    for(auto& callback : mesh_ptr->_changed_connections_callbacks) {
+      callback();
+    }
+  }
+
+  changedMeshes().clear();
+}
+
 } // namespace fake_painlessmesh
 
 #endif
\ No newline at end of file
@@ -0,0 +1,1339 @@
+/**
+ * Discrete-event simulator for running many nodes on the fake painlessMesh.
+ * Instead of calling update() on every node in a busy loop, the simulator
+ * keeps a queue of events ordered by virtual time for every node, and wakes a
+ * node only when one of its Raft tasks is due or when a message arrives to it.
+ * Messages go through a link model per edge, which can delay, lose,
+ * duplicate and reorder them, and the network can be partitioned and nodes
+ * crashed and restarted, either from code or from a scenario file. All of it
+ * draws from seeded generators, so a run with the same seed always gives the
+ * same result.
+ *
+ * The nodes can be spread over several worker threads. Time advances in
+ * windows no longer than the shortest link latency, so a message sent within
+ * a window never arrives within the same window, and the nodes don't depend on
+ * each other until the window is over. Messages wait in the inbox of their
+ * destination until then. Events at the same time always run in the same
+ * order, so the result doesn't depend on the number of threads either.
+ *
+ * With an event sink, the simulator writes down the state changes,
+ * elections and commits it sees after every wake up of a node, along with the
+ * scripted faults and the message counters of the nodes.
+ *
+ * The allocations of a node are charged to it by the allocation tracker while
+ * the node runs. With a heap cap, the simulation stops after the window in
+ * which a node went over it.
+ *
+ */
+
+#ifndef _RAMEN_SIMULATOR_HPP_
+#define _RAMEN_SIMULATOR_HPP_
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#include "allocation_tracker.hpp"
+#include "event_sink.hpp"
+#include "ramen.h"
+
+// Nodes with messages held back by the client traffic budget try again after
+// this many microseconds
+#define SIMULATOR_QUEUE_POLL_PERIOD 1000
+
+// Time of a wake up that is not scheduled
+#define SIMULATOR_NEVER ((uint64_t) ~0ULL)
+
+namespace simulator {
+
+typedef std::function<void()> eventCallback_t;
+typedef std::function<void(broth::server::Server* node)> wakeCallback_t;
+typedef std::function<void(uint32_t worker)> job_t;
+
+typedef enum { WAKE = 0, DELIVER = 1 } EventType;
+
+struct Event {
+  uint64_t time;
+  // Events at the same time run in the order of the node that created them,
+  // and then in the order that node created them
+  uint32_t origin;
+  uint64_t sequence;
+  EventType type;
+  uint32_t from;
+  string_t data;
+};
+
+struct Callback {
+  uint64_t time;
+  uint64_t sequence;
+  eventCallback_t callback;
+};
+
+/**
+ * How the messages sent from one node to another behave, times are in
+ * microseconds
+ */
+struct LinkModel {
+  // Every message takes at least the latency, plus a uniformly random part of
+  // the jitter
+  uint32_t latency = 1000;
+  uint32_t jitter = 4000;
+  // Probabilities between 0 and 1 for every message
+  double loss_rate = 0;
+  double duplicate_rate = 0;
+  // Reordered messages are held back by another latency and jitter, so the
+  // messages sent after them overtake them
+  double reorder_rate = 0;
+  // Bytes per second, messages queue up behind each other on a busy link. 0
+  // is unlimited.
+  uint32_t bandwidth = 0;
+};
+
+/**
+ * Counters of what happened to the sent messages
+ */
+struct LinkStatistics {
+  uint64_t sent = 0;
+  uint64_t sent_bytes = 0;
+  uint64_t delivered = 0;
+  uint64_t delivered_bytes = 0;
+  uint64_t lost = 0;
+  uint64_t duplicated = 0;
+  uint64_t reordered = 0;
+  // Dropped by a partition or a crashed node
+  uint64_t dropped = 0;
+};
+
+/**
+ * Everything the simulator keeps for a node. While a window runs, only the
+ * worker of the node touches it, except for the inbox.
+ */
+struct NodeState {
+  broth::server::Server* server;
+  // Min-heap on (time, origin, sequence)
+  std::vector<Event> events;
+  // Time of the pending wake event, SIMULATOR_NEVER if none
+  uint64_t wake_time = SIMULATOR_NEVER;
+  uint64_t sequence = 0;
+  std::atomic<uint64_t> processed_events;
+  // Draws the fate of the messages sent by the node
+  std::mt19937 random_generator;
+  // link_free_times:{to_node_id, time_when_link_is_idle}
+  std::map<uint32_t, uint64_t> link_free_times;
+  LinkStatistics statistics;
+  // Arrival time of the earliest message sent during the current window
+  uint64_t earliest_sent = SIMULATOR_NEVER;
+  // Messages sent to the node during the current window
+  std::mutex inbox_mutex;
+  std::vector<Event> inbox;
+  // What the node was like after its last wake up, to see what changed
+  broth::server::ServerState last_state = broth::server::FOLLOWER;
+  uint32_t last_term = 0;
+  uint32_t last_commit_index = 0;
+  // Events of the node that are not written to the sink yet
+  std::vector<Record> records;
+  // Slot of the node in the allocation tracker, 0 if it has none
+  uint32_t allocation_slot = 0;
+};
+
+/**
+ * Threads that run the same job, each with its own worker index, and wait
+ * until all of them are done. The calling thread is worker 0.
+ */
+class WorkerPool {
+  // private:
+ public:
+  std::vector<std::thread> _threads;
+  std::mutex _mutex;
+  std::condition_variable _start_condition;
+  std::condition_variable _done_condition;
+  const job_t* _job_ptr = NULL;
+  uint64_t _generation = 0;
+  uint32_t _running = 0;
+  bool _stopping = false;
+
+  void loop(uint32_t worker, uint64_t generation) {
+    while(true) {
+      const job_t* job_ptr;
+      {
+        std::unique_lock<std::mutex> lock(this->_mutex);
+        this->_start_condition.wait(lock, [&]() {
+          return this->_stopping || this->_generation != generation;
+        });
+        if(this->_stopping) {
+          return;
+        }
+        generation = this->_generation;
+        job_ptr = this->_job_ptr;
+      }
+
+      (*job_ptr)(worker);
+
+      std::lock_guard<std::mutex> lock(this->_mutex);
+      if(--this->_running == 0) {
+        this->_done_condition.notify_one();
+      }
+    }
+  };
+
+ public:
+  ~WorkerPool() {
+    this->stop();
+  };
+
+  void start(uint32_t workers) {
+    this->stop();
+    this->_stopping = false;
+
+    for(uint32_t worker = 1; worker < workers; ++worker) {
+      this->_threads.push_back(std::thread(
+          &WorkerPool::loop, this, worker, this->_generation));
+    }
+  };
+
+  void stop() {
+    {
+      std::lock_guard<std::mutex> lock(this->_mutex);
+      this->_stopping = true;
+    }
+    this->_start_condition.notify_all();
+
+    for(auto& thread : this->_threads) {
+      thread.join();
+    }
+    this->_threads.clear();
+  };
+
+  uint32_t getWorkers() {
+    return this->_threads.size() + 1;
+  };
+
+  void run(const job_t& job) {
+    if(this->_threads.empty()) {
+      job(0);
+      return;
+    }
+
+    {
+      std::lock_guard<std::mutex> lock(this->_mutex);
+      this->_job_ptr = &job;
+      this->_running = this->_threads.size();
+      ++this->_generation;
+    }
+    this->_start_condition.notify_all();
+
+    job(0);
+
+    std::unique_lock<std::mutex> lock(this->_mutex);
+    this->_done_condition.wait(lock, [&]() { return this->_running == 0; });
+  };
+};
+
+/**
+ * Initialize a server as the node with the given ID, by default on the fake
+ * painlessMesh. Node IDs start from 1.
+ */
+inline void initNode(
+    broth::server::Server& node,
+    uint32_t node_id,
+    broth::logger::LogLevel log_level = broth::logger::CRITICAL,
+    broth::meshnetwork::MeshNetworkType transport =
+        broth::meshnetwork::PAINLESSMESH) {
+  node.setTransport(transport);
+  node._mesh.setNodeId(node_id);
+  node.init(MESH_NAME, MESH_PASSWORD, MESH_PORT, log_level);
+}
+
+class Simulator {
+  // private:
+ public:
+  std::vector<broth::server::Server*> _nodes;
+  std::vector<std::unique_ptr<NodeState>> _states;
+  // node_indices:{node_id, index_in_nodes}
+  std::map<uint32_t, uint32_t> _node_indices;
+  // Min-heap on (time, sequence)
+  std::vector<Callback> _callbacks;
+  uint64_t _callback_sequence = 0;
+  uint64_t _processed_callbacks = 0;
+  // Time at the end of the last window, the nodes are at most this far
+  uint64_t _time = 0;
+  uint32_t _seed;
+  wakeCallback_t _wake_callback;
+  LinkModel _default_link;
+  // links:{(from_node_id, to_node_id), link_model_of_edge}
+  std::map<std::pair<uint32_t, uint32_t>, LinkModel> _links;
+  // Partition group of every node, nodes only reach their own group
+  std::vector<uint32_t> _groups;
+  std::vector<bool> _crashed;
+  WorkerPool _workers;
+  // Earliest event left or sent by the nodes of every worker after a window
+  std::vector<uint64_t> _worker_next_times;
+  EventSink* _sink_ptr = NULL;
+  // Node that stopped the simulation by exceeding the heap cap
+  allocation_tracker::HeapViolation _heap_violation;
+  // Events of the whole network and the scripted ones, not written yet
+  std::vector<Record> _records;
+
+  static bool isLater(const Event& a, const Event& b) {
+    if(a.time != b.time) {
+      return a.time > b.time;
+    }
+    if(a.origin != b.origin) {
+      return a.origin > b.origin;
+    }
+    return a.sequence > b.sequence;
+  };
+
+  static bool isLaterCallback(const Callback& a, const Callback& b) {
+    return a.time != b.time ? a.time > b.time : a.sequence > b.sequence;
+  };
+
+  void push(NodeState& state, Event event) {
+    state.events.push_back(std::move(event));
+    std::push_heap(state.events.begin(), state.events.end(), isLater);
+  };
+
+  Event pop(NodeState& state) {
+    std::pop_heap(state.events.begin(), state.events.end(), isLater);
+    Event event = std::move(state.events.back());
+    state.events.pop_back();
+    return event;
+  };
+
+  void scheduleWake(uint32_t node_index, uint64_t time) {
+    NodeState& state = *this->_states[node_index];
+
+    // A node only needs its earliest wake up
+    if(state.wake_time <= time) {
+      return;
+    }
+
+    state.wake_time = time;
+
+    Event event = {};
+    event.time = time;
+    event.origin = node_index;
+    event.sequence = state.sequence++;
+    event.type = WAKE;
+    this->push(state, std::move(event));
+  };
+
+  bool chance(std::mt19937& random_generator, double probability) {
+    if(probability <= 0) {
+      return false;
+    }
+
+    std::uniform_real_distribution<double> distribution(0, 1);
+    return distribution(random_generator) < probability;
+  };
+
+  uint32_t drawDelay(std::mt19937& random_generator, const LinkModel& link) {
+    std::uniform_int_distribution<uint32_t> distribution(0, link.jitter);
+    return link.latency + distribution(random_generator);
+  };
+
+  const LinkModel& getLink(uint32_t from, uint32_t to) {
+    auto link = this->_links.find(std::make_pair(from, to));
+    return link == this->_links.end() ? this->_default_link : link->second;
+  };
+
+  /**
+   * Shortest time any message can take, which is the longest window that
+   * keeps the nodes independent. At least a microsecond.
+   */
+  uint32_t getLookahead() {
+    uint32_t lookahead = this->_default_link.latency;
+    for(auto& link : this->_links) {
+      lookahead = std::min(lookahead, link.second.latency);
+    }
+
+    return std::max(lookahead, (uint32_t) 1);
+  };
+
+  bool isReachable(uint32_t from_index, uint32_t to_index) {
+    return !this->_crashed[from_index] && !this->_crashed[to_index] &&
+           this->_groups[from_index] == this->_groups[to_index];
+  };
+
+  /**
+   * Runs on the worker of the sender
+   */
+  void deliver(uint32_t from, const fake_painlessmesh::Node& destination,
+               string_t& data) {
+    auto index = this->_node_indices.find(destination.node_id);
+    auto from_index = this->_node_indices.find(from);
+    if(index == this->_node_indices.end() ||
+       from_index == this->_node_indices.end()) {
+      // Not a simulated node, hand it over right away
+      destination.message_buffer_ptr->push_back(std::make_pair(from, data));
+      return;
+    }
+
+    NodeState& sender = *this->_states[from_index->second];
+    NodeState& receiver = *this->_states[index->second];
+    uint64_t now = virtualClockMicros();
+
+    ++sender.statistics.sent;
+    sender.statistics.sent_bytes += data.length();
+
+    if(!this->isReachable(from_index->second, index->second)) {
+      ++sender.statistics.dropped;
+      return;
+    }
+
+    const LinkModel& link = this->getLink(from, destination.node_id);
+
+    if(this->chance(sender.random_generator, link.loss_rate)) {
+      ++sender.statistics.lost;
+      return;
+    }
+
+    uint32_t copies = 1;
+    if(this->chance(sender.random_generator, link.duplicate_rate)) {
+      ++sender.statistics.duplicated;
+      copies = 2;
+    }
+
+    for(uint32_t copy = 0; copy < copies; ++copy) {
+      uint64_t sent_time = now;
+
+      // Wait for the messages ahead on the link to go through first
+      if(link.bandwidth > 0) {
+        uint64_t& free_time = sender.link_free_times[destination.node_id];
+        sent_time = std::max(sent_time, free_time) +
+                    (uint64_t) data.length() * 1000000 / link.bandwidth;
+        free_time = sent_time;
+      }
+
+      Event event = {};
+      // Nothing arrives within the window it was sent in
+      event.time = std::max(
+          sent_time + this->drawDelay(sender.random_generator, link),
+          now + this->getLookahead());
+      event.origin = from_index->second;
+      event.sequence = sender.sequence++;
+      event.type = DELIVER;
+      event.from = from;
+
+      // Messages in flight belong to the mesh rather than to the sender,
+      // otherwise the peaks of the senders would depend on when the other
+      // threads free them
+      uint32_t allocation_slot = allocation_tracker::currentSlot();
+      allocation_tracker::currentSlot() = 0;
+      event.data = data;
+
+      if(this->chance(sender.random_generator, link.reorder_rate)) {
+        ++sender.statistics.reordered;
+        event.time += this->drawDelay(sender.random_generator, link);
+      }
+
+      sender.earliest_sent = std::min(sender.earliest_sent, event.time);
+
+      {
+        std::lock_guard<std::mutex> lock(receiver.inbox_mutex);
+        receiver.inbox.push_back(std::move(event));
+      }
+      allocation_tracker::currentSlot() = allocation_slot;
+    }
+  };
+
+  void wake(uint32_t node_index, uint64_t time) {
+    broth::server::Server* node = this->_nodes[node_index];
+
+    // Run the node at the simulated time
+    node->_mesh.setMeshTime(time);
+    node->update();
+
+    if(this->_wake_callback) {
+      this->_wake_callback(node);
+    }
+
+    this->observe(node_index, time);
+
+    // Sleep until the next task is due, the scheduler counts in milliseconds
+    uint64_t next_time = SIMULATOR_NEVER;
+    uint32_t time_until_next_task = node->getTimeUntilNextTask();
+    if(time_until_next_task != INFINITY) {
+      next_time = time / 1000 * 1000 + time_until_next_task;
+    }
+    if(node->_mesh.hasQueuedMessages()) {
+      next_time = std::min(next_time, time + SIMULATOR_QUEUE_POLL_PERIOD);
+    }
+
+    if(next_time != SIMULATOR_NEVER) {
+      this->scheduleWake(node_index, std::max(next_time, time + 1));
+    }
+  };
+
+  static const char* getStateName(broth::server::ServerState state) {
+    switch(state) {
+      case broth::server::LEADER:
+        return "LEADER";
+      case broth::server::CANDIDATE:
+        return "CANDIDATE";
+      default:
+        return "FOLLOWER";
+    }
+  };
+
+  /**
+   * Keep an event of a node for the sink, runs on the worker of the node
+   * while a window runs
+   */
+  void record(uint32_t node_index,
+              uint64_t time,
+              const char* event,
+              const std::string& fields = "") {
+    if(this->_sink_ptr == NULL) {
+      return;
+    }
+
+    this->_states[node_index]->records.push_back(EventSink::format(
+        time, node_index + 1, this->_nodes[node_index]->_id, event, fields));
+  };
+
+  /**
+   * Keep an event of the whole network for the sink, only between windows
+   */
+  void recordNetwork(const char* event, const std::string& fields = "") {
+    if(this->_sink_ptr == NULL) {
+      return;
+    }
+
+    this->_records.push_back(
+        EventSink::format(this->_time, 0, 0, event, fields));
+  };
+
+  /**
+   * Record what changed in a node since its last wake up
+   */
+  void observe(uint32_t node_index, uint64_t time) {
+    if(this->_sink_ptr == NULL) {
+      return;
+    }
+
+    using namespace broth::server;
+    NodeState& state = *this->_states[node_index];
+    Server* node = this->_nodes[node_index];
+
+    if(node->_state != state.last_state || node->_term != state.last_term) {
+      // A candidate that does anything but take the lead in the same term
+      // lost its election
+      if(state.last_state == CANDIDATE &&
+         !(node->_state == LEADER && node->_term == state.last_term)) {
+        this->record(node_index,
+                     time,
+                     "election",
+                     "\"result\":\"lost\",\"term\":" +
+                         std::to_string(state.last_term));
+      }
+      if(node->_state == CANDIDATE) {
+        this->record(node_index,
+                     time,
+                     "election",
+                     "\"result\":\"started\",\"term\":" +
+                         std::to_string(node->_term));
+      }
+      if(node->_state == LEADER && state.last_state == CANDIDATE &&
+         node->_term == state.last_term) {
+        this->record(node_index,
+                     time,
+                     "election",
+                     "\"result\":\"won\",\"term\":" +
+                         std::to_string(node->_term));
+      }
+
+      this->record(node_index,
+                   time,
+                   "state",
+                   "\"from\":\"" + std::string(getStateName(state.last_state)) +
+                       "\",\"to\":\"" + getStateName(node->_state) +
+                       "\",\"term\":" + std::to_string(node->_term));
+
+      state.last_state = node->_state;
+      state.last_term = node->_term;
+    }
+
+    if(node->_commit_index != state.last_commit_index) {
+      this->record(node_index,
+                   time,
+                   "commit",
+                   "\"index\":" + std::to_string(node->_commit_index));
+      state.last_commit_index = node->_commit_index;
+    }
+  };
+
+  /**
+   * Keep the violation of the node with the lowest index among the ones that
+   * exceeded the heap cap in the window, whichever thread crossed it first
+   */
+  void recordHeapViolation() {
+    allocation_tracker::AllocationTracker& tracker =
+        allocation_tracker::AllocationTracker::get();
+
+    for(uint32_t i = 0; i < this->_nodes.size(); ++i) {
+      allocation_tracker::HeapViolation violation =
+          tracker.getViolation(this->_nodes[i]->_id);
+      if(violation.node_id == 0) {
+        continue;
+      }
+
+      this->_heap_violation = violation;
+      this->record(i,
+                   this->_time,
+                   "heap_cap",
+                   "\"live\":" + std::to_string(violation.live) +
+                       ",\"subsystem\":\"" +
+                       allocation_tracker::AllocationTracker::getSubsystemName(
+                           violation.subsystem) +
+                       "\"");
+      return;
+    }
+  };
+
+  /**
+   * Write the kept events to the sink, only between windows
+   */
+  void writeRecords() {
+    if(this->_sink_ptr == NULL) {
+      return;
+    }
+
+    for(auto& state : this->_states) {
+      for(auto& record : state->records) {
+        this->_records.push_back(std::move(record));
+      }
+      state->records.clear();
+    }
+
+    this->_sink_ptr->write(this->_records);
+  };
+
+  /**
+   * Move the messages of the last window from the inbox into the events of
+   * the node
+   */
+  void receive(uint32_t node_index) {
+    NodeState& state = *this->_states[node_index];
+
+    std::lock_guard<std::mutex> lock(state.inbox_mutex);
+    for(auto& event : state.inbox) {
+      this->push(state, std::move(event));
+    }
+    state.inbox.clear();
+  };
+
+  /**
+   * Process the events of a node before the end of the window
+   */
+  void process(uint32_t node_index, uint64_t window_end) {
+    NodeState& state = *this->_states[node_index];
+
+    while(state.events.size() > 0 && state.events.front().time < window_end) {
+      Event event = this->pop(state);
+
+      virtualClockMicros() = event.time;
+      state.processed_events.fetch_add(1, std::memory_order_relaxed);
+
+      switch(event.type) {
+        case WAKE:
+          // Skip the wake ups that were replaced by an earlier one, crashed
+          // nodes get a new one when they restart
+          if(state.wake_time == event.time) {
+            state.wake_time = SIMULATOR_NEVER;
+            if(!this->_crashed[node_index]) {
+              this->wake(node_index, event.time);
+            }
+          }
+          break;
+
+        case DELIVER: {
+          // Messages in flight are lost if the destination crashed or got
+          // partitioned away meanwhile
+          if(this->_crashed[node_index] ||
+             this->_groups[event.origin] != this->_groups[node_index]) {
+            ++state.statistics.dropped;
+            break;
+          }
+
+          ++state.statistics.delivered;
+          state.statistics.delivered_bytes += event.data.length();
+          this->_nodes[node_index]->_mesh.getMessageBuffer().push_back(
+              std::make_pair(event.from, std::move(event.data)));
+          this->scheduleWake(node_index, event.time);
+          break;
+        }
+      }
+    }
+  };
+
+  /**
+   * Run a window on every worker, each of them takes every n-th node. Return
+   * the time of the earliest event after the window.
+   */
+  uint64_t runWindow(uint64_t window_end) {
+    uint32_t workers = this->_workers.getWorkers();
+    this->_worker_next_times.assign(workers, SIMULATOR_NEVER);
+
+    job_t job = [this, workers, window_end](uint32_t worker) {
+      uint64_t next_time = SIMULATOR_NEVER;
+
+      for(uint32_t i = worker; i < this->_nodes.size(); i += workers) {
+        NodeState& state = *this->_states[i];
+        state.earliest_sent = SIMULATOR_NEVER;
+
+        allocation_tracker::currentSlot() = state.allocation_slot;
+        this->receive(i);
+        this->process(i, window_end);
+        allocation_tracker::currentSlot() = 0;
+
+        // The messages sent in the window wait in the inboxes of the other
+        // nodes
+        next_time = std::min(next_time, state.earliest_sent);
+        if(state.events.size() > 0) {
+          next_time = std::min(next_time, state.events.front().time);
+        }
+      }
+
+      this->_worker_next_times[worker] = next_time;
+    };
+
+    this->_workers.run(job);
+
+    uint64_t next_time = SIMULATOR_NEVER;
+    for(auto time : this->_worker_next_times) {
+      next_time = std::min(next_time, time);
+    }
+
+    return next_time;
+  };
+
+  /**
+   * Time of the earliest event of the nodes, including the messages in the
+   * inboxes
+   */
+  uint64_t getNextEventTime() {
+    uint64_t next_time = SIMULATOR_NEVER;
+
+    for(auto& state : this->_states) {
+      if(state->events.size() > 0) {
+        next_time = std::min(next_time, state->events.front().time);
+      }
+      for(auto& event : state->inbox) {
+        next_time = std::min(next_time, event.time);
+      }
+    }
+
+    return next_time;
+  };
+
+ public:
+  Simulator(uint32_t seed) : _seed(seed) {
+    virtualClockEnabled() = true;
+    virtualClockMicros() = 0;
+
+    // Count the heap of the nodes from here on
+    allocation_tracker::AllocationTracker::get().reset();
+
+    fake_painlessmesh::sendHook() =
+        [this](fake_painlessmesh::painlessMesh& sender,
+               const fake_painlessmesh::Node& destination,
+               string_t& data) {
+          this->deliver(sender._node_id, destination, data);
+        };
+  };
+
+  ~Simulator() {
+    this->_workers.stop();
+    fake_painlessmesh::sendHook() = NULL;
+    virtualClockEnabled() = false;
+  };
+
+  /**
+   * Add a node that was initialized on the fake painlessMesh. Build the node
+   * within an allocation_tracker::NodeScope of its ID to charge its setup to
+   * it.
+   */
+  void addNode(broth::server::Server* node) {
+    allocation_tracker::AllocationTracker& tracker =
+        allocation_tracker::AllocationTracker::get();
+    tracker.registerNode(node->_id);
+
+    this->_node_indices[node->_id] = this->_nodes.size();
+    this->_nodes.push_back(node);
+    this->_states.push_back(std::unique_ptr<NodeState>(new NodeState()));
+    this->_states.back()->server = node;
+    this->_states.back()->processed_events = 0;
+    this->_states.back()->allocation_slot = tracker.findSlot(node->_id);
+    this->_groups.push_back(0);
+    this->_crashed.push_back(false);
+  };
+
+  /**
+   * Build and add the given number of nodes with IDs from 1 on, each charged
+   * to its own ID. The caller deletes them.
+   */
+  std::vector<broth::server::Server*> createNodes(
+      uint32_t count,
+      broth::logger::LogLevel log_level = broth::logger::CRITICAL) {
+    std::vector<broth::server::Server*> nodes;
+
+    for(uint32_t i = 0; i < count; ++i) {
+      allocation_tracker::NodeScope scope(i + 1);
+      nodes.push_back(new broth::server::Server());
+      initNode(*nodes.back(), i + 1, log_level);
+      this->addNode(nodes.back());
+    }
+
+    return nodes;
+  };
+
+  /**
+   * Connect every node to every other node
+   */
+  void connectAll() {
+    fake_painlessmesh::deferChangedConnections() = true;
+
+    for(auto node : this->_nodes) {
+      for(auto neighbour : this->_nodes) {
+        if(node != neighbour) {
+          node->_mesh.addNeighbourNode(neighbour->_mesh);
+        }
+      }
+    }
+
+    fake_painlessmesh::deferChangedConnections() = false;
+    fake_painlessmesh::notifyChangedConnections();
+  };
+
+  /**
+   * Write the events of the simulation to the sink, which has to outlive the
+   * simulator
+   */
+  void setEventSink(EventSink* sink_ptr) {
+    this->_sink_ptr = sink_ptr;
+  };
+
+  /**
+   * Record the message counters and the heap of every node since the start
+   */
+  void recordMetrics() {
+    for(uint32_t i = 0; i < this->_nodes.size(); ++i) {
+      LinkStatistics& statistics = this->_states[i]->statistics;
+      allocation_tracker::HeapUsage heap =
+          allocation_tracker::AllocationTracker::get().getUsage(
+              this->_nodes[i]->_id);
+
+      this->record(
+          i,
+          this->_time,
+          "messages",
+          "\"sent\":" + std::to_string(statistics.sent) +
+              ",\"sent_bytes\":" + std::to_string(statistics.sent_bytes) +
+              ",\"received\":" + std::to_string(statistics.delivered) +
+              ",\"received_bytes\":" +
+              std::to_string(statistics.delivered_bytes) +
+              ",\"lost\":" + std::to_string(statistics.lost) +
+              ",\"dropped\":" + std::to_string(statistics.dropped));
+      this->record(i,
+                   this->_time,
+                   "heap",
+                   "\"live\":" + std::to_string(heap.live) +
+                       ",\"peak\":" + std::to_string(heap.peak) +
+                       ",\"allocations\":" +
+                       std::to_string(heap.allocations));
+    }
+  };
+
+  /**
+   * Stop the simulation once a node has more memory than the given bytes, as
+   * it would run out of heap on a device. 0 is no cap.
+   */
+  void setHeapCap(int64_t bytes) {
+    allocation_tracker::AllocationTracker::get().setHeapCap(bytes);
+  };
+
+  bool isHeapCapExceeded() {
+    return allocation_tracker::AllocationTracker::get().isHeapCapExceeded();
+  };
+
+  /**
+   * Get the node that stopped the simulation by exceeding the heap cap, node
+   * ID 0 if none did
+   */
+  allocation_tracker::HeapViolation getHeapViolation() {
+    return this->_heap_violation;
+  };
+
+  /**
+   * Spread the nodes over the given number of threads, the calling thread is
+   * one of them. Callbacks of wake ups run on these threads, and must only
+   * touch the node they are given.
+   */
+  void setWorkers(uint32_t workers) {
+    this->_workers.start(std::max(workers, (uint32_t) 1));
+  };
+
+  /**
+   * Every message takes a uniformly random delay between the given
+   * microseconds, on the links without a model of their own
+   */
+  void setLinkDelay(uint32_t min_delay, uint32_t max_delay) {
+    this->_default_link.latency = min_delay;
+    this->_default_link.jitter = std::max(min_delay, max_delay) - min_delay;
+  };
+
+  /**
+   * Set the model of the links without a model of their own
+   */
+  void setDefaultLink(const LinkModel& link) {
+    this->_default_link = link;
+  };
+
+  LinkModel& getDefaultLink() {
+    return this->_default_link;
+  };
+
+  /**
+   * Set the model of the link from one node to another, the other direction
+   * is not changed
+   */
+  void setLink(uint32_t from, uint32_t to, const LinkModel& link) {
+    this->_links[std::make_pair(from, to)] = link;
+  };
+
+  /**
+   * Split the nodes into groups that can only reach their own group, nodes
+   * that are not listed form one more group together
+   */
+  void partition(const std::vector<std::vector<uint32_t>>& groups) {
+    std::fill(this->_groups.begin(), this->_groups.end(), 0);
+
+    for(uint32_t i = 0; i < groups.size(); ++i) {
+      for(auto node_id : groups[i]) {
+        auto index = this->_node_indices.find(node_id);
+        if(index != this->_node_indices.end()) {
+          this->_groups[index->second] = i + 1;
+        }
+      }
+    }
+
+    std::string fields = "\"groups\":[";
+    for(uint32_t i = 0; i < groups.size(); ++i) {
+      fields += (i == 0) ? "[" : ",[";
+      for(uint32_t j = 0; j < groups[i].size(); ++j) {
+        fields += ((j == 0) ? "" : ",") + std::to_string(groups[i][j]);
+      }
+      fields += "]";
+    }
+    this->recordNetwork("partition", fields + "]");
+  };
+
+  /**
+   * Let every node reach every other node again
+   */
+  void heal() {
+    std::fill(this->_groups.begin(), this->_groups.end(), 0);
+    this->recordNetwork("heal");
+  };
+
+  /**
+   * Stop a node, it does not run and the messages to and from it are dropped
+   * until it is restarted. The other nodes still see it in the mesh.
+   */
+  void crash(uint32_t node_id) {
+    auto index = this->_node_indices.find(node_id);
+    if(index != this->_node_indices.end() && !this->_crashed[index->second]) {
+      this->_crashed[index->second] = true;
+      this->record(index->second, this->_time, "crash");
+    }
+  };
+
+  /**
+   * Start a crashed node again, with nothing of its state before the crash
+   */
+  void restart(uint32_t node_id) {
+    auto index = this->_node_indices.find(node_id);
+    if(index == this->_node_indices.end() || !this->_crashed[index->second]) {
+      return;
+    }
+
+    broth::server::Server* node = this->_nodes[index->second];
+    allocation_tracker::NodeScope scope(node_id);
+    this->_crashed[index->second] = false;
+    node->_mesh.setMeshTime(this->_time);
+    node->restart();
+    this->record(index->second, this->_time, "restart");
+    this->observe(index->second, this->_time);
+    this->scheduleWake(index->second, this->_time);
+  };
+
+  bool isCrashed(uint32_t node_id) {
+    auto index = this->_node_indices.find(node_id);
+    return index != this->_node_indices.end() && this->_crashed[index->second];
+  };
+
+  /**
+   * Get the node that is the leader and not crashed, NULL if there is none
+   * or more than one
+   */
+  broth::server::Server* getLeader() {
+    broth::server::Server* leader = NULL;
+
+    for(uint32_t i = 0; i < this->_nodes.size(); ++i) {
+      if(!this->_crashed[i] &&
+         this->_nodes[i]->getState() == broth::server::LEADER) {
+        if(leader != NULL) {
+          return NULL;
+        }
+        leader = this->_nodes[i];
+      }
+    }
+
+    return leader;
+  };
+
+  /**
+   * Schedule the events of a scenario file, one event per line as
+   * "<seconds> <command> <arguments>", where the commands are
+   *
+   *   partition <id,id,...> <id,id,...> ...
+   *   heal
+   *   crash <id|leader>
+   *   restart <id|all>
+   *   link <from_id|*> <to_id|*> [latency=] [jitter=] [loss=] [duplicate=]
+   *        [reorder=] [bandwidth=]
+   *
+   * Times of the link model are in microseconds, the rest of a line after #
+   * is a comment. Return false with the line number in the error if the file
+   * can't be read or a line is malformed, nothing is scheduled then.
+   */
+  bool loadScenario(const std::string& path, std::string& error) {
+    std::ifstream file(path);
+    if(!file) {
+      error = "can't open " + path;
+      return false;
+    }
+
+    std::vector<std::pair<uint64_t, eventCallback_t>> events;
+    std::string line;
+    uint32_t line_number = 0;
+
+    while(std::getline(file, line)) {
+      ++line_number;
+      line = line.substr(0, line.find('#'));
+
+      std::istringstream stream(line);
+      double seconds;
+      std::string command;
+      if(!(stream >> seconds)) {
+        // Skip the empty lines
+        if(line.find_first_not_of(" \t\r") == std::string::npos) {
+          continue;
+        }
+        error = "line " + std::to_string(line_number) + ": missing time";
+        return false;
+      }
+
+      std::vector<std::string> arguments;
+      std::string argument;
+      stream >> command;
+      while(stream >> argument) {
+        arguments.push_back(argument);
+      }
+
+      eventCallback_t callback = this->parseCommand(command, arguments);
+      if(!callback) {
+        error = "line " + std::to_string(line_number) + ": bad command '" +
+                command + "'";
+        return false;
+      }
+
+      events.push_back(
+          std::make_pair((uint64_t) (seconds * 1000000), callback));
+    }
+
+    for(auto& event : events) {
+      this->schedule(event.first, event.second);
+    }
+
+    return true;
+  };
+
+  eventCallback_t parseCommand(const std::string& command,
+                               const std::vector<std::string>& arguments) {
+    if(command == "heal" && arguments.empty()) {
+      return [this]() { this->heal(); };
+    }
+
+    if(command == "partition" && !arguments.empty()) {
+      std::vector<std::vector<uint32_t>> groups;
+      for(auto& argument : arguments) {
+        std::vector<uint32_t> group;
+        std::istringstream stream(argument);
+        std::string node_id;
+        while(std::getline(stream, node_id, ',')) {
+          group.push_back(std::strtoul(node_id.c_str(), NULL, 10));
+        }
+        groups.push_back(group);
+      }
+      return [this, groups]() { this->partition(groups); };
+    }
+
+    if(command == "crash" && arguments.size() == 1) {
+      if(arguments[0] == "leader") {
+        return [this]() {
+          broth::server::Server* leader = this->getLeader();
+          if(leader != NULL) {
+            this->crash(leader->_id);
+          }
+        };
+      }
+      uint32_t node_id = std::strtoul(arguments[0].c_str(), NULL, 10);
+      return [this, node_id]() { this->crash(node_id); };
+    }
+
+    if(command == "restart" && arguments.size() == 1) {
+      if(arguments[0] == "all") {
+        return [this]() {
+          for(auto node : this->_nodes) {
+            this->restart(node->_id);
+          }
+        };
+      }
+      uint32_t node_id = std::strtoul(arguments[0].c_str(), NULL, 10);
+      return [this, node_id]() { this->restart(node_id); };
+    }
+
+    if(command == "link" && arguments.size() >= 2) {
+      std::map<std::string, double> values;
+      for(uint32_t i = 2; i < arguments.size(); ++i) {
+        size_t equals = arguments[i].find('=');
+        if(equals == std::string::npos) {
+          return NULL;
+        }
+        values[arguments[i].substr(0, equals)] =
+            std::strtod(arguments[i].c_str() + equals + 1, NULL);
+      }
+
+      for(auto& value : values) {
+        if(value.first != "latency" && value.first != "jitter" &&
+           value.first != "loss" && value.first != "duplicate" &&
+           value.first != "reorder" && value.first != "bandwidth") {
+          return NULL;
+        }
+      }
+
+      std::string from = arguments[0];
+      std::string to = arguments[1];
+      return [this, from, to, values]() {
+        this->updateLinks(from, to, values);
+      };
+    }
+
+    return NULL;
+  };
+
+  void updateLinks(const std::string& from,
+                   const std::string& to,
+                   const std::map<std::string, double>& values) {
+    auto update = [&values](LinkModel& link) {
+      for(auto& value : values) {
+        if(value.first == "latency") {
+          link.latency = value.second;
+        } else if(value.first == "jitter") {
+          link.jitter = value.second;
+        } else if(value.first == "loss") {
+          link.loss_rate = value.second;
+        } else if(value.first == "duplicate") {
+          link.duplicate_rate = value.second;
+        } else if(value.first == "reorder") {
+          link.reorder_rate = value.second;
+        } else if(value.first == "bandwidth") {
+          link.bandwidth = value.second;
+        }
+      }
+    };
+
+    if(from == "*" && to == "*") {
+      update(this->_default_link);
+      for(auto& link : this->_links) {
+        update(link.second);
+      }
+      return;
+    }
+
+    for(auto from_node : this->_nodes) {
+      for(auto to_node : this->_nodes) {
+        if(from_node == to_node ||
+           (from != "*" && std::to_string(from_node->_id) != from) ||
+           (to != "*" && std::to_string(to_node->_id) != to)) {
+          continue;
+        }
+
+        LinkModel link = this->getLink(from_node->_id, to_node->_id);
+        update(link);
+        this->setLink(from_node->_id, to_node->_id, link);
+      }
+    }
+  };
+
+  /**
+   * Call the callback after every node wake up, for example to give data to
+   * the leader. With more than one worker, it runs on the thread of the node.
+   */
+  void onWake(wakeCallback_t on_wake) {
+    this->_wake_callback = on_wake;
+  };
+
+  /**
+   * Wake a node up at the given time at the latest, for example to give it
+   * data then. Only call it from the wake callback of the same node or
+   * between windows.
+   */
+  void wakeAt(broth::server::Server* node, uint64_t time) {
+    auto index = this->_node_indices.find(node->_id);
+    if(index != this->_node_indices.end()) {
+      this->scheduleWake(index->second,
+                         std::max(time, (uint64_t) virtualClockMicros() + 1));
+    }
+  };
+
+  /**
+   * Run the callback at the given time, after the events of the nodes before
+   * that time and before the ones at or after it
+   */
+  void schedule(uint64_t time, eventCallback_t callback) {
+    Callback event = {time, this->_callback_sequence++, callback};
+    this->_callbacks.push_back(std::move(event));
+    std::push_heap(
+        this->_callbacks.begin(), this->_callbacks.end(), isLaterCallback);
+  };
+
+  /**
+   * Start the nodes. The election alarms are drawn again from the seed, since
+   * the nodes seed them from the wall clock. The average hop counts are
+   * worked out here as well, they go through the meshes of the other nodes,
+   * which is not safe once the nodes run in parallel.
+   */
+  void start() {
+    for(uint32_t i = 0; i < this->_nodes.size(); ++i) {
+      NodeState& state = *this->_states[i];
+      std::seed_seq seed = {this->_seed, i};
+      state.random_generator.seed(seed);
+
+      this->_nodes[i]->_random.seed(state.random_generator());
+      state.last_state = this->_nodes[i]->_state;
+      state.last_term = this->_nodes[i]->_term;
+      state.last_commit_index = this->_nodes[i]->_commit_index;
+      this->_nodes[i]->_mesh.setMeshTime(this->_time);
+      this->_nodes[i]->setElectionAlarmValue();
+      this->scheduleWake(i, this->_time);
+    }
+  };
+
+  /**
+   * Process the events up to the given time in microseconds, or until a node
+   * exceeds the heap cap
+   */
+  void runUntil(uint64_t end_time) {
+    uint64_t next_time = this->getNextEventTime();
+
+    while(true) {
+      uint64_t next_callback_time = this->_callbacks.empty()
+                                        ? SIMULATOR_NEVER
+                                        : this->_callbacks.front().time;
+
+      // Callbacks run between the windows, when the nodes are not running
+      if(next_callback_time <= std::min(next_time, end_time)) {
+        std::pop_heap(this->_callbacks.begin(),
+                      this->_callbacks.end(),
+                      isLaterCallback);
+        Callback callback = std::move(this->_callbacks.back());
+        this->_callbacks.pop_back();
+
+        this->_time = std::max(this->_time, callback.time);
+        virtualClockMicros() = this->_time;
+        ++this->_processed_callbacks;
+        callback.callback();
+        this->writeRecords();
+
+        // The callback may have restarted nodes or changed the links
+        next_time = this->getNextEventTime();
+        continue;
+      }
+
+      if(next_time > end_time) {
+        break;
+      }
+
+      // Skip the time when nothing happens
+      uint64_t window_end =
+          std::min(std::min(next_time + this->getLookahead(),
+                            next_callback_time),
+                   end_time + 1);
+
+      next_time = this->runWindow(window_end);
+      this->_time = window_end - 1;
+
+      if(this->isHeapCapExceeded()) {
+        this->recordHeapViolation();
+        this->writeRecords();
+        return;
+      }
+
+      this->writeRecords();
+    }
+
+    this->_time = std::max(this->_time, end_time);
+    virtualClockMicros() = this->_time;
+  };
+
+  /**
+   * Get the simulated time, which is the time of the event of the node when
+   * called during a wake up
+   */
+  uint64_t getTime() {
+    return virtualClockMicros();
+  };
+
+  uint64_t getProcessedEvents() {
+    uint64_t processed_events = this->_processed_callbacks;
+    for(auto& state : this->_states) {
+      processed_events +=
+          state->processed_events.load(std::memory_order_relaxed);
+    }
+
+    return processed_events;
+  };
+
+  LinkStatistics getStatistics() {
+    LinkStatistics statistics;
+    for(auto& state : this->_states) {
+      statistics.sent += state->statistics.sent;
+      statistics.sent_bytes += state->statistics.sent_bytes;
+      statistics.delivered += state->statistics.delivered;
+      statistics.delivered_bytes += state->statistics.delivered_bytes;
+      statistics.lost += state->statistics.lost;
+      statistics.duplicated += state->statistics.duplicated;
+      statistics.reordered += state->statistics.reordered;
+      statistics.dropped += state->statistics.dropped;
+    }
+
+    return statistics;
+  };
+};
+
+} // namespace simulator
+
+#endif
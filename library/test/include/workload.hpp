@@ -0,0 +1,372 @@
+/**
+ * Write workload for the simulated mesh, which distributes entries from every
+ * node and measures how long each of them takes to commit. A write is
+ * committed once the node that distributed it sees it within its own commit
+ * index, so its latency includes forwarding it to the leader and learning the
+ * new commit index back.
+ *
+ * In a closed loop, every node keeps a fixed number of writes outstanding and
+ * distributes the next one when one commits or times out. In an open loop,
+ * every node distributes writes at a given rate regardless of the commits,
+ * with exponentially distributed gaps, and the latency counts from when the
+ * write was due.
+ *
+ */
+
+#ifndef _RAMEN_WORKLOAD_HPP_
+#define _RAMEN_WORKLOAD_HPP_
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "simulator.hpp"
+
+namespace simulator {
+
+typedef enum { CLOSED_LOOP = 0, OPEN_LOOP = 1 } WorkloadMode;
+
+/**
+ * Shape of the workload, times are in microseconds
+ */
+struct WorkloadOptions {
+  WorkloadMode mode = CLOSED_LOOP;
+  // Writes every node keeps outstanding in a closed loop
+  uint32_t outstanding = 1;
+  // Writes per second of every node in an open loop
+  double rate = 10;
+  // Bytes of every entry
+  uint32_t size = 32;
+  // Writes are distributed between the start and the end time, and the ones
+  // that don't commit within the timeout count as failed
+  uint64_t start_time = 5000000;
+  uint64_t end_time = 15000000;
+  uint64_t timeout = 5000000;
+  // Length of the buckets of the throughput over time
+  uint64_t period = 1000000;
+};
+
+/**
+ * Latency percentiles in microseconds
+ */
+struct LatencySummary {
+  uint64_t count = 0;
+  uint64_t min = 0;
+  uint64_t max = 0;
+  double mean = 0;
+  uint64_t p50 = 0;
+  uint64_t p99 = 0;
+  uint64_t p999 = 0;
+};
+
+/**
+ * What the workload of a single node keeps, only touched by the worker of the
+ * node while a window runs
+ */
+struct Writer {
+  uint32_t node_id;
+  uint64_t next_sequence = 0;
+  // Time the next write is due in an open loop
+  uint64_t next_time = 0;
+  // pending:{sequence, time_when_distributed}
+  std::map<uint64_t, uint64_t> pending;
+  uint32_t seen_commit_index = 0;
+  uint64_t issued = 0;
+  uint64_t failed = 0;
+  std::vector<uint64_t> latencies;
+  // Writes that committed in every period since the start
+  std::vector<uint64_t> commits_per_period;
+  std::mt19937 random_generator;
+};
+
+class Workload {
+  // private:
+ public:
+  WorkloadOptions _options;
+  Simulator* _simulation_ptr = NULL;
+  std::vector<Writer> _writers;
+  // writer_indices:{node_id, index_in_writers}
+  std::map<uint32_t, uint32_t> _writer_indices;
+
+  std::string getPrefix(uint32_t node_id) {
+    return std::to_string(node_id) + ":";
+  };
+
+  void issue(broth::server::Server* node, Writer& writer, uint64_t time) {
+    uint64_t sequence = writer.next_sequence++;
+    string_t data = this->getPrefix(writer.node_id) +
+                    std::to_string(sequence) + ":";
+
+    // Random padding, so the compression of the batches doesn't flatter the
+    // bytes per commit
+    std::uniform_int_distribution<int> letter('a', 'z');
+    while(data.length() < this->_options.size) {
+      data += (char) letter(writer.random_generator);
+    }
+
+    writer.pending[sequence] = time;
+    ++writer.issued;
+    node->distribute(data, false);
+  };
+
+  /**
+   * Find the writes of the node among the entries it newly saw committed
+   */
+  void collect(broth::server::Server* node, Writer& writer, uint64_t now) {
+    std::string prefix = this->getPrefix(writer.node_id);
+
+    for(uint32_t i = writer.seen_commit_index + 1; i <= node->_commit_index;
+        ++i) {
+      const string_t& data = node->_log.getLogData(i);
+      if(data.compare(0, prefix.length(), prefix) != 0) {
+        continue;
+      }
+
+      // Duplicated messages may commit a write twice
+      uint64_t sequence =
+          std::strtoull(data.c_str() + prefix.length(), NULL, 10);
+      auto write = writer.pending.find(sequence);
+      if(write == writer.pending.end()) {
+        continue;
+      }
+
+      writer.latencies.push_back(now - write->second);
+      writer.pending.erase(write);
+
+      if(now >= this->_options.start_time && now < this->_options.end_time) {
+        uint64_t period =
+            (now - this->_options.start_time) / this->_options.period;
+        ++writer.commits_per_period[period];
+      }
+    }
+
+    writer.seen_commit_index =
+        std::max(writer.seen_commit_index, node->_commit_index);
+  };
+
+  void expire(Writer& writer, uint64_t now) {
+    for(auto write = writer.pending.begin(); write != writer.pending.end();) {
+      if(now - write->second >= this->_options.timeout) {
+        ++writer.failed;
+        write = writer.pending.erase(write);
+      } else {
+        ++write;
+      }
+    }
+  };
+
+  /**
+   * Runs after every wake up of a node, on its worker
+   */
+  void drive(broth::server::Server* node) {
+    auto index = this->_writer_indices.find(node->_id);
+    if(index == this->_writer_indices.end()) {
+      return;
+    }
+
+    Writer& writer = this->_writers[index->second];
+    uint64_t now = this->_simulation_ptr->getTime();
+
+    this->collect(node, writer, now);
+    this->expire(writer, now);
+
+    if(now < this->_options.start_time) {
+      this->_simulation_ptr->wakeAt(node, this->_options.start_time);
+      return;
+    }
+
+    if(this->_options.mode == CLOSED_LOOP) {
+      while(now < this->_options.end_time &&
+            writer.pending.size() < this->_options.outstanding) {
+        this->issue(node, writer, now);
+      }
+    } else {
+      while(writer.next_time <= now &&
+            writer.next_time < this->_options.end_time) {
+        this->issue(node, writer, writer.next_time);
+        writer.next_time += this->drawGap(writer);
+      }
+      if(writer.next_time < this->_options.end_time) {
+        this->_simulation_ptr->wakeAt(node, writer.next_time);
+      }
+    }
+
+    // Come back to time the oldest write out, writes are distributed in the
+    // order of their sequence
+    if(!writer.pending.empty()) {
+      this->_simulation_ptr->wakeAt(
+          node, writer.pending.begin()->second + this->_options.timeout);
+    }
+  };
+
+  uint64_t drawGap(Writer& writer) {
+    std::exponential_distribution<double> gap(this->_options.rate);
+    return std::max((uint64_t) 1,
+                    (uint64_t) (gap(writer.random_generator) * 1000000));
+  };
+
+ public:
+  Workload(const WorkloadOptions& options) : _options(options){};
+
+  /**
+   * Drive all nodes of the simulation, call it after the nodes are added and
+   * before the simulation starts. The workload replaces the wake callback of
+   * the simulation and has to outlive it.
+   */
+  void attach(Simulator& simulation, uint32_t seed) {
+    this->_simulation_ptr = &simulation;
+    this->_writers.clear();
+    this->_writer_indices.clear();
+
+    uint64_t periods =
+        (this->_options.end_time - this->_options.start_time +
+         this->_options.period - 1) /
+        this->_options.period;
+
+    for(uint32_t i = 0; i < simulation._nodes.size(); ++i) {
+      Writer writer;
+      writer.node_id = simulation._nodes[i]->_id;
+      writer.commits_per_period.assign(periods, 0);
+      std::seed_seq seed_sequence = {seed, writer.node_id};
+      writer.random_generator.seed(seed_sequence);
+      writer.next_time = this->_options.start_time;
+      if(this->_options.mode == OPEN_LOOP) {
+        writer.next_time += this->drawGap(writer);
+      }
+
+      this->_writer_indices[writer.node_id] = this->_writers.size();
+      this->_writers.push_back(writer);
+    }
+
+    simulation.onWake([this](broth::server::Server* node) { this->drive(node); });
+  };
+
+  /**
+   * Count the writes that are still not committed as failed, call it once
+   * the simulation is over
+   */
+  void finish() {
+    for(auto& writer : this->_writers) {
+      writer.failed += writer.pending.size();
+      writer.pending.clear();
+    }
+  };
+
+  uint64_t getIssued() {
+    uint64_t issued = 0;
+    for(auto& writer : this->_writers) {
+      issued += writer.issued;
+    }
+    return issued;
+  };
+
+  uint64_t getCommitted() {
+    uint64_t committed = 0;
+    for(auto& writer : this->_writers) {
+      committed += writer.latencies.size();
+    }
+    return committed;
+  };
+
+  uint64_t getFailed() {
+    uint64_t failed = 0;
+    for(auto& writer : this->_writers) {
+      failed += writer.failed;
+    }
+    return failed;
+  };
+
+  /**
+   * Committed writes of all nodes in every period between the start and the
+   * end time
+   */
+  std::vector<uint64_t> getCommitsPerPeriod() {
+    std::vector<uint64_t> commits;
+    for(auto& writer : this->_writers) {
+      commits.resize(writer.commits_per_period.size(), 0);
+      for(uint32_t i = 0; i < commits.size(); ++i) {
+        commits[i] += writer.commits_per_period[i];
+      }
+    }
+    return commits;
+  };
+
+  /**
+   * Latencies of all committed writes, sorted
+   */
+  std::vector<uint64_t> getLatencies() {
+    std::vector<uint64_t> latencies;
+    for(auto& writer : this->_writers) {
+      latencies.insert(
+          latencies.end(), writer.latencies.begin(), writer.latencies.end());
+    }
+    std::sort(latencies.begin(), latencies.end());
+    return latencies;
+  };
+
+  /**
+   * Nearest-rank percentile of sorted latencies, 0 if there are none
+   */
+  static uint64_t getPercentile(const std::vector<uint64_t>& latencies,
+                                double percentile) {
+    if(latencies.empty()) {
+      return 0;
+    }
+
+    // Leave out the rounding error of the percentile, 99.9% of 1000 is 999
+    uint64_t rank = std::ceil(percentile / 100 * latencies.size() - 1e-9);
+    return latencies[std::max(rank, (uint64_t) 1) - 1];
+  };
+
+  static LatencySummary summarize(const std::vector<uint64_t>& latencies) {
+    LatencySummary summary;
+    summary.count = latencies.size();
+    if(latencies.empty()) {
+      return summary;
+    }
+
+    double total = 0;
+    for(auto latency : latencies) {
+      total += latency;
+    }
+
+    summary.min = latencies.front();
+    summary.max = latencies.back();
+    summary.mean = total / latencies.size();
+    summary.p50 = getPercentile(latencies, 50);
+    summary.p99 = getPercentile(latencies, 99);
+    summary.p999 = getPercentile(latencies, 99.9);
+    return summary;
+  };
+
+  /**
+   * Count sorted latencies in buckets whose upper bounds double from a
+   * millisecond, as {upper_bound, count} pairs up to the last non-empty bucket
+   */
+  static std::vector<std::pair<uint64_t, uint64_t>> getHistogram(
+      const std::vector<uint64_t>& latencies) {
+    std::vector<std::pair<uint64_t, uint64_t>> histogram;
+    uint64_t upper_bound = 1000;
+
+    for(auto latency : latencies) {
+      if(histogram.empty()) {
+        histogram.push_back(std::make_pair(upper_bound, 0));
+      }
+      while(latency > histogram.back().first) {
+        upper_bound *= 2;
+        histogram.push_back(std::make_pair(upper_bound, 0));
+      }
+      ++histogram.back().second;
+    }
+
+    return histogram;
+  };
+};
+
+} // namespace simulator
+
+#endif
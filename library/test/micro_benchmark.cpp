@@ -0,0 +1,336 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cxxopts.hpp>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "allocation_tracker.hpp"
+#include "ramen.h"
+
+using namespace broth::logholder;
+using namespace broth::message;
+
+/////////////////////////////////////////////////
+// Measuring
+/////////////////////////////////////////////////
+
+typedef std::function<void()> operation_t;
+
+struct Result {
+  std::string name;
+  uint64_t iterations;
+  double ns_per_op;
+  double allocations_per_op;
+  double bytes_per_op;
+};
+
+// Results of the operations end up here, so they are not optimized away
+static volatile size_t sink = 0;
+
+/**
+ * Run the operation until it took at least the minimum time, doubling the
+ * iterations every round, and report the last round
+ */
+static Result measure(const std::string& name,
+                      const operation_t& operation,
+                      double min_seconds) {
+  // Every allocation of the process is counted by the allocation tracker,
+  // the totals only grow, so the operations are measured by their difference
+  allocation_tracker::AllocationTracker& tracker =
+      allocation_tracker::AllocationTracker::get();
+  Result result = {name, 0, 0, 0, 0};
+  uint64_t iterations = 1;
+
+  while(true) {
+    uint64_t start_allocations = tracker.getTotalAllocations();
+    uint64_t start_bytes = tracker.getTotalBytes();
+    auto start = std::chrono::steady_clock::now();
+
+    for(uint64_t i = 0; i < iterations; ++i) {
+      operation();
+    }
+
+    double elapsed = std::chrono::duration<double, std::nano>(
+                         std::chrono::steady_clock::now() - start)
+                         .count();
+
+    if(elapsed >= min_seconds * 1e9 || iterations >= (1ULL << 32)) {
+      result.iterations = iterations;
+      result.ns_per_op = elapsed / iterations;
+      result.allocations_per_op =
+          (double) (tracker.getTotalAllocations() - start_allocations) /
+          iterations;
+      result.bytes_per_op =
+          (double) (tracker.getTotalBytes() - start_bytes) / iterations;
+      return result;
+    }
+
+    iterations *= 2;
+  }
+}
+
+/////////////////////////////////////////////////
+// Operations
+/////////////////////////////////////////////////
+
+static string_t makeData(uint32_t size) {
+  string_t data;
+  for(uint32_t i = 0; i < size; ++i) {
+    data += (char) ('a' + (i * 7 + i / 26) % 26);
+  }
+  return data;
+}
+
+/**
+ * Build and serialize a message the way the server does before sending it
+ */
+static string_t serializeMessage(MessageType type,
+                                 const string_t& data,
+                                 const std::vector<string_t>& entries,
+                                 bool compress) {
+  Message message(type, 7);
+
+  switch(type) {
+    case REQUEST_VOTE:
+      message.addFields((uint32_t) 6, (uint32_t) 1024);
+      break;
+
+    case SEND_VOTE:
+      message.addFields(true);
+      break;
+
+    case REQUEST_APPEND_ENTRY: {
+      std::vector<std::pair<uint32_t, const string_t*>> batch;
+      for(auto& entry : entries) {
+        batch.push_back(std::make_pair(7, &entry));
+      }
+      message.addFields(1023, 6, std::move(batch), 1000, 200000, compress);
+      break;
+    }
+
+    case RESPOND_APPEND_ENTRY:
+      message.addFields(true, (uint32_t) 1024);
+      break;
+
+    case DISTRIBUTE_ENTRY:
+      message.addFields(data, false);
+      break;
+
+    case DISTRIBUTE_ENTRY_ACK:
+      message.addFields((uint32_t) 666, true);
+      break;
+
+    case HEART_BEAT:
+      message.addFields(
+          (uint32_t) 1000, (uint32_t) 1024, (uint32_t) 7, (uint32_t) 200000);
+      break;
+
+    default:
+      break;
+  }
+
+  return message.serialize();
+}
+
+/**
+ * Decode a message the way Server::receiveData() does, false if it doesn't
+ * fit in the document
+ */
+static bool decodeMessage(const string_t& serialized) {
+  json_document_t payload(RECEIVED_PAYLOAD_SIZE);
+  if(deserializeJson(payload, serialized)) {
+    return false;
+  }
+  MessageType type = payload[TYPE_FIELD_KEY];
+  sink = sink + type;
+  return true;
+}
+
+static std::string formatDouble(double value) {
+  std::ostringstream stream;
+  stream << std::fixed << std::setprecision(2) << value;
+  return stream.str();
+}
+
+int main(int argc, char** argv) {
+  cxxopts::Options options(
+      "ramen micro benchmark",
+      "CPU and heap cost of the messages and the log of ramen");
+
+  // clang-format off
+  options.add_options()
+    ("b,sizes", "entry sizes in bytes", cxxopts::value<std::vector<int>>()->default_value("8,64,512,1008"))
+    ("p,peers", "peer counts of the commit index", cxxopts::value<std::vector<int>>()->default_value("2,10,50,200"))
+    ("batch", "entries per append entry request", cxxopts::value<int>()->default_value("4"))
+    ("min_time", "seconds to run every benchmark for at least", cxxopts::value<double>()->default_value("0.2"))
+    ("filter", "only run the benchmarks whose name contains the given text", cxxopts::value<std::string>()->default_value(""))
+    ("f,output", "write the results to the given JSON file", cxxopts::value<std::string>()->default_value(""))
+    ("h,help", "print the options")
+    ;
+  // clang-format on
+
+  auto result = options.parse(argc, argv);
+
+  if(result.count("help")) {
+    std::cout << options.help() << std::endl;
+    return 0;
+  }
+
+  std::vector<int> sizes = result["sizes"].as<std::vector<int>>();
+  std::vector<int> peer_counts = result["peers"].as<std::vector<int>>();
+  uint32_t batch = result["batch"].as<int>();
+  double min_seconds = result["min_time"].as<double>();
+  std::string filter = result["filter"].as<std::string>();
+  std::string output_path = result["output"].as<std::string>();
+
+  std::vector<Result> results;
+
+  std::printf("%-52s %12s %12s %10s %12s\n",
+              "benchmark",
+              "iterations",
+              "ns/op",
+              "allocs/op",
+              "bytes/op");
+
+  auto run = [&](const std::string& name, const operation_t& operation) {
+    if(name.find(filter) == std::string::npos) {
+      return;
+    }
+
+    results.push_back(measure(name, operation, min_seconds));
+    Result& last = results.back();
+    std::printf("%-52s %12llu %12.1f %10.2f %12.1f\n",
+                last.name.c_str(),
+                (unsigned long long) last.iterations,
+                last.ns_per_op,
+                last.allocations_per_op,
+                last.bytes_per_op);
+    std::fflush(stdout);
+  };
+
+  // A device never receives messages that don't fit in its document
+  auto run_decode = [&](const std::string& name, const string_t& serialized) {
+    if(name.find(filter) == std::string::npos) {
+      return;
+    }
+
+    if(!decodeMessage(serialized)) {
+      std::printf("%-52s skipped, larger than RECEIVED_PAYLOAD_SIZE\n",
+                  name.c_str());
+      return;
+    }
+
+    run(name, [&]() { decodeMessage(serialized); });
+  };
+
+  // Messages that don't carry any data
+  std::vector<std::pair<std::string, MessageType>> fixed_types = {
+      {"request_vote", REQUEST_VOTE},
+      {"send_vote", SEND_VOTE},
+      {"respond_append_entry", RESPOND_APPEND_ENTRY},
+      {"heart_beat", HEART_BEAT},
+      {"distribute_entry_ack", DISTRIBUTE_ENTRY_ACK}};
+
+  for(auto& type : fixed_types) {
+    string_t serialized = serializeMessage(type.second, "", {}, false);
+
+    run("serialize/" + type.first,
+        [&]() {
+          sink = sink + serializeMessage(type.second, "", {}, false).length();
+        });
+    run_decode("decode/" + type.first, serialized);
+  }
+
+  // Messages that carry entries
+  for(auto size : sizes) {
+    std::string suffix = "/" + std::to_string(size) + "B";
+    string_t data = makeData(size);
+    std::vector<string_t> entries(batch, data);
+
+    string_t distribute = serializeMessage(DISTRIBUTE_ENTRY, data, {}, false);
+    string_t append = serializeMessage(REQUEST_APPEND_ENTRY, "", entries, false);
+    std::string batch_suffix = "/" + std::to_string(batch) + "x" +
+                               std::to_string(size) + "B";
+
+    run("serialize/distribute_entry" + suffix,
+        [&]() {
+          sink = sink +
+                 serializeMessage(DISTRIBUTE_ENTRY, data, {}, false).length();
+        });
+    run_decode("decode/distribute_entry" + suffix, distribute);
+    run("serialize/request_append_entry" + batch_suffix,
+        [&]() {
+          sink = sink + serializeMessage(REQUEST_APPEND_ENTRY, "", entries, false)
+                            .length();
+        });
+#if ENABLE_COMPRESSION
+    run("serialize/request_append_entry_compressed" + batch_suffix,
+        [&]() {
+          sink = sink + serializeMessage(REQUEST_APPEND_ENTRY, "", entries, true)
+                            .length();
+        });
+#endif
+    run_decode("decode/request_append_entry" + batch_suffix, append);
+
+    // The log starts over every LOG_LENGTH entries, so long runs don't run
+    // out of memory, which includes the growth of the log in the cost
+    const uint32_t LOG_LENGTH = 1024;
+    LogHolder* log_ptr = new LogHolder();
+    run("log/push_entry" + suffix, [&]() {
+      if(log_ptr->getLogSize() >= LOG_LENGTH) {
+        delete log_ptr;
+        log_ptr = new LogHolder();
+      }
+      string_t entry = data;
+      log_ptr->pushEntry(std::make_pair(1, std::move(entry)));
+    });
+    delete log_ptr;
+  }
+
+  // The commit index goes through the match indices of all peers
+  for(auto peer_count : peer_counts) {
+    std::vector<uint32_t> peers;
+    for(int i = 1; i <= peer_count; ++i) {
+      peers.push_back(i);
+    }
+
+    LogHolder log;
+    log.resetMatchIndexMap(&peers, 0);
+    for(auto peer : peers) {
+      log.setMatchIndex(peer, (peer * 7919) % 1000);
+    }
+
+    run("log/majority_commit_index/" + std::to_string(peer_count) + "peers",
+        [&]() { sink = sink + log.getMajorityCommitIndex(); });
+  }
+
+  if(!output_path.empty()) {
+    std::ofstream file(output_path, std::ios::out | std::ios::trunc);
+    if(!file) {
+      std::cerr << "Can't open " << output_path << std::endl;
+      return 1;
+    }
+
+    file << "{\"benchmark\":\"micro\",\"results\":[";
+    for(uint32_t i = 0; i < results.size(); ++i) {
+      file << ((i == 0) ? "\n" : ",\n") << "{\"name\":\"" << results[i].name
+           << "\",\"iterations\":" << results[i].iterations
+           << ",\"ns_per_op\":" << formatDouble(results[i].ns_per_op)
+           << ",\"allocations_per_op\":"
+           << formatDouble(results[i].allocations_per_op)
+           << ",\"bytes_per_op\":" << formatDouble(results[i].bytes_per_op)
+           << "}";
+    }
+    file << "\n]}\n";
+
+    std::cout << "\033[95m>> Wrote the results to " << output_path
+              << "\033[0m\n";
+  }
+
+  return 0;
+}
@@ -0,0 +1,323 @@
+#include <cstdio>
+#include <ctime>
+#include <cxxopts.hpp>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "ramen.h"
+#include "simulator.hpp"
+#include "workload.hpp"
+
+using namespace broth::logger;
+using namespace broth::server;
+
+/**
+ * A link model to run the workload on, given as
+ * "<name>[:<key>=<value>...]" with the keys of the link command of the
+ * scenario files, for example "lossy:latency=2000:loss=0.05"
+ */
+struct LinkProfile {
+  std::string name;
+  std::vector<std::string> arguments;
+};
+
+/**
+ * Results of the workload on one cluster size and link model
+ */
+struct Run {
+  uint32_t nodes;
+  LinkProfile link;
+  simulator::LinkModel link_model;
+  uint64_t issued;
+  uint64_t committed;
+  uint64_t failed;
+  double throughput;
+  std::vector<uint64_t> commits_per_period;
+  simulator::LatencySummary latency;
+  std::vector<std::pair<uint64_t, uint64_t>> histogram;
+  double messages_per_commit;
+  double bytes_per_commit;
+  uint32_t commit_index;
+};
+
+static bool parseLinkProfile(const std::string& text, LinkProfile& profile) {
+  std::istringstream stream(text);
+  std::string argument;
+
+  std::getline(stream, profile.name, ':');
+  // Apply to every link
+  profile.arguments = {"*", "*"};
+  while(std::getline(stream, argument, ':')) {
+    profile.arguments.push_back(argument);
+  }
+
+  return !profile.name.empty();
+}
+
+static std::string formatDouble(double value) {
+  std::ostringstream stream;
+  stream << std::setprecision(6) << value;
+  return stream.str();
+}
+
+static Run runWorkload(uint32_t number_of_nodes,
+                       const LinkProfile& link,
+                       const simulator::WorkloadOptions& options,
+                       uint64_t end_time,
+                       uint32_t seed,
+                       uint32_t workers) {
+  simulator::Simulator simulation(seed);
+  simulation.setWorkers(workers);
+
+  std::vector<Server*> nodes = simulation.createNodes(number_of_nodes);
+  simulation.connectAll();
+  simulation.parseCommand("link", link.arguments)();
+
+  simulator::Workload workload(options);
+  workload.attach(simulation, seed);
+
+  // Only count the messages of the measured time
+  simulator::LinkStatistics start_statistics;
+  simulator::LinkStatistics end_statistics;
+  simulation.schedule(options.start_time,
+                      [&]() { start_statistics = simulation.getStatistics(); });
+  simulation.schedule(options.end_time,
+                      [&]() { end_statistics = simulation.getStatistics(); });
+
+  simulation.start();
+  simulation.runUntil(end_time);
+  workload.finish();
+
+  Run run;
+  run.nodes = number_of_nodes;
+  run.link = link;
+  run.link_model = simulation.getDefaultLink();
+  run.issued = workload.getIssued();
+  run.committed = workload.getCommitted();
+  run.failed = workload.getFailed();
+  run.commits_per_period = workload.getCommitsPerPeriod();
+
+  uint64_t measured_commits = 0;
+  for(auto commits : run.commits_per_period) {
+    measured_commits += commits;
+  }
+  run.throughput = (double) measured_commits * 1000000 /
+                   (options.end_time - options.start_time);
+
+  std::vector<uint64_t> latencies = workload.getLatencies();
+  run.latency = simulator::Workload::summarize(latencies);
+  run.histogram = simulator::Workload::getHistogram(latencies);
+
+  uint64_t messages = end_statistics.sent - start_statistics.sent;
+  uint64_t bytes = end_statistics.sent_bytes - start_statistics.sent_bytes;
+  run.messages_per_commit =
+      measured_commits > 0 ? (double) messages / measured_commits : 0;
+  run.bytes_per_commit =
+      measured_commits > 0 ? (double) bytes / measured_commits : 0;
+
+  run.commit_index = 0;
+  for(auto node : nodes) {
+    run.commit_index = std::max(run.commit_index, node->_commit_index);
+    delete node;
+  }
+
+  return run;
+}
+
+static std::string formatRun(const Run& run) {
+  std::string json =
+      "{\"nodes\":" + std::to_string(run.nodes) + ",\"link\":\"" +
+      run.link.name + "\",\"link_model\":{\"latency\":" +
+      std::to_string(run.link_model.latency) +
+      ",\"jitter\":" + std::to_string(run.link_model.jitter) +
+      ",\"loss\":" + formatDouble(run.link_model.loss_rate) +
+      ",\"duplicate\":" + formatDouble(run.link_model.duplicate_rate) +
+      ",\"reorder\":" + formatDouble(run.link_model.reorder_rate) +
+      ",\"bandwidth\":" + std::to_string(run.link_model.bandwidth) + "}" +
+      ",\"issued\":" + std::to_string(run.issued) +
+      ",\"committed\":" + std::to_string(run.committed) +
+      ",\"failed\":" + std::to_string(run.failed) +
+      ",\"commit_index\":" + std::to_string(run.commit_index) +
+      ",\"throughput\":" + formatDouble(run.throughput) +
+      ",\"commits_per_period\":[";
+
+  for(uint32_t i = 0; i < run.commits_per_period.size(); ++i) {
+    json += ((i == 0) ? "" : ",") + std::to_string(run.commits_per_period[i]);
+  }
+
+  json += "],\"latency\":{\"count\":" + std::to_string(run.latency.count) +
+          ",\"min\":" + std::to_string(run.latency.min) +
+          ",\"mean\":" + formatDouble(run.latency.mean) +
+          ",\"p50\":" + std::to_string(run.latency.p50) +
+          ",\"p99\":" + std::to_string(run.latency.p99) +
+          ",\"p999\":" + std::to_string(run.latency.p999) +
+          ",\"max\":" + std::to_string(run.latency.max) + "},\"histogram\":[";
+
+  for(uint32_t i = 0; i < run.histogram.size(); ++i) {
+    json += ((i == 0) ? "{\"le\":" : ",{\"le\":") +
+            std::to_string(run.histogram[i].first) +
+            ",\"count\":" + std::to_string(run.histogram[i].second) + "}";
+  }
+
+  json += "],\"messages_per_commit\":" + formatDouble(run.messages_per_commit) +
+          ",\"bytes_per_commit\":" + formatDouble(run.bytes_per_commit) + "}";
+
+  return json;
+}
+
+int main(int argc, char** argv) {
+  cxxopts::Options options(
+      "ramen replication benchmark",
+      "Commit throughput and latency of ramen on the simulated mesh");
+
+  // clang-format off
+  options.add_options()
+    ("n,nodes", "cluster sizes to run", cxxopts::value<std::vector<int>>()->default_value("3,5,9"))
+    ("L,link", "link model to run, as name:key=value:..., may be repeated", cxxopts::value<std::vector<std::string>>()->default_value("default"))
+    ("m,mode", "closed or open loop", cxxopts::value<std::string>()->default_value("closed"))
+    ("o,outstanding", "writes every node keeps outstanding in a closed loop", cxxopts::value<int>()->default_value("1"))
+    ("r,rate", "writes per second of every node in an open loop", cxxopts::value<double>()->default_value("10"))
+    ("b,size", "bytes of every entry", cxxopts::value<int>()->default_value("32"))
+    ("warmup", "seconds to elect a leader before writing", cxxopts::value<float>()->default_value("5"))
+    ("t,time", "seconds to write for", cxxopts::value<float>()->default_value("10"))
+    ("timeout", "seconds after which a write counts as failed", cxxopts::value<float>()->default_value("5"))
+    ("period", "seconds per bucket of the throughput over time", cxxopts::value<float>()->default_value("1"))
+    ("s,seed", "seed of the simulation", cxxopts::value<int>()->default_value("1"))
+    ("w,workers", "number of threads to run the nodes on", cxxopts::value<int>()->default_value("1"))
+    ("f,output", "write the results to the given JSON file", cxxopts::value<std::string>()->default_value(""))
+    ("h,help", "print the options")
+    ;
+  // clang-format on
+
+  auto result = options.parse(argc, argv);
+
+  if(result.count("help")) {
+    std::cout << options.help() << std::endl;
+    return 0;
+  }
+
+  simulator::WorkloadOptions workload;
+  std::string mode = result["mode"].as<std::string>();
+  if(mode == "closed") {
+    workload.mode = simulator::CLOSED_LOOP;
+  } else if(mode == "open") {
+    workload.mode = simulator::OPEN_LOOP;
+  } else {
+    std::cerr << "Unknown mode " << mode << std::endl;
+    return 1;
+  }
+  workload.outstanding = result["outstanding"].as<int>();
+  workload.rate = result["rate"].as<double>();
+  workload.size = result["size"].as<int>();
+  workload.start_time = result["warmup"].as<float>() * 1000000;
+  workload.end_time =
+      workload.start_time + (uint64_t) (result["time"].as<float>() * 1000000);
+  workload.timeout = result["timeout"].as<float>() * 1000000;
+  workload.period = result["period"].as<float>() * 1000000;
+
+  if(workload.end_time <= workload.start_time || workload.period == 0 ||
+     workload.timeout == 0 || workload.rate <= 0) {
+    std::cerr << "The time, period, timeout and rate must be positive"
+              << std::endl;
+    return 1;
+  }
+
+  // Check the link models before running anything
+  std::vector<LinkProfile> links;
+  for(auto& text : result["link"].as<std::vector<std::string>>()) {
+    LinkProfile profile;
+    if(!parseLinkProfile(text, profile)) {
+      std::cerr << "Invalid link model '" << text << "'" << std::endl;
+      return 1;
+    }
+
+    simulator::Simulator simulation(0);
+    if(!simulation.parseCommand("link", profile.arguments)) {
+      std::cerr << "Invalid link model '" << text << "'" << std::endl;
+      return 1;
+    }
+    links.push_back(profile);
+  }
+
+  std::string output_path = result["output"].as<std::string>();
+  uint32_t seed = result["seed"].as<int>();
+  uint32_t workers = result["workers"].as<int>();
+
+  // The writes that are still outstanding at the end get their timeout
+  uint64_t end_time = workload.end_time + workload.timeout;
+
+  fake_painlessmesh::printMessages() = false;
+
+  std::cout << "\033[95m>> " << mode << " loop, "
+            << (workload.mode == simulator::CLOSED_LOOP
+                    ? std::to_string(workload.outstanding) +
+                          " outstanding write(s)"
+                    : formatDouble(workload.rate) + " write(s) per second")
+            << " of " << workload.size << " bytes per node, seed " << seed
+            << "\033[0m\n";
+
+  std::printf("%6s %-12s %10s %10s %8s %10s %10s %10s %10s %10s\n",
+              "nodes",
+              "link",
+              "committed",
+              "failed",
+              "writes/s",
+              "p50 us",
+              "p99 us",
+              "p999 us",
+              "msgs/cmt",
+              "bytes/cmt");
+
+  std::vector<Run> runs;
+  for(auto number_of_nodes : result["nodes"].as<std::vector<int>>()) {
+    for(auto& link : links) {
+      runs.push_back(
+          runWorkload(number_of_nodes, link, workload, end_time, seed, workers));
+      Run& run = runs.back();
+
+      std::printf("%6u %-12s %10llu %10llu %8.1f %10llu %10llu %10llu %10.1f "
+                  "%10.1f\n",
+                  run.nodes,
+                  run.link.name.c_str(),
+                  (unsigned long long) run.committed,
+                  (unsigned long long) run.failed,
+                  run.throughput,
+                  (unsigned long long) run.latency.p50,
+                  (unsigned long long) run.latency.p99,
+                  (unsigned long long) run.latency.p999,
+                  run.messages_per_commit,
+                  run.bytes_per_commit);
+      std::fflush(stdout);
+    }
+  }
+
+  if(!output_path.empty()) {
+    std::ofstream file(output_path, std::ios::out | std::ios::trunc);
+    if(!file) {
+      std::cerr << "Can't open " << output_path << std::endl;
+      return 1;
+    }
+
+    file << "{\"benchmark\":\"replication\",\"seed\":" << seed
+         << ",\"workload\":{\"mode\":\"" << mode
+         << "\",\"outstanding\":" << workload.outstanding
+         << ",\"rate\":" << formatDouble(workload.rate)
+         << ",\"size\":" << workload.size
+         << ",\"warmup\":" << workload.start_time
+         << ",\"duration\":" << workload.end_time - workload.start_time
+         << ",\"timeout\":" << workload.timeout
+         << ",\"period\":" << workload.period << "},\"runs\":[";
+    for(uint32_t i = 0; i < runs.size(); ++i) {
+      file << ((i == 0) ? "\n" : ",\n") << formatRun(runs[i]);
+    }
+    file << "\n]}\n";
+
+    std::cout << "\033[95m>> Wrote the results to " << output_path
+              << "\033[0m\n";
+  }
+
+  return 0;
+}
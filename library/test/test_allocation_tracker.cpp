@@ -0,0 +1,247 @@
+#include <new>
+#include <vector>
+
+#include "catch2/catch.hpp"
+#include "data_queue.hpp"
+#include "log_holder.hpp"
+#include "message.hpp"
+#include "server.hpp"
+#include "simulator.hpp"
+
+using namespace allocation_tracker;
+
+SCENARIO("Test the allocation tracker") {
+  AllocationTracker& tracker = AllocationTracker::get();
+  tracker.reset();
+
+  GIVEN("Memory allocated by a node in a subsystem") {
+    char* memory_ptr;
+    {
+      NodeScope node_scope(1);
+      SubsystemScope subsystem_scope(LOG_HOLDER);
+      memory_ptr = new char[1000];
+    }
+    HeapUsage allocated = tracker.getUsage(1);
+    HeapUsage allocated_log = tracker.getUsage(1, LOG_HOLDER);
+
+    delete[] memory_ptr;
+    HeapUsage freed = tracker.getUsage(1);
+
+    THEN("It should be charged to the node and the subsystem") {
+      REQUIRE(allocated.live == 1000);
+      REQUIRE(allocated.allocations == 1);
+      REQUIRE(allocated_log.live == 1000);
+      REQUIRE(tracker.getUsage(1, DATA_QUEUE).allocations == 0);
+    }
+
+    THEN("Freeing it should keep the peak") {
+      REQUIRE(freed.live == 0);
+      REQUIRE(freed.peak == 1000);
+      REQUIRE(tracker.getUsage(1, LOG_HOLDER).live == 0);
+    }
+  }
+
+  GIVEN("Memory allocated by a node without exceptions") {
+    char* memory_ptr;
+    {
+      NodeScope node_scope(1);
+      memory_ptr = new(std::nothrow) char[1000];
+    }
+    HeapUsage allocated = tracker.getUsage(1);
+
+    delete[] memory_ptr;
+
+    THEN("It should be counted like any other memory") {
+      REQUIRE(memory_ptr != NULL);
+      REQUIRE(allocated.live == 1000);
+      REQUIRE(tracker.getUsage(1).live == 0);
+    }
+  }
+
+  GIVEN("A JSON document of a node") {
+    json_document_t* document_ptr;
+    {
+      NodeScope node_scope(1);
+      document_ptr = new json_document_t(RECEIVED_PAYLOAD_SIZE);
+    }
+    int64_t allocated = tracker.getUsage(1).live;
+
+    delete document_ptr;
+
+    THEN("Its pool should be charged with the capacity of the device") {
+      REQUIRE(allocated >= RECEIVED_PAYLOAD_SIZE);
+      REQUIRE(allocated < RECEIVED_PAYLOAD_SIZE + 200);
+      REQUIRE(tracker.getUsage(1).live == 0);
+    }
+  }
+
+  GIVEN("Memory allocated outside of a node") {
+    tracker.registerNode(1);
+    char* memory_ptr = new char[1000];
+
+    THEN("It should not be charged to any node") {
+      REQUIRE(tracker.getUsage(1).allocations == 0);
+    }
+
+    delete[] memory_ptr;
+  }
+
+  GIVEN("Memory allocated before a reset") {
+    char* memory_ptr;
+    {
+      NodeScope node_scope(1);
+      memory_ptr = new char[1000];
+    }
+    tracker.reset();
+    tracker.registerNode(1);
+
+    delete[] memory_ptr;
+
+    THEN("Freeing it should not be counted") {
+      REQUIRE(tracker.getUsage(1).live == 0);
+    }
+  }
+
+  GIVEN("A heap cap") {
+    tracker.setHeapCap(1500);
+
+    char* first_ptr;
+    char* second_ptr;
+    bool exceeded_below_cap;
+    {
+      NodeScope node_scope(2);
+      first_ptr = new char[1000];
+      exceeded_below_cap = tracker.isHeapCapExceeded();
+
+      SubsystemScope subsystem_scope(MESSAGE);
+      second_ptr = new char[1000];
+    }
+    delete[] first_ptr;
+    delete[] second_ptr;
+
+    THEN("The first node above it should be the violation") {
+      REQUIRE_FALSE(exceeded_below_cap);
+      REQUIRE(tracker.isHeapCapExceeded());
+      REQUIRE(tracker.getViolation().node_id == 2);
+      REQUIRE(tracker.getViolation().live >= 2000);
+      REQUIRE(tracker.getViolation().subsystem == MESSAGE);
+    }
+  }
+
+  GIVEN("Two nodes above a heap cap") {
+    tracker.setHeapCap(1500);
+    tracker.registerNode(4);
+
+    char* first_ptr;
+    char* second_ptr;
+    {
+      NodeScope node_scope(5);
+      first_ptr = new char[2000];
+    }
+    {
+      NodeScope node_scope(4);
+      second_ptr = new char[2000];
+    }
+    delete[] first_ptr;
+    delete[] second_ptr;
+
+    THEN("Each node should keep its own violation") {
+      REQUIRE(tracker.getViolation(5).node_id == 5);
+      REQUIRE(tracker.getViolation(4).node_id == 4);
+      REQUIRE(tracker.getViolation(6).node_id == 0);
+    }
+
+    THEN("The node registered first should be the violation") {
+      REQUIRE(tracker.getViolation().node_id == 4);
+    }
+  }
+
+  GIVEN("The subsystems of the library") {
+    using namespace broth::dataqueue;
+    using namespace broth::logholder;
+    using namespace broth::message;
+
+    LogHolder* log_ptr = new LogHolder();
+    DataQueue* queue_ptr = new DataQueue();
+    string_t data(200, 'a');
+    string_t serialized;
+    {
+      NodeScope node_scope(3);
+      string_t entry = data;
+      log_ptr->pushEntry(std::make_pair(1, std::move(entry)));
+      // The queue grows by blocks of entries, the first one comes with it
+      for(uint32_t i = 0; i < 64; ++i) {
+        queue_ptr->push(data);
+      }
+
+      Message message(DISTRIBUTE_ENTRY, 3);
+      message.addFields(data, false);
+      serialized = message.serialize();
+    }
+
+    THEN("Their memory should be charged to them") {
+      REQUIRE(tracker.getUsage(3, LOG_HOLDER).allocations > 0);
+      REQUIRE(tracker.getUsage(3, DATA_QUEUE).live > 0);
+      REQUIRE(tracker.getUsage(3, MESSAGE).allocations > 0);
+    }
+
+    delete log_ptr;
+    delete queue_ptr;
+  }
+}
+
+/**
+ * Run three nodes on the given number of threads with a heap cap that is too
+ * small to run them, and get the node that stopped the simulation
+ */
+static HeapViolation runUntilHeapCap(uint32_t workers,
+                                     int64_t& built,
+                                     uint64_t& stopped_at) {
+  using namespace broth::server;
+
+  simulator::Simulator simulation(3);
+  simulation.setWorkers(workers);
+
+  std::vector<Server*> nodes = simulation.createNodes(3);
+  simulation.connectAll();
+
+  built = AllocationTracker::get().getUsage(1).live;
+  simulation.setHeapCap(built + 1000);
+
+  simulation.start();
+  simulation.runUntil(5000000);
+
+  stopped_at = simulation.isHeapCapExceeded() ? simulation.getTime() : 0;
+  for(auto node : nodes) {
+    delete node;
+  }
+
+  return simulation.getHeapViolation();
+}
+
+SCENARIO("Test the heap cap of the simulator") {
+  GIVEN("Three nodes with a heap cap that is too small to run them") {
+    int64_t built = 0;
+    uint64_t serial_stopped_at = 0;
+    uint64_t parallel_stopped_at = 0;
+    HeapViolation serial = runUntilHeapCap(1, built, serial_stopped_at);
+    HeapViolation parallel = runUntilHeapCap(3, built, parallel_stopped_at);
+
+    THEN("The nodes should have been charged for building them") {
+      REQUIRE(built > 0);
+    }
+
+    THEN("The simulation should stop early") {
+      REQUIRE(serial.node_id > 0);
+      REQUIRE(serial_stopped_at > 0);
+      REQUIRE(serial_stopped_at < 5000000);
+    }
+
+    THEN("The same node should stop it on any number of threads") {
+      REQUIRE(parallel.node_id == serial.node_id);
+      REQUIRE(parallel.live == serial.live);
+      REQUIRE(parallel.subsystem == serial.subsystem);
+      REQUIRE(parallel_stopped_at == serial_stopped_at);
+    }
+  }
+}
@@ -0,0 +1,324 @@
+#include <string>
+
+#include "catch2/catch.hpp"
+#include "server.hpp"
+#include "simulator.hpp"
+
+SCENARIO("Test server's broadcastRequestAppendEntries heart beat suppression") {
+  GIVEN("A leader with two followers") {
+    using namespace broth::server;
+
+    Server leader;
+    Server follower_1;
+    Server follower_2;
+    std::vector<Server*> nodes = {&leader, &follower_1, &follower_2};
+
+    // Initialize the nodes, start IDs from 1
+    for(uint32_t i = 0; i < nodes.size(); ++i) {
+      simulator::initNode(*nodes[i], i + 1);
+    }
+
+    leader._mesh.addNeighbourNode(follower_1._mesh);
+    leader._mesh.addNeighbourNode(follower_2._mesh);
+
+    // Move the mesh time past the first heart beat period
+    leader._mesh.setMeshTime(HEART_BEAT_TIMER_PERIOD);
+    leader.switchState(LEADER);
+
+    auto& follower_1_buffer = follower_1._mesh.getMessageBuffer();
+    auto& follower_2_buffer = follower_2._mesh.getMessageBuffer();
+
+    WHEN("None of the followers were contacted before") {
+      leader.broadcastRequestAppendEntries(true);
+
+      THEN("Both followers should get the same broadcast heart beat") {
+        REQUIRE(follower_1_buffer.size() == 1);
+        REQUIRE(follower_2_buffer.size() == 1);
+        REQUIRE_THAT(follower_1_buffer.front().second,
+                     Catch::Matchers::Contains("\"type\":7"));
+        REQUIRE(follower_1_buffer.front().second ==
+                follower_2_buffer.front().second);
+      }
+    }
+
+    WHEN("All followers were sent an append entry request recently") {
+      leader._log.pushEntry(std::make_pair(leader._term, "entry"));
+      leader._log.setNextIndex(follower_1._id, 1);
+      leader._log.setNextIndex(follower_2._id, 1);
+      leader.requestAppendEntries(follower_1._id);
+      leader.requestAppendEntries(follower_2._id);
+      leader.broadcastRequestAppendEntries(true);
+
+      THEN("No heart beat should be sent") {
+        REQUIRE(follower_1_buffer.size() == 1);
+        REQUIRE(follower_2_buffer.size() == 1);
+      }
+
+      THEN("The heart beat should be sent after a heart beat period") {
+        leader._mesh.incrementMeshTimeBy(HEART_BEAT_TIMER_PERIOD);
+        leader.broadcastRequestAppendEntries(true);
+
+        REQUIRE(follower_1_buffer.size() == 2);
+        REQUIRE(follower_2_buffer.size() == 2);
+      }
+    }
+
+    WHEN("An idle follower has pending entries") {
+      leader._log.pushEntry(std::make_pair(leader._term, "entry"));
+      leader.broadcastRequestAppendEntries(true);
+
+      THEN("The entries should be sent instead of the heart beat") {
+        REQUIRE(follower_1_buffer.size() == 1);
+        REQUIRE_THAT(follower_1_buffer.front().second,
+                     Catch::Matchers::Contains("entry"));
+        REQUIRE_THAT(follower_1_buffer.front().second,
+                     !Catch::Matchers::Contains(HEART_BEAT_MESSAGE));
+      }
+    }
+  }
+}
+
+SCENARIO("Test server's handleHeartBeat") {
+  GIVEN("A leader with two entries and a follower") {
+    using namespace broth::server;
+
+    Server leader;
+    Server follower;
+    std::vector<Server*> nodes = {&leader, &follower};
+
+    // Initialize the nodes, start IDs from 1
+    for(uint32_t i = 0; i < nodes.size(); ++i) {
+      simulator::initNode(*nodes[i], i + 1);
+    }
+
+    leader._mesh.addNeighbourNode(follower._mesh);
+    follower._mesh.addNeighbourNode(leader._mesh);
+
+    leader._term = 1;
+    follower._term = 1;
+    leader._log.pushEntry(std::make_pair(1, "first"));
+    leader._log.pushEntry(std::make_pair(1, "second"));
+    leader._commit_index = 2;
+    leader.switchState(LEADER);
+
+    auto& leader_buffer = leader._mesh.getMessageBuffer();
+
+    WHEN("The follower has all the entries") {
+      follower._log.pushEntry(std::make_pair(1, "first"));
+      follower._log.pushEntry(std::make_pair(1, "second"));
+      leader.broadcastHeartBeat();
+      follower._mesh.checkForNewMessages();
+
+      THEN("The follower should commit without responding") {
+        REQUIRE(leader_buffer.size() == 0);
+        REQUIRE(follower._commit_index == 2);
+        REQUIRE(follower._last_known_leader == leader._id);
+      }
+    }
+
+    WHEN("The follower misses the last entry") {
+      follower._log.pushEntry(std::make_pair(1, "first"));
+      leader.broadcastHeartBeat();
+      follower._mesh.checkForNewMessages();
+
+      THEN("The follower should respond with its log size") {
+        REQUIRE(leader_buffer.size() == 1);
+        REQUIRE(follower._commit_index == 0);
+        REQUIRE_THAT(leader_buffer.front().second,
+                     Catch::Matchers::Contains("\"matchIndex\":1"));
+      }
+
+      THEN("The leader should send the missing entry right away") {
+        leader._mesh.checkForNewMessages();
+
+        REQUIRE(leader._log.getNextIndex(follower._id) == 2);
+        REQUIRE_THAT(follower._mesh.getMessageBuffer().back().second,
+                     Catch::Matchers::Contains("second"));
+      }
+    }
+
+    WHEN("The next index of the follower is behind its log") {
+      follower._log.pushEntry(std::make_pair(1, "first"));
+      leader._log.setNextIndex(follower._id, 1);
+      leader.broadcastHeartBeat();
+      follower._mesh.checkForNewMessages();
+      leader._mesh.checkForNewMessages();
+
+      THEN("The leader should continue right after the log of the follower") {
+        REQUIRE(leader._log.getNextIndex(follower._id) == 2);
+        REQUIRE_THAT(follower._mesh.getMessageBuffer().back().second,
+                     Catch::Matchers::Contains("second"));
+        REQUIRE_THAT(follower._mesh.getMessageBuffer().back().second,
+                     !Catch::Matchers::Contains("first"));
+      }
+    }
+  }
+}
+
+SCENARIO("Test server's batched append entry requests") {
+  GIVEN("A leader with three entries and a follower") {
+    using namespace broth::server;
+
+    Server leader;
+    Server follower;
+    std::vector<Server*> nodes = {&leader, &follower};
+
+    // Initialize the nodes, start IDs from 1
+    for(uint32_t i = 0; i < nodes.size(); ++i) {
+      simulator::initNode(*nodes[i], i + 1);
+    }
+
+    leader._mesh.addNeighbourNode(follower._mesh);
+    follower._mesh.addNeighbourNode(leader._mesh);
+
+    leader._term = 2;
+    follower._term = 2;
+    leader._log.pushEntry(std::make_pair(1, "first"));
+    leader._log.pushEntry(std::make_pair(2, "second"));
+    leader._log.pushEntry(std::make_pair(2, "third"));
+    leader.switchState(LEADER);
+    leader._log.setNextIndex(follower._id, 1);
+
+    WHEN("The entries fit in the window of the follower") {
+      REQUIRE(leader.requestAppendEntries(follower._id));
+      follower._mesh.checkForNewMessages();
+
+      THEN("They should be sent in a single request with their own terms") {
+        REQUIRE(follower._log.getLogSize() == 3);
+        REQUIRE(follower._log.getLogTerm(1) == 1);
+        REQUIRE(follower._log.getLogData(3) == "third");
+      }
+
+      THEN("The window should grow with the acknowledgement") {
+        leader._mesh.checkForNewMessages();
+
+        REQUIRE(leader._log.getNextIndex(follower._id) == 4);
+        REQUIRE(leader._replication_window[follower._id].getSize() ==
+                INITIAL_REPLICATION_WINDOW + REPLICATION_WINDOW_INCREASE);
+      }
+    }
+
+    WHEN("The follower can decompress the entries") {
+      string_t repeated(60, 'a');
+      leader._log.pushEntry(std::make_pair(2, repeated));
+      leader._log.pushEntry(std::make_pair(2, repeated));
+      leader._peer_compression[follower._id] = true;
+
+      REQUIRE(leader.requestAppendEntries(follower._id));
+
+      THEN("The repetitive batch should be sent compressed") {
+        auto& buffer = follower._mesh.getMessageBuffer();
+        REQUIRE(buffer.size() == 1);
+        REQUIRE(buffer.front().second.find(repeated) == std::string::npos);
+        REQUIRE(buffer.front().second.find(ENCODING_FIELD_KEY) !=
+                std::string::npos);
+      }
+
+      THEN("The follower should store the original entries") {
+        follower._mesh.checkForNewMessages();
+
+        REQUIRE(follower._log.getLogSize() == 5);
+        REQUIRE(follower._log.getLogData(3) == "third");
+        REQUIRE(follower._log.getLogData(5) == repeated);
+      }
+    }
+
+    WHEN("The follower responds for the first time") {
+      leader._peer_compression.clear();
+      leader.requestAppendEntries(follower._id);
+      follower._mesh.checkForNewMessages();
+      leader._mesh.checkForNewMessages();
+
+      THEN("It should be known to decompress entries") {
+        REQUIRE(leader._peer_compression[follower._id]);
+      }
+    }
+
+    WHEN("The follower has a conflicting entry") {
+      follower._log.pushEntry(std::make_pair(1, "first"));
+      follower._log.pushEntry(std::make_pair(1, "stale"));
+      leader.requestAppendEntries(follower._id);
+      follower._mesh.checkForNewMessages();
+
+      THEN("It should be replaced by the entries of the leader") {
+        REQUIRE(follower._log.getLogSize() == 3);
+        REQUIRE(follower._log.getLogTerm(2) == 2);
+        REQUIRE(follower._log.getLogData(2) == "second");
+      }
+    }
+
+    WHEN("The follower has a longer run of a stale term") {
+      follower._log.pushEntry(std::make_pair(1, "first"));
+      follower._log.pushEntry(std::make_pair(1, "stale"));
+      follower._log.pushEntry(std::make_pair(1, "stale"));
+      follower._log.pushEntry(std::make_pair(1, "stale"));
+      leader._log.pushEntry(std::make_pair(2, "fourth"));
+      leader._log.setNextIndex(follower._id, 4);
+      leader.requestAppendEntries(follower._id);
+      follower._mesh.checkForNewMessages();
+      leader._mesh.checkForNewMessages();
+
+      THEN("The leader should skip the whole conflicting term at once") {
+        REQUIRE(leader._log.getNextIndex(follower._id) == 2);
+      }
+
+      THEN("The follower should catch up with the next request") {
+        follower._mesh.checkForNewMessages();
+
+        REQUIRE(follower._log.getLogSize() == 4);
+        REQUIRE(follower._log.getLogTerm(2) == 2);
+        REQUIRE(follower._log.getLogData(4) == "fourth");
+      }
+    }
+
+    WHEN("A heart beat is nacked while the entries are in flight") {
+      REQUIRE(leader.requestAppendEntries(follower._id));
+      uint32_t request_id =
+          leader._awaiting_append_entry_response[follower._id];
+
+      json_document_t response(1000);
+      response[TYPE_FIELD_KEY] = RESPOND_APPEND_ENTRY;
+      response[TERM_FIELD_KEY] = 2;
+      response[SUCCESS_FIELD_KEY] = false;
+      response[MATCH_INDEX_FIELD_KEY] = 0;
+      leader.handleAppendEntriesResponse(follower._id, response);
+
+      THEN("The window should be left alone and no entries sent again") {
+        REQUIRE(leader._replication_window[follower._id].getSize() ==
+                INITIAL_REPLICATION_WINDOW);
+        REQUIRE(leader._awaiting_append_entry_response[follower._id] ==
+                request_id);
+        REQUIRE(follower._mesh.getMessageBuffer().size() == 1);
+      }
+
+      THEN("The response to the entries should still grow the window") {
+        follower._mesh.checkForNewMessages();
+        leader._mesh.checkForNewMessages();
+
+        REQUIRE(leader._replication_window[follower._id].getSize() ==
+                INITIAL_REPLICATION_WINDOW + REPLICATION_WINDOW_INCREASE);
+        REQUIRE(leader._awaiting_append_entry_response[follower._id] == 0);
+      }
+    }
+
+    WHEN("The request is sent again before a response") {
+      leader.requestAppendEntries(follower._id);
+      leader.requestAppendEntries(follower._id);
+
+      THEN("The window should shrink") {
+        REQUIRE(leader._replication_window[follower._id].getSize() ==
+                INITIAL_REPLICATION_WINDOW / 2);
+      }
+    }
+
+    WHEN("The leader is over its replication budget") {
+      leader._replication_bucket.consume(REPLICATION_BURST,
+                                         leader._mesh.getNodeTime());
+
+      THEN("The entries should be held back") {
+        REQUIRE_FALSE(leader.requestAppendEntries(follower._id));
+        REQUIRE(follower._mesh.getMessageBuffer().size() == 0);
+      }
+    }
+  }
+}
@@ -0,0 +1,140 @@
+#include <string>
+#include <vector>
+
+#include "catch2/catch.hpp"
+#include "compression.hpp"
+
+SCENARIO("Test LZF compression") {
+  GIVEN("Repetitive data") {
+    using namespace broth::compression;
+
+    std::string data;
+    for(uint32_t i = 0; i < 50; ++i) {
+      data += "[2,\"entry\"],";
+    }
+
+    std::vector<uint8_t> compressed;
+    lzfCompress((const uint8_t*) data.c_str(), data.length(), compressed);
+
+    THEN("It should get shorter") {
+      REQUIRE(compressed.size() < data.length() / 4);
+    }
+
+    THEN("It should decompress to the same data") {
+      std::vector<uint8_t> decompressed;
+
+      REQUIRE(lzfDecompress(compressed.data(),
+                            compressed.size(),
+                            decompressed,
+                            data.length()));
+      REQUIRE(std::string(decompressed.begin(), decompressed.end()) == data);
+    }
+
+    THEN("It should not decompress beyond the maximum length") {
+      std::vector<uint8_t> decompressed;
+
+      REQUIRE_FALSE(lzfDecompress(compressed.data(),
+                                  compressed.size(),
+                                  decompressed,
+                                  data.length() - 1));
+    }
+  }
+
+  GIVEN("Data without repetitions") {
+    using namespace broth::compression;
+
+    std::vector<uint8_t> data;
+    for(uint32_t i = 0; i < 256; ++i) {
+      data.push_back(i);
+    }
+
+    std::vector<uint8_t> compressed;
+    std::vector<uint8_t> decompressed;
+    lzfCompress(data.data(), data.size(), compressed);
+
+    THEN("It should still decompress to the same data") {
+      REQUIRE(lzfDecompress(
+          compressed.data(), compressed.size(), decompressed, data.size()));
+      REQUIRE(decompressed == data);
+    }
+  }
+
+  GIVEN("Malformed data") {
+    using namespace broth::compression;
+
+    std::vector<uint8_t> decompressed;
+
+    THEN("A run of literals past the end should be refused") {
+      uint8_t truncated[] = {4, 'a', 'b'};
+
+      REQUIRE_FALSE(lzfDecompress(truncated, 3, decompressed, 100));
+    }
+
+    THEN("A reference before the start should be refused") {
+      uint8_t reference[] = {0, 'a', (1 << 5), 5};
+
+      REQUIRE_FALSE(lzfDecompress(reference, 4, decompressed, 100));
+    }
+  }
+}
+
+SCENARIO("Test base64 encoding") {
+  GIVEN("Some bytes") {
+    using namespace broth::compression;
+
+    THEN("They should be encoded with padding") {
+      REQUIRE(base64Encode((const uint8_t*) "ramen", 5) == "cmFtZW4=");
+      REQUIRE(base64Encode((const uint8_t*) "broth", 4) == "YnJvdA==");
+    }
+
+    THEN("They should decode to the same bytes") {
+      std::vector<uint8_t> data;
+
+      REQUIRE(base64Decode("cmFtZW4=", data));
+      REQUIRE(std::string(data.begin(), data.end()) == "ramen");
+    }
+
+    THEN("Invalid strings should be refused") {
+      std::vector<uint8_t> data;
+
+      REQUIRE_FALSE(base64Decode("cmFtZW4", data));
+      REQUIRE_FALSE(base64Decode("cm=tZW4=", data));
+      REQUIRE_FALSE(base64Decode("cmF!ZW4=", data));
+    }
+  }
+}
+
+SCENARIO("Test compressing entries") {
+  GIVEN("A batch of entries") {
+    using namespace broth::compression;
+
+    string_t data = "[";
+    for(uint32_t i = 0; i < 20; ++i) {
+      data += "[1,\"__heart_beat__\"],";
+    }
+    data += "[1,\"last\"]]";
+
+    THEN("It should compress and decompress to the same batch") {
+      string_t compressed;
+      string_t decompressed;
+
+      REQUIRE(compress(data, compressed));
+      REQUIRE(compressed.length() < data.length());
+      REQUIRE(decompress(compressed, decompressed));
+      REQUIRE(decompressed == data);
+    }
+
+    THEN("Short data should be left as it is") {
+      string_t compressed;
+
+      REQUIRE_FALSE(compress("[[1,\"a\"]]", compressed));
+    }
+
+    THEN("Data with a null character should not be decompressed") {
+      uint8_t with_null[] = {2, 'a', 0, 'b'};
+      string_t data;
+
+      REQUIRE_FALSE(decompress(base64Encode(with_null, 4), data));
+    }
+  }
+}
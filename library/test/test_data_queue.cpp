@@ -5,4 +5,15 @@ SCENARIO("Initialize Data Queue") {
   using namespace broth::dataqueue;
   DataQueue data_queue;
 
-}
\ No newline at end of file
+  GIVEN("Some data in the queue") {
+    data_queue.push("first");
+    data_queue.push("second");
+
+    THEN("Peeking should leave the oldest data in the queue") {
+      REQUIRE(data_queue.peek() == "first");
+      REQUIRE(data_queue.getSize() == 2);
+      REQUIRE(data_queue.pop() == "first");
+      REQUIRE(data_queue.peek() == "second");
+    }
+  }
+}
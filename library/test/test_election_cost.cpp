@@ -0,0 +1,88 @@
+#include <string>
+
+#include "catch2/catch.hpp"
+#include "server.hpp"
+#include "simulator.hpp"
+
+SCENARIO("Test the average depth of painlessMesh node trees") {
+  GIVEN("Node trees in subConnectionJson format") {
+    using namespace broth::utils;
+
+    THEN("A lonely node should have no depth") {
+      REQUIRE(getAverageNodeTreeDepth("{\"nodeId\":1,\"subs\":[]}") == 0);
+    }
+
+    THEN("A star should have depth 1 at its center") {
+      REQUIRE(getAverageNodeTreeDepth(
+                  "{\"nodeId\":1,\"subs\":[{\"nodeId\":2,\"subs\":[]},{"
+                  "\"nodeId\":3,\"subs\":[]}]}") == 1);
+    }
+
+    THEN("A chain should be deeper at its end") {
+      REQUIRE(getAverageNodeTreeDepth(
+                  "{\"nodeId\":1,\"subs\":[{\"nodeId\":2,\"subs\":[{"
+                  "\"nodeId\":3,\"subs\":[]}]}]}") == 1.5);
+    }
+  }
+}
+
+SCENARIO("Test server's election cost") {
+  GIVEN("Three nodes connected in a chain") {
+    using namespace broth::server;
+
+    Server edge_1;
+    Server center;
+    Server edge_2;
+    std::vector<Server*> nodes = {&edge_1, &center, &edge_2};
+
+    // Initialize the nodes, start IDs from 1
+    for(uint32_t i = 0; i < nodes.size(); ++i) {
+      simulator::initNode(*nodes[i], i + 1);
+    }
+
+    edge_1._mesh.addNeighbourNode(center._mesh);
+    center._mesh.addNeighbourNode(edge_1._mesh);
+    center._mesh.addNeighbourNode(edge_2._mesh);
+    edge_2._mesh.addNeighbourNode(center._mesh);
+
+    THEN("The center should have no cost and the edges should have some") {
+      REQUIRE(center.getElectionCost() == 0);
+      REQUIRE(edge_1.getElectionCost() == 0.5);
+      REQUIRE(edge_2.getElectionCost() == 0.5);
+    }
+
+    WHEN("A node joins next to an edge") {
+      Server far;
+      simulator::initNode(far, 4);
+
+      // Calculate the hop count before the topology changes
+      REQUIRE(edge_2.getElectionCost() == 0.5);
+
+      edge_2._mesh.addNeighbourNode(far._mesh);
+      far._mesh.addNeighbourNode(edge_2._mesh);
+
+      THEN("The costs should follow the new topology") {
+        REQUIRE(center.getElectionCost() == Approx(1.0 / 3));
+        REQUIRE(edge_2.getElectionCost() == Approx(1.0 / 3));
+        REQUIRE(edge_1.getElectionCost() == 1);
+        REQUIRE(far.getElectionCost() == 1);
+      }
+    }
+
+    WHEN("A user-defined cost is set") {
+      center.setElectionCostCallback([]() { return 10.0f; });
+
+      THEN("It should replace the hop count based cost") {
+        REQUIRE(center.getElectionCost() == 10);
+      }
+
+      THEN("The candidacy should be delayed by at most one base timeout") {
+        // Makes the base timeout equal to MIN_ELECTION_TIMEOUT
+        center._heart_beat_period = MIN_HEART_BEAT_TIMER_PERIOD;
+        center.setElectionAlarmValue();
+        REQUIRE(center._election_alarm >= 2 * MIN_ELECTION_TIMEOUT);
+        REQUIRE(center._election_alarm < 3 * MIN_ELECTION_TIMEOUT);
+      }
+    }
+  }
+}
@@ -0,0 +1,184 @@
+#include <string>
+
+#include "catch2/catch.hpp"
+#include "espnow_transport.hpp"
+#include "server.hpp"
+#include "simulator.hpp"
+
+SCENARIO("Test the fake ESP-NOW medium") {
+  GIVEN("A radio on the medium") {
+    fake_espnow::EspNowRadio radio;
+    radio.init();
+
+    THEN("Frames larger than ESP-NOW allows should be refused") {
+      uint8_t frame[FAKE_ESPNOW_MAX_FRAME_SIZE + 1] = {};
+
+      REQUIRE(radio.sendFrame(frame, FAKE_ESPNOW_MAX_FRAME_SIZE));
+      REQUIRE_FALSE(radio.sendFrame(frame, FAKE_ESPNOW_MAX_FRAME_SIZE + 1));
+    }
+  }
+}
+
+SCENARIO("Test the ESP-NOW transport") {
+  GIVEN("Three transports on the same medium") {
+    using namespace broth::transport;
+
+    fake_espnow::Medium::get().setLossRate(0);
+
+    EspNowTransport transport_1;
+    EspNowTransport transport_2;
+    EspNowTransport transport_3;
+    std::vector<EspNowTransport*> transports = {
+        &transport_1, &transport_2, &transport_3};
+
+    std::vector<std::list<std::pair<uint32_t, string_t>>> received(3);
+
+    // Initialize the transports, start IDs from 1
+    for(uint32_t i = 0; i < transports.size(); ++i) {
+      transports[i]->setNodeId(i + 1);
+      REQUIRE(transports[i]->init(MESH_NAME, MESH_PASSWORD, NULL, MESH_PORT));
+      transports[i]->onReceive([&received, i](uint32_t from, string_t& data) {
+        received[i].push_back(std::make_pair(from, data));
+      });
+    }
+
+    // Exchange the beacons
+    for(auto transport : transports) {
+      transport->update();
+    }
+    for(auto transport : transports) {
+      transport->update();
+    }
+
+    THEN("The nodes should know each other from the beacons") {
+      REQUIRE(transport_1.getNodeList().size() == 2);
+      REQUIRE(transport_2.getNodeList().size() == 2);
+      REQUIRE(transport_3.getNodeList().size() == 2);
+    }
+
+    WHEN("A message larger than a frame is sent to a single node") {
+      string_t data(1000, 'a');
+      data += "end";
+      REQUIRE(transport_1.sendSingle(2, data));
+
+      transport_2.update();
+      transport_3.update();
+
+      THEN("It should be reassembled by that node only") {
+        REQUIRE(received[1].size() == 1);
+        REQUIRE(received[1].front().first == 1);
+        REQUIRE(received[1].front().second == data);
+        REQUIRE(received[2].size() == 0);
+      }
+    }
+
+    WHEN("A message is broadcasted") {
+      REQUIRE(transport_3.sendBroadcast("broadcast"));
+
+      transport_1.update();
+      transport_2.update();
+
+      THEN("Every other node should receive it") {
+        REQUIRE(received[0].size() == 1);
+        REQUIRE(received[1].size() == 1);
+        REQUIRE(received[0].front().second == "broadcast");
+      }
+    }
+
+    WHEN("A message is too large for the fragment count") {
+      string_t data(255 * ESPNOW_MAX_FRAME_SIZE, 'a');
+
+      THEN("It should be refused") {
+        REQUIRE_FALSE(transport_1.sendSingle(2, data));
+      }
+    }
+
+    WHEN("A frame of a message is lost") {
+      string_t data(1000, 'a');
+      REQUIRE(transport_1.sendSingle(2, data));
+
+      // Lose the last frame
+      transport_2._radio._frame_buffer.pop_back();
+      transport_2.update();
+
+      THEN("The message should not be delivered") {
+        REQUIRE(received[1].size() == 0);
+        REQUIRE(transport_2._pending_messages.size() == 1);
+      }
+
+      THEN("The partial message should be dropped after the timeout") {
+        transport_2.incrementMeshTimeBy(ESPNOW_REASSEMBLY_TIMEOUT + 1);
+        transport_2.update();
+
+        REQUIRE(transport_2._pending_messages.size() == 0);
+      }
+    }
+
+    WHEN("A node goes quiet") {
+      transport_1.incrementMeshTimeBy(ESPNOW_NODE_TIMEOUT + 1);
+      transport_1._radio._frame_buffer.clear();
+      transport_1.update();
+
+      THEN("It should be removed from the node list") {
+        REQUIRE(transport_1.getNodeList().size() == 0);
+      }
+    }
+
+    WHEN("The medium loses every frame") {
+      fake_espnow::Medium::get().setLossRate(1);
+      REQUIRE(transport_1.sendSingle(2, "lost"));
+      transport_2.update();
+      fake_espnow::Medium::get().setLossRate(0);
+
+      THEN("Nothing should be received") {
+        REQUIRE(received[1].size() == 0);
+      }
+    }
+  }
+}
+
+SCENARIO("Test an election over the ESP-NOW transport") {
+  GIVEN("Three servers on ESP-NOW") {
+    using namespace broth::server;
+
+    fake_espnow::Medium::get().setLossRate(0);
+
+    Server server_1;
+    Server server_2;
+    Server server_3;
+    std::vector<Server*> nodes = {&server_1, &server_2, &server_3};
+
+    // Let the scheduled tasks follow the simulated time
+    virtualClockEnabled() = true;
+    virtualClockMicros() = 0;
+
+    // Initialize the nodes, start IDs from 1
+    for(uint32_t i = 0; i < nodes.size(); ++i) {
+      // Elect within a few hundred milliseconds
+      nodes[i]->_heart_beat_period = MIN_HEART_BEAT_TIMER_PERIOD;
+      simulator::initNode(
+          *nodes[i], i + 1, CRITICAL, broth::meshnetwork::ESPNOW);
+    }
+
+    THEN("A single leader should be elected") {
+      uint32_t leaders = 0;
+
+      // Run for a simulated two seconds in steps of a millisecond
+      for(uint32_t time = 0; time < 2000 && leaders == 0; ++time) {
+        virtualClockMicros() += 1000;
+        for(auto node : nodes) {
+          node->update();
+        }
+
+        leaders = 0;
+        for(auto node : nodes) {
+          leaders += (node->getState() == LEADER) ? 1 : 0;
+        }
+      }
+
+      virtualClockEnabled() = false;
+
+      REQUIRE(leaders == 1);
+    }
+  }
+}
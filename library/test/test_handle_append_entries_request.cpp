@@ -3,6 +3,7 @@
 #include "catch2/catch.hpp"
 #include "message.hpp"
 #include "server.hpp"
+#include "simulator.hpp"
 
 using Catch::Matchers::Contains;
 
@@ -11,7 +12,7 @@ SCENARIO("Test server's handleAppendEntriesRequest") {
   using namespace broth::message;
 
   Server server;
-  DynamicJsonDocument data(10000);
+  json_document_t data(10000);
 
   // Prepare the data for the message
   uint32_t sender = random();
@@ -40,3 +41,111 @@ SCENARIO("Test server's handleAppendEntriesRequest") {
   // REQUIRE(server._term == term);
   // REQUIRE(server._voted_for == 0);
 }
+
+SCENARIO("Test the heart beat period advertised by the leader") {
+  using namespace broth::server;
+
+  Server server;
+  json_document_t data(1000);
+  data[TYPE_FIELD_KEY] = REQUEST_APPEND_ENTRY;
+  data[TERM_FIELD_KEY] = 1;
+  data[PREVIOUS_LOG_INDEX_FIELD_KEY] = 0;
+  data[PREVIOUS_LOG_TERM_FIELD_KEY] = 0;
+  data[COMMIT_INDEX_FIELD_KEY] = 0;
+  data[ENTRIES_FIELD_KEY] = HEART_BEAT_MESSAGE;
+
+  GIVEN("A period that is too short") {
+    data[HEART_BEAT_PERIOD_FIELD_KEY] = 1;
+    server.handleAppendEntriesRequest(2, data);
+
+    THEN("The follower should use the shortest period") {
+      REQUIRE(server._heart_beat_period == MIN_HEART_BEAT_TIMER_PERIOD);
+    }
+  }
+
+  GIVEN("A period that is too long") {
+    data[HEART_BEAT_PERIOD_FIELD_KEY] = 1000000000;
+    server.handleAppendEntriesRequest(2, data);
+
+    THEN("The follower should use the longest period") {
+      REQUIRE(server._heart_beat_period == MAX_HEART_BEAT_TIMER_PERIOD);
+    }
+  }
+}
+
+SCENARIO("Test an empty append entry request that doesn't match the log") {
+  using namespace broth::server;
+
+  GIVEN("A follower that misses the entries before the request") {
+    Server server;
+    simulator::initNode(server, 1);
+
+    json_document_t data(1000);
+    data[TYPE_FIELD_KEY] = REQUEST_APPEND_ENTRY;
+    data[TERM_FIELD_KEY] = 0;
+    data[PREVIOUS_LOG_INDEX_FIELD_KEY] = 2;
+    data[PREVIOUS_LOG_TERM_FIELD_KEY] = 0;
+    data[COMMIT_INDEX_FIELD_KEY] = 2;
+    data[ENTRIES_FIELD_KEY] = HEART_BEAT_MESSAGE;
+    data[HEART_BEAT_PERIOD_FIELD_KEY] = HEART_BEAT_TIMER_PERIOD;
+
+    server.handleAppendEntriesRequest(2, data);
+
+    THEN("The commit index of the leader should not be taken over") {
+      REQUIRE(server._commit_index == 0);
+      REQUIRE(server._last_known_leader == 2);
+    }
+  }
+}
+
+SCENARIO("Test the round trip times of append entry requests") {
+  using namespace broth::server;
+
+  GIVEN("A leader with entries for a follower") {
+    Server server;
+    simulator::initNode(server, 1);
+    server.switchState(LEADER);
+    server._log.pushEntry(std::make_pair(0, "a"));
+    server._log.setNextIndex(2, 1);
+    server._log.setMatchIndex(2, 0);
+
+    json_document_t response(1000);
+    response[TYPE_FIELD_KEY] = RESPOND_APPEND_ENTRY;
+    response[TERM_FIELD_KEY] = 0;
+    response[SUCCESS_FIELD_KEY] = false;
+    response[MATCH_INDEX_FIELD_KEY] = 0;
+
+    server.requestAppendEntries(2);
+    uint32_t first_request_id = server._rtt_probe[2].first;
+
+    WHEN("The response to the request comes back") {
+      response[REQUEST_ID_FIELD_KEY] = first_request_id;
+      server.handleAppendEntriesResponse(2, response);
+
+      THEN("The round trip should be timed") {
+        REQUIRE(first_request_id > 0);
+        REQUIRE(server._metrics.getRpcLatency().getCount() == 1);
+      }
+    }
+
+    WHEN("The request is sent again before its response comes back") {
+      server.requestAppendEntries(2);
+      response[REQUEST_ID_FIELD_KEY] = first_request_id;
+      server.handleAppendEntriesResponse(2, response);
+      response[REQUEST_ID_FIELD_KEY] = first_request_id + 1;
+      server.handleAppendEntriesResponse(2, response);
+
+      THEN("Neither response should be timed") {
+        REQUIRE(server._metrics.getRpcLatency().getCount() == 0);
+      }
+    }
+
+    WHEN("A response without a request ID comes back") {
+      server.handleAppendEntriesResponse(2, response);
+
+      THEN("It should not be timed") {
+        REQUIRE(server._metrics.getRpcLatency().getCount() == 0);
+      }
+    }
+  }
+}
@@ -0,0 +1,65 @@
+#include "catch2/catch.hpp"
+#include "log_holder.hpp"
+
+SCENARIO("Test log holder's term runs") {
+  GIVEN("A log with entries of terms 1, 1, 3, 3, 3 and 4") {
+    using namespace broth::logholder;
+    LogHolder log;
+
+    log.pushEntry(std::make_pair(1, "a"));
+    log.pushEntry(std::make_pair(1, "b"));
+    log.pushEntry(std::make_pair(3, "c"));
+    log.pushEntry(std::make_pair(3, "d"));
+    log.pushEntry(std::make_pair(3, "e"));
+    log.pushEntry(std::make_pair(4, "f"));
+
+    THEN("Consecutive entries of a term should share a run") {
+      REQUIRE(log._term_runs.size() == 3);
+    }
+
+    THEN("Every entry should have its own term") {
+      REQUIRE(log.getLogTerm(0) == 0);
+      REQUIRE(log.getLogTerm(1) == 1);
+      REQUIRE(log.getLogTerm(2) == 1);
+      REQUIRE(log.getLogTerm(3) == 3);
+      REQUIRE(log.getLogTerm(5) == 3);
+      REQUIRE(log.getLogTerm(6) == 4);
+      REQUIRE(log.getLogTerm(7) == 0);
+      REQUIRE(log.getLastLogTerm() == 4);
+      REQUIRE(log.getLogData(4) == "d");
+    }
+
+    THEN("The first and last index of every term should be found") {
+      REQUIRE(log.getFirstLogIndexOfTerm(1) == 1);
+      REQUIRE(log.getLastLogIndexOfTerm(1) == 2);
+      REQUIRE(log.getFirstLogIndexOfTerm(3) == 3);
+      REQUIRE(log.getLastLogIndexOfTerm(3) == 5);
+      REQUIRE(log.getLastLogIndexOfTerm(4) == 6);
+    }
+
+    THEN("Terms without entries should not be found") {
+      REQUIRE(log.getFirstLogIndexOfTerm(2) == 0);
+      REQUIRE(log.getLastLogIndexOfTerm(2) == 0);
+      REQUIRE(log.getLastLogIndexOfTerm(5) == 0);
+    }
+
+    WHEN("The log is truncated into the middle of a term") {
+      log.popEntry();
+      log.popEntry();
+
+      THEN("The runs should follow") {
+        REQUIRE(log._term_runs.size() == 2);
+        REQUIRE(log.getLastLogTerm() == 3);
+        REQUIRE(log.getLastLogIndexOfTerm(3) == 4);
+        REQUIRE(log.getLastLogIndexOfTerm(4) == 0);
+      }
+
+      THEN("New entries of a newer term should start a new run") {
+        log.pushEntry(std::make_pair(5, "g"));
+
+        REQUIRE(log.getLogTerm(5) == 5);
+        REQUIRE(log.getFirstLogIndexOfTerm(5) == 5);
+      }
+    }
+  }
+}
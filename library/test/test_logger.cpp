@@ -30,3 +30,50 @@ SCENARIO("Logging level test") {
          "visible below\n");
   logger(CRITICAL, "This message should be visible\n");
 }
+
+SCENARIO("Logging filtered messages test") {
+  using namespace broth::logger;
+  Logger logger;
+
+  logger.setLogLevel(ERROR);
+
+  GIVEN("A message below the logging level") {
+    logger(ERROR, "This message should be visible\n");
+    logger._printed_output = false;
+    logger(DEBUG, "This message should NOT be %s\n", "formatted");
+
+    THEN("It should not be formatted or printed") {
+      REQUIRE_FALSE(logger._printed_output);
+      REQUIRE(string_t(logger._str) == "This message should be visible\n");
+    }
+  }
+
+  GIVEN("A message below the logging level through RAMEN_LOG") {
+    uint32_t evaluated = 0;
+    RAMEN_LOG(logger, DEBUG, "This message should NOT be visible %u\n",
+              ++evaluated);
+
+    THEN("Its arguments should not be evaluated") {
+      REQUIRE(evaluated == 0);
+    }
+  }
+
+  GIVEN("Messages below the minimum level of the build") {
+#undef RAMEN_MIN_LOG_LEVEL
+#define RAMEN_MIN_LOG_LEVEL CRITICAL
+    uint32_t evaluated = 0;
+    RAMEN_LOG(logger, ERROR, "This message should NOT be visible %u\n",
+              ++evaluated);
+    bool printed_output = logger._printed_output;
+    RAMEN_LOG(logger, CRITICAL, "This message should be visible %u\n",
+              ++evaluated);
+#undef RAMEN_MIN_LOG_LEVEL
+#define RAMEN_MIN_LOG_LEVEL 1
+
+    THEN("Their arguments should not be evaluated") {
+      REQUIRE_FALSE(printed_output);
+      REQUIRE(evaluated == 1);
+      REQUIRE(logger._printed_output);
+    }
+  }
+}
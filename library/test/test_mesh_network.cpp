@@ -7,4 +7,256 @@ SCENARIO("Initialize Painlessmehs") {
     MeshNetwork network;
 
     network.init(PAINLESSMESH, MESH_NAME, MESH_PASSWORD, MESH_PORT);
-}
\ No newline at end of file
+}
+// Minimal user-defined transport that records what it was asked to send
+class RecordingTransport : public broth::transport::Transport {
+  public:
+    uint32_t node_id = 7;
+    uint32_t node_time = 0;
+    std::list<uint32_t> node_list = {1, 2, 3};
+    std::list<std::pair<uint32_t, string_t>> sent;
+    broth::transport::received_callback_t received_callback;
+    broth::transport::changed_connections_callback_t changed_callback;
+    uint32_t node_list_requests = 0;
+    // Runs in update(), like the callbacks and tasks of a real transport
+    std::function<void()> update_callback;
+    // Makes sendSingle() fail, like a node that is not reachable
+    bool fail_sends = false;
+
+    bool init(string_t mesh_name, string_t mesh_password,
+              Scheduler* scheduler_ptr, uint16_t mesh_port) override {
+        return true;
+    };
+    void update() override {
+        if(this->update_callback) {
+            this->update_callback();
+        }
+    };
+    uint32_t getNodeId() override { return this->node_id; };
+    uint32_t getNodeTime() override { return this->node_time; };
+    std::list<uint32_t> getNodeList(bool include_self) override {
+        ++this->node_list_requests;
+        return this->node_list;
+    };
+    bool sendBroadcast(string_t data) override {
+        this->sent.push_back(std::make_pair(0, data));
+        return true;
+    };
+    bool sendSingle(uint32_t destination_node_id, string_t data) override {
+        if(this->fail_sends) {
+            return false;
+        }
+        this->sent.push_back(std::make_pair(destination_node_id, data));
+        return true;
+    };
+    void onReceive(
+        broth::transport::received_callback_t on_receive) override {
+        this->received_callback = on_receive;
+    };
+    void onChangedConnections(
+        broth::transport::changed_connections_callback_t on_changed) override {
+        this->changed_callback = on_changed;
+    };
+    void setMeshTime(uint32_t time) override { this->node_time = time; };
+    void incrementMeshTimeBy(uint32_t time) override {
+        this->node_time += time;
+    };
+    void setNodeId(uint32_t node_id) override { this->node_id = node_id; };
+    void addNeighbourNode(broth::transport::Transport& neighbour_node)
+        override {};
+    void checkForNewMessages() override {};
+    std::list<std::pair<uint32_t, string_t>>& getMessageBuffer() override {
+        return this->sent;
+    };
+};
+
+SCENARIO("Run the mesh network on a user-defined transport") {
+    using namespace broth::meshnetwork;
+    RecordingTransport transport;
+    MeshNetwork network;
+
+    network.setTransport(&transport);
+    REQUIRE(network.init(MESH_NAME, MESH_PASSWORD, MESH_PORT, CRITICAL));
+
+    THEN("The calls should be forwarded to the transport") {
+        REQUIRE(network.getNodeId() == 7);
+        REQUIRE(network.getNodeList().size() == 3);
+
+        network.sendMessageToNode(2, "single");
+        network.sendBroadcast("broadcast");
+        REQUIRE(transport.sent.size() == 2);
+        REQUIRE(transport.sent.front().first == 2);
+        REQUIRE(transport.sent.back().second == "broadcast");
+    }
+
+    THEN("The received messages should reach the callback") {
+        uint32_t received_from = 0;
+        network.onReceiveCallback(
+            [&](uint32_t from, string_t& data) { received_from = from; });
+
+        string_t data = "data";
+        transport.received_callback(3, data);
+        REQUIRE(received_from == 3);
+    }
+
+    THEN("The nodes should be directly connected without a known topology") {
+        REQUIRE(network.getAverageHopCount() == 1);
+    }
+
+    THEN("The node list should only be copied after the connections change") {
+        uint32_t generation = network.getNodeListGeneration();
+        network.getNodeList();
+        network.getNodeList(true);
+        REQUIRE(transport.node_list_requests == 1);
+        REQUIRE(network.getNodeList(true).size() == 4);
+
+        // Changed connections with the same nodes keep the generation
+        transport.changed_callback();
+        REQUIRE(network.getNodeList().size() == 3);
+        REQUIRE(transport.node_list_requests == 2);
+        REQUIRE(network.getNodeListGeneration() == generation);
+
+        transport.node_list.push_back(4);
+        transport.changed_callback();
+        REQUIRE(network.getNodeList().size() == 4);
+        REQUIRE(network.getNodeList().back() == 4);
+        REQUIRE(network.getNodeListGeneration() == generation + 1);
+    }
+
+    THEN("Messages sent to the same node while updating should share a packet") {
+        std::list<std::pair<uint32_t, string_t>> received;
+        network.onReceiveCallback([&](uint32_t from, string_t& data) {
+            received.push_back(std::make_pair(from, data));
+        });
+
+        transport.update_callback = [&]() {
+            network.sendMessageToNode(2, "{\"first\":1}");
+            network.sendMessageToNode(3, "{\"other\":3}");
+            network.sendMessageToNode(2, "{\"second\":2}");
+        };
+        network.update();
+
+        // The single message to 3 goes out as it is
+        REQUIRE(transport.sent.size() == 2);
+        auto packet = transport.sent.front();
+        REQUIRE(packet.first == 2);
+        REQUIRE(packet.second == "#11:{\"first\":1}12:{\"second\":2}");
+        REQUIRE(transport.sent.back().second == "{\"other\":3}");
+
+        transport.received_callback(2, packet.second);
+        REQUIRE(received.size() == 2);
+        REQUIRE(received.front().second == "{\"first\":1}");
+        REQUIRE(received.back().second == "{\"second\":2}");
+
+        string_t malformed = "#20:{}";
+        transport.received_callback(2, malformed);
+        REQUIRE(received.size() == 2);
+    }
+
+    THEN("Packets should not grow beyond the size limit") {
+        string_t message(MESSAGE_COALESCING_MAX_SIZE / 2, 'a');
+
+        transport.update_callback = [&]() {
+            for(int i = 0; i < 3; ++i) {
+                network.sendMessageToNode(2, message);
+            }
+        };
+        network.update();
+
+        REQUIRE(transport.sent.size() == 3);
+        REQUIRE(transport.sent.front().second == message);
+    }
+
+    THEN("Messages sent outside of update should not be held back") {
+        network.sendMessageToNode(2, "now");
+        REQUIRE(transport.sent.size() == 1);
+    }
+
+    THEN("Control messages should be sent before bulk messages") {
+        transport.update_callback = [&]() {
+            network.sendMessageToNode(2, "client", CLIENT);
+            network.sendMessageToNode(3, "replication", REPLICATION);
+            network.sendMessageToNode(4, "control");
+        };
+        network.update();
+
+        REQUIRE(transport.sent.size() == 3);
+        auto it = transport.sent.begin();
+        REQUIRE((it++)->second == "control");
+        REQUIRE((it++)->second == "replication");
+        REQUIRE((it++)->second == "client");
+    }
+
+    THEN("Client messages over the budget should wait for a later update") {
+        string_t data(CLIENT_MESSAGE_BURST / 2, 'a');
+
+        // Spend the budget
+        string_t burst(CLIENT_MESSAGE_BURST, 'b');
+        network.sendMessageToNode(2, burst, CLIENT);
+        REQUIRE(transport.sent.size() == 1);
+
+        transport.update_callback = [&]() {
+            for(int i = 0; i < 2; ++i) {
+                network.sendMessageToNode(2, data, CLIENT);
+            }
+            network.sendMessageToNode(3, "vote");
+        };
+        network.update();
+
+        // Only the vote is not held back
+        REQUIRE(transport.sent.size() == 2);
+        REQUIRE(transport.sent.back().second == "vote");
+
+        // Half a burst later the next message fits in the budget
+        transport.update_callback = NULL;
+        transport.node_time += 1000000 * (CLIENT_MESSAGE_BURST / 2) /
+                               CLIENT_MESSAGE_RATE;
+        network.update();
+        REQUIRE(transport.sent.size() == 3);
+        REQUIRE(network.hasQueuedMessages());
+    }
+
+    THEN("Messages should be refused once their queue is full") {
+        string_t data(SEND_QUEUE_MAX_SIZE / 2, 'a');
+
+        // Spend the budget, so that the client messages stay queued
+        string_t burst(CLIENT_MESSAGE_BURST, 'b');
+        REQUIRE(network.sendMessageToNode(2, burst, CLIENT));
+
+        REQUIRE(network.sendMessageToNode(2, data, CLIENT));
+        REQUIRE(network.sendMessageToNode(2, data, CLIENT));
+        REQUIRE_FALSE(network.sendMessageToNode(2, data, CLIENT));
+
+        // The other queues are not affected
+        REQUIRE(network.sendMessageToNode(2, data, REPLICATION));
+        REQUIRE(network.sendMessageToNode(2, "vote"));
+
+        // Sending the queued messages makes room again
+        transport.node_time += 1000000 * CLIENT_MESSAGE_BURST /
+                               CLIENT_MESSAGE_RATE;
+        network.update();
+        REQUIRE(network.sendMessageToNode(2, data, CLIENT));
+    }
+
+    THEN("Failures of queued messages should be reported") {
+        uint32_t failed_messages = 0;
+        network.onSendFailure([&](uint32_t destination, uint32_t messages) {
+            REQUIRE(destination == 2);
+            failed_messages += messages;
+        });
+
+        transport.fail_sends = true;
+
+        // The direct send reports the failure to the caller instead
+        REQUIRE_FALSE(network.sendMessageToNode(2, "vote"));
+        REQUIRE(network.sendMessageToNode(2, "entry", REPLICATION));
+        REQUIRE(failed_messages == 1);
+
+        transport.update_callback = [&]() {
+            network.sendMessageToNode(2, "{\"first\":1}");
+            network.sendMessageToNode(2, "{\"second\":2}");
+        };
+        network.update();
+        REQUIRE(failed_messages == 3);
+    }
+}
@@ -70,13 +70,15 @@ SCENARIO(
       uint32_t previous_log_term = random();
       string_t entries = "test_string_for_entry";
       uint32_t commit_index = random();
+      uint32_t heart_beat_period = random();
 
       // Create the message
       Message message(REQUEST_APPEND_ENTRY, term);
       message.addFields(previous_log_index,
                         previous_log_term,
                         entries,
-                        commit_index);
+                        commit_index,
+                        heart_beat_period);
 
       // Serialize the message
       string_t serialized = message.serialize();
@@ -88,6 +90,7 @@ SCENARIO(
       REQUIRE_THAT(serialized, Contains(PREVIOUS_LOG_TERM_FIELD_KEY));
       REQUIRE_THAT(serialized, Contains(ENTRIES_FIELD_KEY));
       REQUIRE_THAT(serialized, Contains(COMMIT_INDEX_FIELD_KEY));
+      REQUIRE_THAT(serialized, Contains(HEART_BEAT_PERIOD_FIELD_KEY));
 
       // Check for the key values
       REQUIRE_THAT(serialized, Contains(std::to_string(REQUEST_APPEND_ENTRY)));
@@ -96,12 +99,33 @@ SCENARIO(
       REQUIRE_THAT(serialized, Contains(std::to_string(previous_log_term)));
       REQUIRE_THAT(serialized, Contains(entries));
       REQUIRE_THAT(serialized, Contains(std::to_string(commit_index)));
+      REQUIRE_THAT(serialized, Contains(std::to_string(heart_beat_period)));
+    }
+
+    WHEN("REQUEST_APPEND_ENTRY is used with a batch of entries") {
+      string_t first = "first";
+      string_t second = "second";
+      std::vector<std::pair<uint32_t, const string_t*>> entries = {
+          std::make_pair(1, &first), std::make_pair(2, &second)};
+
+      // Create the message
+      Message message(REQUEST_APPEND_ENTRY, term);
+      message.addFields(0, 0, std::move(entries), 0, 0);
+
+      // Serialize the message
+      string_t serialized = message.serialize();
+
+      // Check for the entries with their terms
+      REQUIRE_THAT(serialized,
+                   Contains("\"entries\":[[1,\"first\"],[2,\"second\"]]"));
     }
 
     WHEN("RESPOND_APPEND_ENTRY is used properly") {
       bool success = random() % 2;
       uint32_t match_index = random();
 
+      string_t success_string = success ? "true" : "false";
+
       // Create the message
       Message message(RESPOND_APPEND_ENTRY, term);
       message.addFields(success, match_index);
@@ -118,8 +142,36 @@ SCENARIO(
       // Check for the key values
       REQUIRE_THAT(serialized, Contains(std::to_string(RESPOND_APPEND_ENTRY)));
       REQUIRE_THAT(serialized, Contains(std::to_string(term)));
-      REQUIRE_THAT(serialized, Contains(std::to_string(success)));
+      REQUIRE_THAT(serialized,
+                   Contains("\"" SUCCESS_FIELD_KEY "\":" + success_string));
       REQUIRE_THAT(serialized, Contains(std::to_string(match_index)));
     }
+
+    WHEN("HEALTH is used properly") {
+      HealthSummary health;
+      health.state = 2;
+      health.commit_index = random();
+      health.rpc_latency = random();
+
+      // Create the message
+      Message message(HEALTH, term);
+      message.addFields(health);
+
+      // Serialize the message
+      string_t serialized = message.serialize();
+
+      // Check for JSON keys
+      REQUIRE_THAT(serialized, Contains(STATE_FIELD_KEY));
+      REQUIRE_THAT(serialized, Contains(COMMIT_INDEX_FIELD_KEY));
+      REQUIRE_THAT(serialized, Contains(RPC_LATENCY_FIELD_KEY));
+      REQUIRE_THAT(serialized, Contains(COMMIT_LATENCY_FIELD_KEY));
+
+      // Check for the key values
+      REQUIRE_THAT(serialized, Contains("\"" TYPE_FIELD_KEY "\":8"));
+      REQUIRE_THAT(serialized, Contains(std::to_string(term)));
+      REQUIRE_THAT(serialized, Contains("\"" STATE_FIELD_KEY "\":2"));
+      REQUIRE_THAT(serialized, Contains(std::to_string(health.commit_index)));
+      REQUIRE_THAT(serialized, Contains(std::to_string(health.rpc_latency)));
+    }
   }
 }
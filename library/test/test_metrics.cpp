@@ -0,0 +1,240 @@
+#include <map>
+#include <vector>
+
+#include "catch2/catch.hpp"
+#include "metrics.hpp"
+#include "server.hpp"
+#include "simulator.hpp"
+
+SCENARIO("Test the latency histogram") {
+  using namespace broth::metrics;
+
+  GIVEN("An empty histogram") {
+    Histogram histogram;
+
+    THEN("Its percentiles should be 0") {
+      REQUIRE(histogram.getCount() == 0);
+      REQUIRE(histogram.getMean() == 0);
+      REQUIRE(histogram.getPercentile(50) == 0);
+    }
+  }
+
+  GIVEN("The buckets of the histogram") {
+    THEN("They should double in size") {
+      REQUIRE(Histogram::getBucket(0) == 0);
+      REQUIRE(Histogram::getBucket(1023) == 0);
+      REQUIRE(Histogram::getBucket(1024) == 1);
+      REQUIRE(Histogram::getBucket(2047) == 1);
+      REQUIRE(Histogram::getBucket(2048) == 2);
+      REQUIRE(Histogram::getBucketUpperBound(0) == 1023);
+      REQUIRE(Histogram::getBucketUpperBound(2) == 4095);
+    }
+
+    THEN("The last bucket should hold everything beyond the others") {
+      REQUIRE(Histogram::getBucket(UINT32_MAX) ==
+              METRICS_HISTOGRAM_BUCKETS - 1);
+      REQUIRE(Histogram::getBucketUpperBound(METRICS_HISTOGRAM_BUCKETS - 1) ==
+              UINT32_MAX);
+    }
+  }
+
+  GIVEN("A hundred latencies") {
+    Histogram histogram;
+    for(uint32_t i = 0; i < 90; ++i) {
+      histogram.add(1500);
+    }
+    for(uint32_t i = 0; i < 10; ++i) {
+      histogram.add(100000);
+    }
+
+    THEN("They should be counted") {
+      REQUIRE(histogram.getCount() == 100);
+      REQUIRE(histogram.getMax() == 100000);
+      REQUIRE(histogram.getMean() == 11350);
+      REQUIRE(histogram.getBucketCount(1) == 90);
+    }
+
+    THEN("The percentiles should be the ends of their buckets") {
+      REQUIRE(histogram.getPercentile(50) == 2047);
+      REQUIRE(histogram.getPercentile(90) == 2047);
+      // Capped at the largest value rather than the end of the bucket
+      REQUIRE(histogram.getPercentile(99) == 100000);
+    }
+  }
+}
+
+SCENARIO("Test the metrics") {
+  using namespace broth::metrics;
+  Metrics metrics;
+
+  GIVEN("Sent and received messages") {
+    metrics.countSent(HEART_BEAT, 100);
+    metrics.countSent(HEART_BEAT, 50);
+    metrics.countReceived(REQUEST_VOTE, 30);
+    metrics.countReceived((MessageType) 99, 10);
+
+    THEN("They should be counted by type") {
+      REQUIRE(metrics.getSent(HEART_BEAT) == 2);
+      REQUIRE(metrics.getSent(REQUEST_VOTE) == 0);
+      REQUIRE(metrics.getReceived(REQUEST_VOTE) == 1);
+      REQUIRE(metrics.get(BYTES_SENT) == 150);
+      REQUIRE(metrics.get(BYTES_RECEIVED) == 40);
+    }
+  }
+
+  GIVEN("Entries appended by the leader") {
+    metrics.trackEntry(1, 1000);
+    metrics.trackEntry(2, 2000);
+    metrics.trackEntry(3, 3000);
+
+    WHEN("Some of them are committed") {
+      metrics.commitEntries(2, 5000);
+
+      THEN("Only their latencies should be counted") {
+        REQUIRE(metrics.getCommitLatency().getCount() == 2);
+        REQUIRE(metrics.getCommitLatency().getMax() == 4000);
+      }
+
+      THEN("They should only be counted once") {
+        metrics.commitEntries(3, 6000);
+        REQUIRE(metrics.getCommitLatency().getCount() == 3);
+        REQUIRE(metrics.getCommitLatency().getMax() == 4000);
+      }
+    }
+
+    WHEN("More entries are appended than can be timed") {
+      for(uint32_t i = 0; i < METRICS_TRACKED_ENTRIES; ++i) {
+        metrics.trackEntry(4 + i, 4000);
+      }
+      metrics.commitEntries(100, 10000);
+
+      THEN("The oldest ones should be dropped") {
+        REQUIRE(metrics.getCommitLatency().getCount() ==
+                METRICS_TRACKED_ENTRIES);
+        REQUIRE(metrics.getCommitLatency().getMax() == 6000);
+      }
+    }
+
+    WHEN("They are no longer timed") {
+      metrics.untrackEntries();
+      metrics.commitEntries(3, 5000);
+
+      THEN("Nothing should be counted") {
+        REQUIRE(metrics.getCommitLatency().getCount() == 0);
+      }
+    }
+  }
+}
+
+SCENARIO("Test the metrics of the servers") {
+  GIVEN("Three nodes that commit a few entries and broadcast their health") {
+    using namespace broth::server;
+
+    simulator::Simulator simulation(7);
+
+    std::vector<Server*> nodes = simulation.createNodes(3);
+    simulation.connectAll();
+
+    // The first node collects the health summaries of the others
+    std::map<uint32_t, HealthSummary> summaries;
+    nodes.front()->setHealthCallback(
+        [&summaries](uint32_t sender, HealthSummary& health) {
+          summaries[sender] = health;
+        });
+    for(auto node : nodes) {
+      node->setHealthBroadcastPeriod(1000000);
+    }
+
+    simulation.onWake([](Server* node) {
+      if(node->getState() == LEADER && node->_log.getLogSize() < 3) {
+        node->distribute("data", false);
+      }
+    });
+
+    simulation.start();
+    simulation.runUntil(10000000);
+
+    Server* leader_ptr = simulation.getLeader();
+    REQUIRE(leader_ptr != NULL);
+    MetricsSnapshot leader = leader_ptr->getMetrics();
+    Server* follower_ptr = (leader_ptr == nodes[1]) ? nodes[2] : nodes[1];
+    MetricsSnapshot follower = follower_ptr->getMetrics();
+    uint32_t leader_id = leader_ptr->_id;
+
+    for(auto node : nodes) {
+      delete node;
+    }
+
+    THEN("The leader should have counted its election") {
+      REQUIRE(leader.state == LEADER);
+      REQUIRE(leader.metrics.get(ELECTIONS_WON) >= 1);
+      REQUIRE(leader.metrics.get(ELECTIONS_STARTED) >=
+              leader.metrics.get(ELECTIONS_WON));
+      REQUIRE(leader.metrics.get(TERM_CHANGES) >= 1);
+    }
+
+    THEN("The leader should have timed its append entry requests") {
+      REQUIRE(leader.metrics.getSent(REQUEST_APPEND_ENTRY) > 0);
+      REQUIRE(leader.metrics.getReceived(RESPOND_APPEND_ENTRY) > 0);
+      REQUIRE(leader.metrics.getRpcLatency().getCount() > 0);
+      REQUIRE(leader.metrics.get(BYTES_SENT) > 0);
+    }
+
+    THEN("The leader should have timed the commits of its entries") {
+      REQUIRE(leader.log_size == 3);
+      REQUIRE(leader.commit_index == 3);
+      REQUIRE(leader.commit_lag == 0);
+      REQUIRE(leader.metrics.get(ENTRIES_APPENDED) == 3);
+      REQUIRE(leader.metrics.get(ENTRIES_COMMITTED) == 3);
+      REQUIRE(leader.metrics.getCommitLatency().getCount() == 3);
+    }
+
+    THEN("The followers should have counted the commits without timing them") {
+      REQUIRE(follower.metrics.get(ENTRIES_COMMITTED) == 3);
+      REQUIRE(follower.metrics.getCommitLatency().getCount() == 0);
+      REQUIRE(follower.metrics.getReceived(HEALTH) > 0);
+    }
+
+    THEN("The health summaries should reach the first node") {
+      REQUIRE(summaries.size() == 2);
+      if(leader_id != 1) {
+        REQUIRE(summaries[leader_id].state == LEADER);
+        REQUIRE(summaries[leader_id].commit_index == 3);
+        REQUIRE(summaries[leader_id].rpc_latency > 0);
+      }
+    }
+  }
+}
+
+SCENARIO("Test the metrics of a single server") {
+  GIVEN("A node") {
+    using namespace broth::server;
+    Server server;
+    simulator::initNode(server, 1);
+
+    WHEN("It receives a message that is not JSON") {
+      string_t data = "{\"type\":2,\"term\":";
+      server.receiveData(2, data);
+
+      THEN("It should count and trace the message instead of routing it") {
+        REQUIRE(server._metrics.get(MALFORMED_MESSAGES) == 1);
+        REQUIRE(server._metrics.getReceived(REQUEST_APPEND_ENTRY) == 0);
+        Trace& trace = server.getTrace();
+        REQUIRE(trace.getEvent(trace.getSize() - 1).type ==
+                TRACE_MALFORMED_MESSAGE);
+        REQUIRE(trace.getEvent(trace.getSize() - 1).args[0] == 2);
+      }
+    }
+
+    WHEN("It is given a very short health broadcast period") {
+      server.setHealthBroadcastPeriod(500);
+
+      THEN("The period should be raised to the shortest one") {
+        REQUIRE(server._health_broadcast_period ==
+                MIN_HEALTH_BROADCAST_PERIOD);
+        REQUIRE(server._task_health.getInterval() ==
+                MIN_HEALTH_BROADCAST_PERIOD / 1000);
+      }
+    }
+  }
+}
@@ -0,0 +1,52 @@
+#include "catch2/catch.hpp"
+#include "utils.hpp"
+
+SCENARIO("Test the random number generator") {
+  GIVEN("Two generators with the same seed") {
+    using namespace broth::utils;
+    Random random_1;
+    Random random_2;
+    random_1.seed(7);
+    random_2.seed(7);
+
+    THEN("They should give the same numbers") {
+      for(uint32_t i = 0; i < 100; ++i) {
+        REQUIRE(random_1.next() == random_2.next());
+      }
+    }
+
+    WHEN("One of them is seeded with the next seed") {
+      random_2.seed(8);
+
+      THEN("It should give different numbers") {
+        uint32_t same = 0;
+        for(uint32_t i = 0; i < 100; ++i) {
+          same += (random_1.next() == random_2.next()) ? 1 : 0;
+        }
+
+        REQUIRE(same == 0);
+      }
+    }
+
+    THEN("The numbers should be spread evenly") {
+      uint32_t counts[4] = {};
+      for(uint32_t i = 0; i < 4000; ++i) {
+        ++counts[random_1.next() % 4];
+      }
+
+      for(auto count : counts) {
+        REQUIRE(count > 900);
+        REQUIRE(count < 1100);
+      }
+    }
+  }
+
+  GIVEN("A generator whose seed maps to a zero state") {
+    broth::utils::Random random;
+    random.seed(0x9E3779B9);
+
+    THEN("It should not get stuck at zero") {
+      REQUIRE(random.next() != 0);
+    }
+  }
+}
@@ -0,0 +1,38 @@
+#include "catch2/catch.hpp"
+#include "utils.hpp"
+
+SCENARIO("Test replication window") {
+  GIVEN("A new window") {
+    using namespace broth::utils;
+    ReplicationWindow window;
+
+    REQUIRE(window.getSize() == INITIAL_REPLICATION_WINDOW);
+
+    WHEN("Requests keep being acknowledged") {
+      window.increase();
+
+      THEN("The window should grow additively up to the maximum") {
+        REQUIRE(window.getSize() ==
+                INITIAL_REPLICATION_WINDOW + REPLICATION_WINDOW_INCREASE);
+
+        for(uint32_t i = 0; i < 100; i++) {
+          window.increase();
+        }
+        REQUIRE(window.getSize() == MAX_REPLICATION_WINDOW);
+      }
+    }
+
+    WHEN("Requests fail") {
+      window.decrease();
+
+      THEN("The window should be halved down to the minimum") {
+        REQUIRE(window.getSize() == INITIAL_REPLICATION_WINDOW / 2);
+
+        for(uint32_t i = 0; i < 100; i++) {
+          window.decrease();
+        }
+        REQUIRE(window.getSize() == MIN_REPLICATION_WINDOW);
+      }
+    }
+  }
+}
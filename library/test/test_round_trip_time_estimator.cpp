@@ -0,0 +1,48 @@
+#include "catch2/catch.hpp"
+#include "utils.hpp"
+
+SCENARIO("Test round trip time estimator") {
+  GIVEN("An estimator without any samples") {
+    using namespace broth::utils;
+    RoundTripTimeEstimator estimator;
+
+    REQUIRE_FALSE(estimator.hasSamples());
+
+    WHEN("The first sample is added") {
+      estimator.addSample(1000);
+
+      THEN("The smoothed round trip time should be the sample itself") {
+        REQUIRE(estimator.hasSamples());
+        REQUIRE(estimator.getSmoothedRtt() == 1000);
+        REQUIRE(estimator.getRttVariation() == 500);
+        REQUIRE(estimator.getTimeout() == 3000);
+      }
+    }
+
+    WHEN("The same sample is added many times") {
+      for(uint32_t i = 0; i < 100; i++) {
+        estimator.addSample(1000);
+      }
+
+      THEN("The variation should vanish") {
+        REQUIRE(estimator.getSmoothedRtt() == 1000);
+        REQUIRE(estimator.getRttVariation() < 10);
+        REQUIRE(estimator.getTimeout() < 1040);
+      }
+    }
+
+    WHEN("A late sample follows stable samples") {
+      for(uint32_t i = 0; i < 100; i++) {
+        estimator.addSample(1000);
+      }
+      uint32_t timeout = estimator.getTimeout();
+      estimator.addSample(9000);
+
+      THEN("The timeout should grow faster than the smoothed round trip") {
+        REQUIRE(estimator.getSmoothedRtt() == 2000);
+        REQUIRE(estimator.getTimeout() - timeout >
+                estimator.getSmoothedRtt() - 1000);
+      }
+    }
+  }
+}
@@ -2,6 +2,7 @@
 
 #include "catch2/catch.hpp"
 #include "server.hpp"
+#include "simulator.hpp"
 
 using Catch::Matchers::Contains;
 
@@ -33,3 +34,32 @@ SCENARIO("Test server's switch state") {
     }
   }
 }
+
+SCENARIO("Test a leader without followers") {
+  GIVEN("A node that is the leader of itself") {
+    using namespace broth::server;
+    Server server;
+    simulator::initNode(server, 1);
+    server.switchState(LEADER);
+
+    WHEN("It appends entries to its own log") {
+      server.distribute("a", false);
+      server.distribute("b", false);
+      server.sendLocalQueueDataToLeaderQueue();
+
+      THEN("It should commit them right away") {
+        REQUIRE(server._log.getLogSize() == 2);
+        REQUIRE(server._commit_index == 2);
+      }
+    }
+
+    WHEN("It is given more data than fits in a replication window") {
+      string_t data(MAX_REPLICATION_WINDOW, 'a');
+
+      THEN("It should refuse the data") {
+        REQUIRE_FALSE(server.distribute(data, false));
+        REQUIRE(server._data_queue.checkEmpty());
+      }
+    }
+  }
+}
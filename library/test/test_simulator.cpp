@@ -0,0 +1,393 @@
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "catch2/catch.hpp"
+#include "server.hpp"
+#include "simulator.hpp"
+#include "workload.hpp"
+
+/**
+ * Run three nodes for five simulated seconds with the given seed, and return
+ * the ID of the leader, 0 if there is none
+ */
+static uint32_t electLeader(uint32_t seed, uint64_t& processed_events) {
+  using namespace broth::server;
+
+  simulator::Simulator simulation(seed);
+  simulation.setLinkDelay(1000, 5000);
+
+  std::vector<Server*> nodes = simulation.createNodes(3);
+  simulation.connectAll();
+
+  simulation.start();
+  simulation.runUntil(5000000);
+  processed_events = simulation.getProcessedEvents();
+
+  uint32_t leader = 0;
+  for(auto node : nodes) {
+    if(node->getState() == LEADER) {
+      leader = node->_id;
+    }
+    delete node;
+  }
+
+  return leader;
+}
+
+SCENARIO("Test the discrete-event simulator") {
+  GIVEN("Three nodes on the simulated mesh") {
+    uint64_t processed_events = 0;
+    uint32_t leader = electLeader(42, processed_events);
+
+    THEN("A leader should be elected") {
+      REQUIRE(leader != 0);
+    }
+
+    THEN("The nodes should only wake up when they have work to do") {
+      // A busy loop would take five million iterations of every node
+      REQUIRE(processed_events < 10000);
+    }
+
+    THEN("The same seed should give the same run") {
+      uint64_t processed_events_again = 0;
+
+      REQUIRE(electLeader(42, processed_events_again) == leader);
+      REQUIRE(processed_events_again == processed_events);
+    }
+  }
+}
+
+/**
+ * Count the nodes that are leaders and not crashed
+ */
+static uint32_t countLeaders(simulator::Simulator& simulation,
+                             std::vector<broth::server::Server*>& nodes) {
+  uint32_t leaders = 0;
+  for(auto node : nodes) {
+    if(!simulation.isCrashed(node->_id) &&
+       node->getState() == broth::server::LEADER) {
+      ++leaders;
+    }
+  }
+
+  return leaders;
+}
+
+SCENARIO("Test faults on the simulated mesh") {
+  GIVEN("Five nodes that elected a leader") {
+    using namespace broth::server;
+
+    simulator::Simulator simulation(7);
+    simulation.setLinkDelay(1000, 5000);
+
+    std::vector<Server*> nodes = simulation.createNodes(5);
+    simulation.connectAll();
+
+    simulation.start();
+    simulation.runUntil(5000000);
+
+    Server* leader = simulation.getLeader();
+    REQUIRE(leader != NULL);
+
+    WHEN("The leader crashes") {
+      simulation.crash(leader->_id);
+      simulation.runUntil(15000000);
+
+      THEN("Another node should become the leader") {
+        Server* new_leader = simulation.getLeader();
+
+        REQUIRE(new_leader != NULL);
+        REQUIRE(new_leader != leader);
+      }
+
+      THEN("The old leader should come back as a follower") {
+        simulation.restart(leader->_id);
+
+        REQUIRE(leader->getState() == FOLLOWER);
+        REQUIRE(leader->_log.getLogSize() == 0);
+
+        simulation.runUntil(20000000);
+
+        REQUIRE(countLeaders(simulation, nodes) == 1);
+        REQUIRE(leader->_term == simulation.getLeader()->_term);
+      }
+    }
+
+    WHEN("The leader is partitioned away with one follower") {
+      uint32_t follower = leader->_id == 1 ? 2 : 1;
+      std::vector<uint32_t> minority = {leader->_id, follower};
+      simulation.partition({minority});
+      simulation.runUntil(15000000);
+
+      THEN("The majority should elect a leader of its own") {
+        REQUIRE(countLeaders(simulation, nodes) == 2);
+      }
+
+      THEN("A single leader should remain after healing") {
+        simulation.heal();
+        simulation.runUntil(25000000);
+
+        REQUIRE(countLeaders(simulation, nodes) == 1);
+        REQUIRE(simulation.getLeader() != leader);
+        REQUIRE(simulation.getStatistics().dropped > 0);
+      }
+    }
+
+    WHEN("The links lose, duplicate and reorder messages") {
+      simulator::LinkModel& link = simulation.getDefaultLink();
+      link.loss_rate = 0.2;
+      link.duplicate_rate = 0.2;
+      link.reorder_rate = 0.2;
+
+      for(uint32_t i = 0; i < 5; ++i) {
+        leader->distribute(std::to_string(i), false);
+      }
+      simulation.runUntil(25000000);
+
+      THEN("Every node should still commit the entries") {
+        simulator::LinkStatistics statistics =
+            simulation.getStatistics();
+
+        REQUIRE(statistics.lost > 0);
+        REQUIRE(statistics.duplicated > 0);
+        REQUIRE(statistics.reordered > 0);
+        for(auto node : nodes) {
+          REQUIRE(node->_commit_index == 5);
+        }
+      }
+    }
+
+    WHEN("A scenario file is loaded") {
+      const char* path = "simulator_scenario.txt";
+      std::ofstream file(path);
+      file << "# Cut the leader off, then let it back\n"
+           << "6 partition " << leader->_id << "\n"
+           << "\n"
+           << "16 heal\n"
+           << "20 crash leader  # and once more\n"
+           << "30 restart all\n";
+      file.close();
+
+      std::string error;
+      REQUIRE(simulation.loadScenario(path, error));
+      std::remove(path);
+
+      THEN("Its events should run at their times") {
+        simulation.runUntil(15000000);
+
+        REQUIRE(countLeaders(simulation, nodes) == 2);
+
+        simulation.runUntil(19000000);
+        Server* new_leader = simulation.getLeader();
+
+        REQUIRE(new_leader != NULL);
+        REQUIRE(new_leader != leader);
+
+        simulation.runUntil(21000000);
+
+        REQUIRE(simulation.isCrashed(new_leader->_id));
+
+        simulation.runUntil(40000000);
+
+        REQUIRE_FALSE(simulation.isCrashed(new_leader->_id));
+        REQUIRE(countLeaders(simulation, nodes) == 1);
+      }
+    }
+
+    WHEN("A scenario file is malformed") {
+      const char* path = "simulator_scenario.txt";
+      std::ofstream file(path);
+      file << "1 heal\n"
+           << "2 explode 3\n";
+      file.close();
+
+      std::string error;
+      bool loaded = simulation.loadScenario(path, error);
+      std::remove(path);
+
+      THEN("It should be refused with the line of the error") {
+        REQUIRE_FALSE(loaded);
+        REQUIRE(error.find("line 2") != std::string::npos);
+      }
+    }
+
+    for(auto node : nodes) {
+      delete node;
+    }
+  }
+}
+
+/**
+ * Run five nodes with lossy links and a crashed leader on the given number of
+ * threads, and describe the state of every node at the end, followed by the
+ * events of the run
+ */
+static std::string runCluster(uint32_t seed,
+                              uint32_t workers,
+                              uint32_t& lowest_commit_index) {
+  using namespace broth::server;
+
+  std::string events_path =
+      "simulator_events_" + std::to_string(workers) + ".jsonl";
+  simulator::EventSink sink;
+  REQUIRE(sink.open(events_path));
+
+  simulator::Simulator simulation(seed);
+  simulation.setWorkers(workers);
+  simulation.setEventSink(&sink);
+  simulation.getDefaultLink().loss_rate = 0.1;
+  simulation.getDefaultLink().reorder_rate = 0.1;
+
+  std::vector<Server*> nodes = simulation.createNodes(5);
+  simulation.connectAll();
+
+  // Every leader gets a few entries, on its own thread
+  simulation.onWake([](Server* node) {
+    if(node->getState() == LEADER && node->_log.getLogSize() < 5) {
+      node->distribute(std::to_string(node->_log.getLogSize()), false);
+    }
+  });
+  simulation.schedule(8000000, [&simulation]() {
+    simulation.crash(simulation.getLeader()->_id);
+  });
+  simulation.schedule(20000000, [&simulation]() {
+    simulation.recordMetrics();
+  });
+
+  simulation.start();
+  simulation.runUntil(20000000);
+
+  std::string description = std::to_string(simulation.getProcessedEvents());
+  lowest_commit_index = nodes.front()->_commit_index;
+  for(auto node : nodes) {
+    lowest_commit_index = std::min(lowest_commit_index, node->_commit_index);
+    description += " " + std::to_string(node->_id) + ":" +
+                   std::to_string(node->getState()) + ":" +
+                   std::to_string(node->_term) + ":" +
+                   std::to_string(node->_commit_index);
+    delete node;
+  }
+
+  sink._file.close();
+  std::ifstream events_file(events_path);
+  std::string line;
+  while(std::getline(events_file, line)) {
+    description += "\n" + line;
+  }
+  events_file.close();
+  std::remove(events_path.c_str());
+
+  return description;
+}
+
+SCENARIO("Test the parallel simulation") {
+  GIVEN("The same cluster run on one and on four threads") {
+    uint32_t lowest_commit_index = 0;
+    std::string serial = runCluster(3, 1, lowest_commit_index);
+    std::string parallel = runCluster(3, 4, lowest_commit_index);
+
+    THEN("Both runs should give the same result") {
+      REQUIRE(parallel == serial);
+    }
+
+    THEN("Every node should commit the entries") {
+      REQUIRE(lowest_commit_index == 5);
+    }
+
+    THEN("The events should tell what happened") {
+      REQUIRE_THAT(serial,
+                   Catch::Contains("\"event\":\"election\",\"result\":"
+                                   "\"won\",\"term\":1}"));
+      REQUIRE_THAT(serial, Catch::Contains("\"event\":\"crash\"}"));
+      REQUIRE_THAT(serial,
+                   Catch::Contains("\"event\":\"commit\",\"index\":5}"));
+      REQUIRE_THAT(serial, Catch::Contains("{\"time\":20000000,\"node\":5,"
+                                           "\"event\":\"messages\""));
+    }
+  }
+}
+
+SCENARIO("Test the write workload") {
+  GIVEN("Three nodes that write in a closed loop") {
+    using namespace broth::server;
+
+    simulator::Simulator simulation(5);
+
+    std::vector<Server*> nodes = simulation.createNodes(3);
+    simulation.connectAll();
+
+    simulator::WorkloadOptions options;
+    options.outstanding = 2;
+    options.start_time = 5000000;
+    options.end_time = 8000000;
+    options.timeout = 2000000;
+    simulator::Workload workload(options);
+    workload.attach(simulation, 5);
+
+    simulation.start();
+    simulation.runUntil(options.end_time + options.timeout);
+    workload.finish();
+
+    uint32_t commit_index = nodes.front()->_commit_index;
+    for(auto node : nodes) {
+      delete node;
+    }
+
+    THEN("Every write should either commit or fail") {
+      REQUIRE(workload.getCommitted() > 0);
+      REQUIRE(workload.getIssued() ==
+              workload.getCommitted() + workload.getFailed());
+      REQUIRE(commit_index >= workload.getCommitted());
+    }
+
+    THEN("The commits should be counted in every period") {
+      std::vector<uint64_t> commits = workload.getCommitsPerPeriod();
+      REQUIRE(commits.size() == 3);
+      REQUIRE(commits[0] > 0);
+      REQUIRE(commits[2] > 0);
+    }
+
+    THEN("The latencies should add up to the percentiles") {
+      std::vector<uint64_t> latencies = workload.getLatencies();
+      simulator::LatencySummary summary =
+          simulator::Workload::summarize(latencies);
+
+      REQUIRE(summary.count == workload.getCommitted());
+      REQUIRE(summary.min > 0);
+      REQUIRE(summary.min <= summary.p50);
+      REQUIRE(summary.p50 <= summary.p99);
+      REQUIRE(summary.p99 <= summary.p999);
+      REQUIRE(summary.p999 <= summary.max);
+
+      uint64_t counted = 0;
+      for(auto& bucket : simulator::Workload::getHistogram(latencies)) {
+        counted += bucket.second;
+      }
+      REQUIRE(counted == summary.count);
+    }
+  }
+
+  GIVEN("Known latencies") {
+    std::vector<uint64_t> latencies;
+    for(uint64_t latency = 1; latency <= 1000; ++latency) {
+      latencies.push_back(latency * 100);
+    }
+
+    THEN("The percentiles should be the nearest ranks") {
+      REQUIRE(simulator::Workload::getPercentile(latencies, 50) == 50000);
+      REQUIRE(simulator::Workload::getPercentile(latencies, 99) == 99000);
+      REQUIRE(simulator::Workload::getPercentile(latencies, 99.9) == 99900);
+      REQUIRE(simulator::Workload::getPercentile({}, 50) == 0);
+    }
+
+    THEN("The histogram buckets should double from a millisecond") {
+      auto histogram = simulator::Workload::getHistogram(latencies);
+
+      REQUIRE(histogram.size() == 8);
+      REQUIRE(histogram[0] == std::make_pair((uint64_t) 1000, (uint64_t) 10));
+      REQUIRE(histogram[7].first == 128000);
+    }
+  }
+}
@@ -0,0 +1,48 @@
+#include "catch2/catch.hpp"
+#include "utils.hpp"
+
+SCENARIO("Test token bucket") {
+  GIVEN("A bucket of 1000 tokens per second that holds 100 tokens") {
+    using namespace broth::utils;
+    TokenBucket bucket;
+    bucket.init(1000, 100);
+
+    THEN("It should start full") {
+      REQUIRE(bucket.getTokens(0) == 100);
+    }
+
+    WHEN("The tokens are used up") {
+      REQUIRE(bucket.consume(60, 0));
+      REQUIRE_FALSE(bucket.consume(60, 0));
+      REQUIRE(bucket.consume(40, 0));
+
+      THEN("They should come back at the given rate") {
+        // 10 milliseconds are worth 10 tokens
+        REQUIRE_FALSE(bucket.consume(20, 10000));
+        REQUIRE(bucket.consume(20, 20000));
+      }
+
+      THEN("The bucket should not hold more than its capacity") {
+        REQUIRE(bucket.getTokens(10000000) == 100);
+      }
+    }
+
+    WHEN("More than the capacity is taken from a full bucket") {
+      REQUIRE(bucket.consume(300, 0));
+
+      THEN("It should be paid back first") {
+        REQUIRE(bucket.getTokens(0) == -200);
+        REQUIRE_FALSE(bucket.consume(1, 200000));
+        REQUIRE(bucket.consume(1, 201000));
+      }
+    }
+
+    WHEN("The time wraps around") {
+      REQUIRE(bucket.consume(100, 0xFFFFFFFF - 4999));
+
+      THEN("The elapsed time should still be correct") {
+        REQUIRE(bucket.getTokens(5000) == Approx(10));
+      }
+    }
+  }
+}
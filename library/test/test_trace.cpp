@@ -0,0 +1,130 @@
+#include <algorithm>
+#include <vector>
+
+#include "catch2/catch.hpp"
+#include "server.hpp"
+#include "simulator.hpp"
+#include "trace.hpp"
+
+SCENARIO("Test the trace") {
+  using namespace broth::logger;
+  Trace trace;
+
+  GIVEN("A few events") {
+    trace.record(100, TRACE_STARTED);
+    trace.record(200, TRACE_STATE_CHANGED, 1, 2, 0);
+
+    THEN("They should be kept from the oldest to the newest") {
+      REQUIRE(trace.getSize() == 2);
+      REQUIRE(trace.getEvent(0).type == TRACE_STARTED);
+      REQUIRE(trace.getEvent(1).time == 200);
+      REQUIRE(trace.getEvent(1).args[1] == 2);
+      REQUIRE(trace.getEvent(1).sequence == 1);
+    }
+
+    WHEN("The trace is cleared") {
+      trace.clear();
+
+      THEN("It should be empty") {
+        REQUIRE(trace.getSize() == 0);
+        REQUIRE(trace.getRecorded() == 0);
+      }
+    }
+  }
+
+  GIVEN("More events than the trace can hold") {
+    for(uint32_t i = 0; i < TRACE_SIZE + 10; ++i) {
+      trace.record(i, TRACE_COMMIT_ADVANCED, i);
+    }
+
+    THEN("The oldest ones should be overwritten") {
+      REQUIRE(trace.getSize() == TRACE_SIZE);
+      REQUIRE(trace.getRecorded() == TRACE_SIZE + 10);
+      REQUIRE(trace.getEvent(0).args[0] == 10);
+      REQUIRE(trace.getEvent(TRACE_SIZE - 1).args[0] == TRACE_SIZE + 9);
+    }
+  }
+
+  GIVEN("A serialized trace") {
+    trace.record(0x01020304, TRACE_VOTE_REQUEST, 7, 3, 1);
+    trace.record(5, TRACE_VOTE_RESPONSE, 8, 3, 0);
+
+    uint8_t buffer[256];
+    uint32_t size = trace.serialize(42, buffer, sizeof(buffer));
+
+    THEN("It should start with the header") {
+      REQUIRE(size == trace.getSerializedSize());
+      REQUIRE(size == 16 + 2 * 20);
+      REQUIRE(string_t((char*) buffer, 4) == "RTRC");
+      REQUIRE(buffer[6] == 2);
+      REQUIRE(buffer[8] == 42);
+    }
+
+    THEN("The events should follow in little endian") {
+      REQUIRE(buffer[16] == 0x04);
+      REQUIRE(buffer[19] == 0x01);
+      REQUIRE(buffer[20] == TRACE_VOTE_REQUEST);
+      REQUIRE(buffer[24] == 7);
+      REQUIRE(buffer[36] == 5);
+      REQUIRE(buffer[42] == 1);
+    }
+
+    THEN("A small buffer should only take the oldest events that fit") {
+      REQUIRE(trace.serialize(42, buffer, 50) == 16 + 20);
+      REQUIRE(buffer[6] == 1);
+      REQUIRE(trace.serialize(42, buffer, 10) == 0);
+    }
+  }
+}
+
+SCENARIO("Test the trace of the servers") {
+  GIVEN("Three nodes that elect a leader and commit an entry") {
+    using namespace broth::server;
+
+    simulator::Simulator simulation(11);
+
+    std::vector<Server*> nodes = simulation.createNodes(3);
+    simulation.connectAll();
+
+    simulation.onWake([](Server* node) {
+      if(node->getState() == LEADER && node->_log.getLogSize() < 1) {
+        node->distribute("data", false);
+      }
+    });
+
+    simulation.start();
+    simulation.runUntil(5000000);
+
+    Server* leader_ptr = simulation.getLeader();
+    REQUIRE(leader_ptr != NULL);
+
+    // Only the newest events are kept
+    std::vector<uint32_t> types;
+    bool became_leader = false;
+    Trace& trace = leader_ptr->getTrace();
+    for(uint32_t i = 0; i < trace.getSize(); ++i) {
+      TraceEvent& event = trace.getEvent(i);
+      types.push_back(event.type);
+      if(event.type == TRACE_STATE_CHANGED && event.args[0] == LEADER) {
+        became_leader = true;
+      }
+    }
+    uint32_t recorded = trace.getRecorded();
+    uint32_t size = trace.getSize();
+
+    for(auto node : nodes) {
+      delete node;
+    }
+
+    THEN("The leader should have traced its election and the responses") {
+      REQUIRE(recorded > 0);
+      REQUIRE(std::count(types.begin(),
+                         types.end(),
+                         TRACE_APPEND_ENTRIES_RESPONSE) > 0);
+      if(recorded == size) {
+        REQUIRE(types.front() == TRACE_STARTED);
+        REQUIRE(became_leader);
+      }
+    }
+  }
+}
@@ -0,0 +1,116 @@
+#include <string>
+
+#include "catch2/catch.hpp"
+#include "server.hpp"
+#include "udp_transport.hpp"
+
+// Far from MESH_PORT, so that the tests don't collide with a running
+// virtual_esp
+#define UDP_TEST_BASE_PORT 47000
+
+SCENARIO("Test the UDP transport") {
+  GIVEN("Two transports on the loopback interface") {
+    using namespace broth::transport;
+
+    UdpTransport transport_1(1, {2});
+    UdpTransport transport_2(2, {1});
+
+    REQUIRE(transport_1.init(MESH_NAME, MESH_PASSWORD, NULL, UDP_TEST_BASE_PORT));
+    REQUIRE(transport_2.init(MESH_NAME, MESH_PASSWORD, NULL, UDP_TEST_BASE_PORT));
+
+    std::list<std::pair<uint32_t, string_t>> received;
+    transport_2.onReceive([&](uint32_t from, string_t& data) {
+      received.push_back(std::make_pair(from, data));
+    });
+
+    WHEN("A message is sent to a single node") {
+      REQUIRE(transport_1.sendSingle(2, "single"));
+
+      // Give the loopback interface some time
+      usleep(10000);
+      transport_2.update();
+
+      THEN("It should be received with the sender's ID") {
+        REQUIRE(received.size() == 1);
+        REQUIRE(received.front().first == 1);
+        REQUIRE(received.front().second == "single");
+      }
+    }
+
+    WHEN("A message is broadcasted") {
+      REQUIRE(transport_1.sendBroadcast("broadcast"));
+
+      usleep(10000);
+      transport_2.update();
+
+      THEN("The other node should receive it") {
+        REQUIRE(received.size() == 1);
+        REQUIRE(received.front().second == "broadcast");
+      }
+    }
+
+    WHEN("The port of a node is already taken") {
+      UdpTransport duplicate(2, {1});
+
+      THEN("The initialization should fail") {
+        REQUIRE_FALSE(
+            duplicate.init(MESH_NAME, MESH_PASSWORD, NULL, UDP_TEST_BASE_PORT));
+      }
+    }
+
+    WHEN("The port of a node would be beyond the last port") {
+      UdpTransport wrapping(UINT16_MAX - UDP_TEST_BASE_PORT + 2, {1});
+
+      THEN("The initialization should fail") {
+        REQUIRE_FALSE(
+            wrapping.init(MESH_NAME, MESH_PASSWORD, NULL, UDP_TEST_BASE_PORT));
+        REQUIRE_FALSE(transport_1.sendSingle(UINT16_MAX, "wrapped"));
+      }
+    }
+  }
+}
+
+SCENARIO("Test an election over the UDP transport") {
+  GIVEN("Three servers on their own UDP transports") {
+    using namespace broth::server;
+    using namespace broth::transport;
+
+    UdpTransport transport_1(1, {2, 3});
+    UdpTransport transport_2(2, {1, 3});
+    UdpTransport transport_3(3, {1, 2});
+
+    Server server_1;
+    Server server_2;
+    Server server_3;
+    std::vector<Server*> nodes = {&server_1, &server_2, &server_3};
+
+    server_1.setTransport(&transport_1);
+    server_2.setTransport(&transport_2);
+    server_3.setTransport(&transport_3);
+
+    for(auto node : nodes) {
+      // Elect within a few hundred milliseconds
+      node->_heart_beat_period = MIN_HEART_BEAT_TIMER_PERIOD;
+      node->init(MESH_NAME, MESH_PASSWORD, UDP_TEST_BASE_PORT + 10, CRITICAL);
+    }
+
+    THEN("A single leader should be elected") {
+      uint32_t leaders = 0;
+      uint32_t start = micros();
+
+      while(leaders == 0 && (uint32_t)(micros() - start) < 2000000) {
+        for(auto node : nodes) {
+          node->update();
+        }
+        usleep(100);
+
+        leaders = 0;
+        for(auto node : nodes) {
+          leaders += (node->getState() == LEADER) ? 1 : 0;
+        }
+      }
+
+      REQUIRE(leaders == 1);
+    }
+  }
+}
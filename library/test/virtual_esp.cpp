@@ -1,14 +1,75 @@
+#include <sys/wait.h>
 #include <unistd.h>
 
+#include <ctime>
 #include <cxxopts.hpp>
-#include <thread>
+#include <string>
 #include <vector>
 
 #include "ramen.h"
+#include "ramen/udp_transport.hpp"
+#include "simulator.hpp"
 
 using namespace broth::logger;
 using namespace broth::server;
 using namespace broth::meshnetwork;
+using namespace broth::transport;
+
+/**
+ * Runs a single node over UDP in the current process, in real time. Node 1
+ * distributes the logs, and the leader stops running at the kill time.
+ */
+int runUdpNode(uint32_t node_id,
+               uint32_t number_of_nodes,
+               uint16_t base_port,
+               float duration,
+               uint32_t kill_leader_time,
+               uint32_t number_of_logs) {
+  std::list<uint32_t> node_list;
+  for(uint32_t i = 1; i <= number_of_nodes; ++i) {
+    if(i != node_id) {
+      node_list.push_back(i);
+    }
+  }
+
+  UdpTransport transport(node_id, node_list);
+  Server node;
+  node.setTransport(&transport);
+  node.init(MESH_NAME, MESH_PASSWORD, base_port, broth::logger::DEBUG);
+
+  if(node_id == 1) {
+    for(uint32_t i = 0; i < number_of_logs; ++i) {
+      node.distribute(std::to_string(i), false);
+    }
+  }
+
+  uint32_t start_time = node._mesh.getMeshTime();
+  int kill_flag = (kill_leader_time > 0) ? 1 : 0;
+  while(true) {
+    node.update();
+
+    uint32_t elapsed_time = node._mesh.getMeshTime() - start_time;
+
+    // Only the node that is the leader at the kill time stops
+    if(kill_flag && elapsed_time > kill_leader_time * 1000000) {
+      kill_flag = 0;
+      if(node.getState() == LEADER) {
+        std::cout << "\033[95mJust killed leader " << node._id << " @ "
+                  << node._mesh.getMeshTime() << " mesh time\033[0m\n";
+        break;
+      }
+    }
+
+    if(elapsed_time > duration * 1000000) {
+      break;
+    }
+
+    // Leave the CPU to the other nodes while waiting for messages
+    usleep(100);
+  }
+
+  return 0;
+}
 
 int main(int argc, char** argv) {
   cxxopts::Options options("ramen virtual test network",
@@ -19,8 +80,25 @@ int main(int argc, char** argv) {
     ("t,time", "simulation duration", cxxopts::value<float>()->default_value("10"))
     ("n,nodes", "number of nodes", cxxopts::value<int>()->default_value("3"))
     ("l,log_length", "number of logs to append", cxxopts::value<int>()->default_value("5"))
-    ("r,random", "run nodes in the random order", cxxopts::value<bool>()->default_value("false"))
+    ("r,random", "seed the simulation from the current time", cxxopts::value<bool>()->default_value("false"))
+    ("s,seed", "seed of the simulation", cxxopts::value<int>()->default_value("1"))
+    ("d,delay", "shortest time a message takes in microseconds", cxxopts::value<int>()->default_value("1000"))
+    ("j,jitter", "longest time a message takes on top of the delay in microseconds", cxxopts::value<int>()->default_value("4000"))
+    ("loss", "probability of losing a message", cxxopts::value<double>()->default_value("0"))
+    ("duplicate", "probability of delivering a message twice", cxxopts::value<double>()->default_value("0"))
+    ("reorder", "probability of holding a message back behind later ones", cxxopts::value<double>()->default_value("0"))
+    ("bandwidth", "bytes per second of every link, 0 is unlimited", cxxopts::value<int>()->default_value("0"))
+    ("scenario", "file of scripted partitions, crashes, restarts and link changes", cxxopts::value<std::string>()->default_value(""))
+    ("w,workers", "number of threads to run the nodes on", cxxopts::value<int>()->default_value("1"))
     ("k,kill", "kill the leader at given time", cxxopts::value<int>()->default_value("0"))
+    ("e,events", "write the events of the simulation to the given JSON lines file", cxxopts::value<std::string>()->default_value(""))
+    ("m,metrics_period", "seconds between the message counters in the events file", cxxopts::value<float>()->default_value("1"))
+    ("v,verbose", "print the log of every node and every message", cxxopts::value<bool>()->default_value("false"))
+    ("trace", "print the trace of every node at the end, decode it with simulation/scripts/decode_trace.py", cxxopts::value<bool>()->default_value("false"))
+    ("heap_cap", "stop and fail once a node has more bytes on the heap, 0 is no cap", cxxopts::value<int>()->default_value("0"))
+    ("u,udp", "run every node in its own process, connected over UDP", cxxopts::value<bool>()->default_value("false"))
+    ("i,node_id", "with --udp, only run the node with the given ID (1 to nodes)", cxxopts::value<int>()->default_value("0"))
+    ("p,port", "with --udp, node n listens on port + n", cxxopts::value<int>()->default_value(std::to_string(MESH_PORT)))
     ;
   // clang-format on
 
@@ -31,8 +109,68 @@ int main(int argc, char** argv) {
   uint32_t target_number_of_logs = result["log_length"].as<int>();
   uint32_t kill_leader_time = result["kill"].as<int>();
 
+  if(result["udp"].as<bool>()) {
+    uint32_t node_id = result["node_id"].as<int>();
+    uint16_t base_port = result["port"].as<int>();
+    float duration = result["time"].as<float>();
+
+    if(node_id > 0) {
+      return runUdpNode(node_id,
+                        target_number_of_nodes,
+                        base_port,
+                        duration,
+                        kill_leader_time,
+                        target_number_of_logs);
+    }
+
+    // Run every node in its own process and wait for all of them
+    for(uint32_t i = 1; i <= target_number_of_nodes; ++i) {
+      if(fork() == 0) {
+        return runUdpNode(i,
+                          target_number_of_nodes,
+                          base_port,
+                          duration,
+                          kill_leader_time,
+                          target_number_of_logs);
+      }
+    }
+
+    while(wait(NULL) > 0) {
+    }
+
+    return 0;
+  }
+
   std::vector<Server*> nodes;
 
+  // Printing every message takes most of the time of a large simulation
+  bool verbose = result["verbose"].as<bool>();
+  fake_painlessmesh::printMessages() = verbose;
+
+  // The sink has to outlive the simulation
+  simulator::EventSink sink;
+  std::string events_path = result["events"].as<std::string>();
+  if(!events_path.empty() && !sink.open(events_path)) {
+    std::cerr << "Can't open " << events_path << std::endl;
+    return 1;
+  }
+
+  // The same seed always gives the same run
+  uint32_t seed = random_enabled ? time(NULL) : result["seed"].as<int>();
+  simulator::Simulator simulation(seed);
+  simulation.setWorkers(result["workers"].as<int>());
+  if(!events_path.empty()) {
+    simulation.setEventSink(&sink);
+  }
+
+  simulator::LinkModel& link = simulation.getDefaultLink();
+  link.latency = result["delay"].as<int>();
+  link.jitter = result["jitter"].as<int>();
+  link.loss_rate = result["loss"].as<double>();
+  link.duplicate_rate = result["duplicate"].as<double>();
+  link.reorder_rate = result["reorder"].as<double>();
+  link.bandwidth = result["bandwidth"].as<int>();
+
   std::cout << "\n\033[95m>> Calling broth::server::Server::init() for all "
                "nodes:\033[0m\n";
 
@@ -40,43 +178,43 @@ int main(int argc, char** argv) {
   // Simulates setup() from Arduino //
   ////////////////////////////////////
 
-  // Generate the nodes
-  for(uint32_t i = 0; i < target_number_of_nodes; ++i) {
-    // sleeps for 2 second
-    unsigned int microsecond = 1000000;
-    usleep(2 * microsecond);
+  // Generate the nodes on painlessMesh, start IDs from 1
+  nodes = simulation.createNodes(
+      target_number_of_nodes,
+      verbose ? broth::logger::DEBUG : broth::logger::CRITICAL);
 
-    // Generate node
-    nodes.push_back(new Server());
+  // Create the connections between nodes wihtin the virtual mesh network
+  simulation.connectAll();
+
+  std::string scenario = result["scenario"].as<std::string>();
+  if(!scenario.empty()) {
+    std::string error;
+    if(!simulation.loadScenario(scenario, error)) {
+      std::cerr << "Invalid scenario: " << error << std::endl;
+      return 1;
+    }
+  }
 
-    // Choose painlessMesh for testing
-    nodes.back()->_mesh._selected_mesh_network_type =
-        broth::meshnetwork::PAINLESSMESH;
+  std::cout << "\n\033[95m>> Running with seed " << seed << " on "
+            << result["workers"].as<int>() << " thread(s)\033[0m\n";
 
-    // Set node ID, start IDs from 1
-    nodes.back()->_mesh.setNodeId(i + 1);
+  std::cout << "\033[95m>> Messages take " << result["delay"].as<int>()
+            << " to "
+            << result["delay"].as<int>() + result["jitter"].as<int>()
+            << " microseconds\033[0m\n";
 
-    // Initialize the node
-    nodes.back()->init(MESH_NAME,
-                       MESH_PASSWORD,
-                       MESH_PORT,
-                       broth::logger::DEBUG);
-  }
+  std::cout << "\033[95m>> Links lose " << link.loss_rate << ", duplicate "
+            << link.duplicate_rate << " and reorder " << link.reorder_rate
+            << " of the messages\033[0m\n";
 
-  // Create the connections between nodes wihtin the virtual mesh network
-  for(uint32_t i = 0; i < target_number_of_nodes; ++i) {
-    for(uint32_t j = 0; j < target_number_of_nodes; ++j) {
-      if(nodes[i]->_mesh._node_id != nodes[j]->_mesh._node_id) {
-        // Add neighbour nodes except the node itself
-        nodes[i]->_mesh.addNeighbourNode(nodes[j]->_mesh);
-      }
-    }
+  if(!scenario.empty()) {
+    std::cout << "\033[95m>> Running the scenario in " << scenario
+              << "\033[0m\n";
   }
 
-  if(random_enabled) {
-    std::cout << "\n\033[95m>> Running in randomized mode\033[0m\n";
-  } else {
-    std::cout << "\n\033[95m>> Running in non-randomized mode\033[0m\n";
+  if(!events_path.empty()) {
+    std::cout << "\033[95m>> Writing the events to " << events_path
+              << "\033[0m\n";
   }
 
   if(kill_leader_time > 0) {
@@ -87,7 +225,7 @@ int main(int argc, char** argv) {
   }
 
   std::cout << "\033[95m>> Will append " << target_number_of_logs
-            << " log(s) to the first leader\033[0m\n";
+            << " log(s) to the log of the leader\033[0m\n";
 
   std::cout << "\033[95m>> RAFT_TIMER_PERIOD is " << RAFT_TIMER_PERIOD
             << " \033[0m\n";
@@ -98,102 +236,128 @@ int main(int argc, char** argv) {
   std::cout << "\033[95m>> HEART_BEAT_TIMER_PERIOD is "
             << HEART_BEAT_TIMER_PERIOD << " \033[0m\n";
 
-  std::cout << "\033[95m>> REQUEST_APPEND_ENTRY_PERIOD is "
-            << REQUEST_APPEND_ENTRY_PERIOD << " \033[0m\n";
-
-  std::cout << "\033[95m>> ELECTION_TIMEOUT_FACTOR is "
-            << ELECTION_TIMEOUT_FACTOR << " \033[0m\n";
+  std::cout << "\033[95m>> ELECTION_TIMEOUT_HEART_BEAT_FACTOR is "
+            << ELECTION_TIMEOUT_HEART_BEAT_FACTOR << " \033[0m\n";
 
-  std::cout << "\n\033[95m>> Calling broth::server::Server::update() in a "
-               "loop for all nodes at random order:\033[0m\n";
-
-  uint32_t iteration = 0;
-  bool printed_output = false;
+  std::cout << "\n\033[95m>> Running the nodes when their tasks are due or "
+               "messages arrive:\033[0m\n";
 
   ///////////////////////////////////
   // Simulates loop() from Arduino //
   ///////////////////////////////////
-  int flag = 0;
-  int kill_flag = (kill_leader_time > 0) ? 1 : 0;
-  while(true) {
-    // Shuffle the order
-    if(random_enabled) {
-      std::random_shuffle(nodes.begin(), nodes.end());
+  // Nodes run on several threads, so every leader decides on its own log
+  // how many entries are still missing, whichever thread it runs on
+  simulation.onWake([&](Server* node) {
+    uint32_t log = node->_log.getLogSize() + node->_data_queue.getSize();
+    if(node->_state == LEADER && log < target_number_of_logs) {
+      if(verbose) {
+        std::cout << ">> Pushed data to my beloved leader" << std::endl;
+      }
+      node->distribute(std::to_string(log), false);
     }
 
-    // Kill a leader at given time
-    if(kill_flag) {
-      if(nodes.back()->_mesh.getMeshTime() > (kill_leader_time * 1000000)) {
-        for(auto it = nodes.begin(); it != nodes.end(); ++it) {
-          if((*it)->getState() == LEADER) {
-            uint32_t term = (*it)->_term;
-            (*it)->switchState(FOLLOWER, term);
-            kill_flag = 0;
-            std::cout << "\033[95mJust killed leader " << (*it)->_id << " @ "
-                      << (*it)->_mesh.getMeshTime() << " mesh time\033[0m\n";
-          }
-        }
-      }
+    // Print the event number if anything was outputted to the terminal
+    if(node->_logger._printed_output) {
+      std::cout << "\033[95m^^ event #" << simulation.getProcessedEvents()
+                << " @ " << simulation.getTime() << "\033[0m\n\n";
     }
 
-    // Iterate over the nodes based on the random order
-    for(auto it = nodes.begin(); it != nodes.end(); ++it) {
-      // Call the update() function of the node
-      (*it)->update();
+    // Reset the output flag for the specific node
+    node->_logger._printed_output = false;
+  });
 
-      if((flag < target_number_of_logs) && (*it)->_state == LEADER) {
-        std::cout << ">> Pushed data to my beloved leader" << std::endl;
-        (*it)->distribute(std::to_string(flag), false);
-        flag++;
+  // Kill a leader at given time, it stays down until the end
+  if(kill_leader_time > 0) {
+    simulation.schedule((uint64_t) kill_leader_time * 1000000, [&]() {
+      for(auto node : nodes) {
+        if(node->getState() == LEADER && !simulation.isCrashed(node->_id)) {
+          simulation.crash(node->_id);
+          std::cout << "\033[95mJust killed leader " << node->_id << " @ "
+                    << simulation.getTime() << " mesh time\033[0m\n";
+        }
       }
+    });
+  }
 
-      // Check if anything was outputted
-      printed_output = (printed_output || (*it)->_logger._printed_output);
-
-      // Reset the output flag for the specific node
-      (*it)->_logger._printed_output = false;
+  // Record the message counters periodically and at the end
+  uint64_t end_time = result["time"].as<float>() * 1000000;
+  uint64_t metrics_period = result["metrics_period"].as<float>() * 1000000;
+  if(!events_path.empty() && metrics_period > 0) {
+    for(uint64_t time = metrics_period; time < end_time;
+        time += metrics_period) {
+      simulation.schedule(time, [&]() { simulation.recordMetrics(); });
     }
+  }
+  if(!events_path.empty()) {
+    simulation.schedule(end_time, [&]() { simulation.recordMetrics(); });
+  }
 
-    // Print the iteration number if anything was outputted to the terminal
-    if((printed_output) && (iteration > 0)) {
-      std::cout << "\033[95m^^ loop() iteration #" << iteration
-                << "\033[0m\n\n";
-    }
+  uint32_t heap_cap = result["heap_cap"].as<int>();
+  if(heap_cap > 0) {
+    simulation.setHeapCap(heap_cap);
+    std::cout << "\033[95m>> Stopping once a node has more than " << heap_cap
+              << " bytes on the heap\033[0m\n";
+  }
 
-    // Decide to stop the simulation or not
-    if(nodes.back()->_mesh.getMeshTime() >
-       (result["time"].as<float>() * 1000000)) {
-      break;
+  simulation.start();
+  simulation.runUntil(end_time);
+
+  simulator::LinkStatistics statistics = simulation.getStatistics();
+  std::cout << "\033[95m>> Processed " << simulation.getProcessedEvents()
+            << " events\033[0m\n";
+  std::cout << "\033[95m>> Sent " << statistics.sent << " messages, "
+            << statistics.delivered << " delivered, " << statistics.lost
+            << " lost, " << statistics.duplicated << " duplicated, "
+            << statistics.reordered << " reordered, " << statistics.dropped
+            << " dropped by partitions and crashes\033[0m\n";
+
+  // The node that needed the most memory
+  allocation_tracker::AllocationTracker& tracker =
+      allocation_tracker::AllocationTracker::get();
+  Server* largest_node = nodes.front();
+  for(auto node : nodes) {
+    if(tracker.getUsage(node->_id).peak >
+       tracker.getUsage(largest_node->_id).peak) {
+      largest_node = node;
     }
-
-    printed_output = false;
-    iteration++;
   }
+  allocation_tracker::HeapUsage heap = tracker.getUsage(largest_node->_id);
+  std::cout << "\033[95m>> Node " << largest_node->_id
+            << " peaked at the most heap, " << heap.peak << " bytes, with "
+            << heap.live << " bytes in use at the end:";
+  for(uint32_t i = 0; i < ALLOCATION_TRACKER_SUBSYSTEMS; ++i) {
+    allocation_tracker::Subsystem subsystem = (allocation_tracker::Subsystem) i;
+    std::cout << " " << tracker.getSubsystemName(subsystem) << " "
+              << tracker.getUsage(largest_node->_id, subsystem).live;
+  }
+  std::cout << "\033[0m\n";
 
-  // auto run_node =
-  //     [](uint32_t node_id, std::vector<Server*> nodes, uint32_t target_time)
-  //     {
-  //       while(true) {
-  //         nodes[node_id]->update();
-
-  //         if(nodes[node_id]->_mesh.getMeshTime() > target_time) {
-  //           break;
-  //         }
-  //       }
-  //     };
+  if(result["trace"].as<bool>()) {
+    for(auto node : nodes) {
+      node->dumpTrace();
+    }
+  }
 
-  // std::vector<std::thread> threads;
+  int exit_code = 0;
+  if(simulation.isHeapCapExceeded()) {
+    allocation_tracker::HeapViolation violation =
+        simulation.getHeapViolation();
+    std::cout << "\033[91m>> Node " << violation.node_id
+              << " exceeded the heap cap with " << violation.live << " bytes in "
+              << tracker.getSubsystemName(violation.subsystem) << " @ "
+              << simulation.getTime() << " mesh time\033[0m\n";
+    exit_code = 2;
+  }
 
-  // for(uint32_t i = 0; i < result["nodes"].as<int>(); ++i) {
-  //   threads.push_back(std::thread(run_node,
-  //                                 i,
-  //                                 nodes,
-  //                                 (result["time"].as<float>() * 1000000)));
-  // }
+  if(!events_path.empty()) {
+    sink.flush();
+    std::cout << "\033[95m>> Wrote " << sink.getWrittenRecords()
+              << " events to " << events_path << "\033[0m\n";
+  }
 
-  // for(uint32_t i = 0; i < result["nodes"].as<int>(); ++i) {
-  //   threads[i].join();
-  // }
+  for(auto node : nodes) {
+    delete node;
+  }
 
-  return 0;
-}
\ No newline at end of file
+  return exit_code;
+}
@@ -19,6 +19,12 @@ parser.add_argument(
     help="Runs the library in a simulated environment",
 )
 
+parser.add_argument(
+    "--benchmark",
+    action="store_true",
+    help="Measures the commit throughput and latency in a simulated environment and the cost of the messages and the log, and writes the results to library/benchmark.json and library/micro_benchmark.json",
+)
+
 parser.add_argument(
     "-n",
     type=int,
@@ -147,6 +153,9 @@ class RunDev:
                 self.exit_code()
             self.module_virtual(args.t, args.n, args.r, args.l, args.k)
 
+        elif args.benchmark:
+            self.module_benchmark()
+
         elif args.shell:
             self.module_shell()
 
@@ -283,6 +292,22 @@ class RunDev:
             + "gcovr --delete --root='.' --filter='virtual_esp.*' > /dev/null 2>&1"
         )
 
+    def module_benchmark(self):
+        self.run_command_in_docker(
+            "cd library"
+            + "&&"
+            + "cmake ."
+            + "&&"
+            + "make replication_benchmark micro_benchmark"
+            + "&&"
+            + "./bin/replication_benchmark -f benchmark.json"
+            + "&&"
+            + "./bin/micro_benchmark -f micro_benchmark.json"
+            + "&&"
+            # Delete gcov files related to the benchmarks, we don't want them
+            + "gcovr --delete --root='.' --filter='.*_benchmark.*' > /dev/null 2>&1"
+        )
+
     def module_test(self):
         self.run_command_in_docker(
             "cd library"
@@ -1,5 +1,7 @@
-import re
+import json
+import os
 import subprocess
+import tempfile
 from pprint import pprint
 
 import matplotlib.pyplot as plt
@@ -272,7 +274,7 @@ def election_timeout_test(election_timeouts_to_test, n_nodes):
         for n_run in range(n_run_for_each):
 
             print(
-                f"Running the simulation with {n_nodes} node(s) for {time} second(s) with max election timeout of {election_timeout}"
+                f"Running the simulation with {n_nodes} node(s) for {time} second(s) with election timeout factor of {election_timeout}"
             )
 
             result = run_simulation(
@@ -590,26 +592,15 @@ def avg(lst):
         return sum(lst) / len(lst)
 
 
-def get_node_id(line):
+def read_events(events_path):
     """
-    Parses a line like the following and returns 4 as the node id
+    Reads the events that virtual_esp wrote with --events, one JSON object per
+    line like the following
 
-    [ID:4][DEBUG] Current state: CANDIDATE @ 100001
+    {"time":100001,"node":4,"event":"election","result":"started","term":2}
     """
-    pieces = line.split("[")
-    for piece in pieces:
-        if "ID:" in piece:
-            return piece[3:-1]
-
-
-def get_at_time(line):
-    """
-    Parses a line like the following and returns 100001 as the @ time
-
-    [ID:4][DEBUG] Current state: CANDIDATE @ 100001
-    """
-    pieces = line.split("@")
-    return pieces[1].strip().split(" ")[0].strip()
+    with open(events_path) as events_file:
+        return [json.loads(line) for line in events_file if line.strip()]
 
 
 def run_simulation(
@@ -624,6 +615,9 @@ def run_simulation(
     Runs ramen with given parameters
     """
 
+    events_file, events_path = tempfile.mkstemp(suffix=".jsonl")
+    os.close(events_file)
+
     if define_flag is not None:
         try:
             # Reset the cpp file
@@ -633,7 +627,7 @@ def run_simulation(
             subprocess.check_output(command, shell=True, text=True)
 
             # Run sim
-            command = f"cd ../../library && sed -i '1 i\{define_flag} /\/\ please remove me' test/virtual_esp.cpp && cmake . && make virtual_esp && ./bin/virtual_esp -t {time} -n {n_nodes} -l {n_logs_to_append} -k {kill_leader_at_time}"
+            command = f"cd ../../library && sed -i '1 i\{define_flag} /\/\ please remove me' test/virtual_esp.cpp && cmake . && make virtual_esp && ./bin/virtual_esp -t {time} -n {n_nodes} -l {n_logs_to_append} -k {kill_leader_at_time} -e {events_path}"
             output = subprocess.check_output(command, shell=True, text=True)
 
         finally:
@@ -647,18 +641,18 @@ def run_simulation(
         try:
             # Reset the cpp file
             command = (
-                f"cd ../../library && git checkout HEAD -- src/ramen/server.cpp"
+                f"cd ../../library && git checkout HEAD -- src/ramen/configuration.hpp"
             )
             subprocess.check_output(command, shell=True, text=True)
 
             # Run sim
-            command = f'cd ../../library && sed -i "s/(min_val + (std::rand() % 10)) \* ELECTION_TIMEOUT_FACTOR/(min_val + (std::rand() % {election_max})) \* ELECTION_TIMEOUT_FACTOR/g" src/ramen/server.cpp && cmake . && make virtual_esp && ./bin/virtual_esp -t {time} -n {n_nodes} -l {n_logs_to_append} -k {kill_leader_at_time}'
+            command = f'cd ../../library && sed -i "s/#define ELECTION_TIMEOUT_HEART_BEAT_FACTOR 3/#define ELECTION_TIMEOUT_HEART_BEAT_FACTOR {election_max}/g" src/ramen/configuration.hpp && cmake . && make virtual_esp && ./bin/virtual_esp -t {time} -n {n_nodes} -l {n_logs_to_append} -k {kill_leader_at_time} -e {events_path}'
             output = subprocess.check_output(command, shell=True, text=True)
 
         finally:
             # Reset the cpp file
             command = (
-                f"cd ../../library && git checkout HEAD -- src/ramen/server.cpp"
+                f"cd ../../library && git checkout HEAD -- src/ramen/configuration.hpp"
             )
             subprocess.check_output(command, shell=True, text=True)
 
@@ -676,11 +670,11 @@ def run_simulation(
         subprocess.check_output(command, shell=True, text=True)
 
         # Run sim
-        command = f"cd ../../library && cmake . && make virtual_esp && ./bin/virtual_esp -t {time} -n {n_nodes} -l {n_logs_to_append} -k {kill_leader_at_time}"
+        command = f"cd ../../library && cmake . && make virtual_esp && ./bin/virtual_esp -t {time} -n {n_nodes} -l {n_logs_to_append} -k {kill_leader_at_time} -e {events_path}"
         output = subprocess.check_output(command, shell=True, text=True)
 
-    # Parse the output and get related lines
-    result = re.findall("(.*(?: @ ).*)", output)
+    events = read_events(events_path)
+    os.remove(events_path)
 
     # Initialize the empty dictionary
     all_elections = {}
@@ -689,18 +683,21 @@ def run_simulation(
 
     kill_time = None
     time_to_elect_leader_after_kill = None
-    for line in result:
+    for event in events:
+
+        if event["event"] == "crash":
+            kill_time = event["time"]
+
+        if event["event"] != "election":
+            continue
 
-        if "Just killed leader" in line:
-            kill_time = int(get_at_time(line))
+        node_id = event["node"]
 
         # Fill in election start times
-        if "Started election" in line:
-            node_id = int(get_node_id(line))
-            election_started_at = int(get_at_time(line))
+        if event["result"] == "started":
             all_elections[node_id].append(
                 {
-                    "started_at": election_started_at,
+                    "started_at": event["time"],
                     "lost_at": None,
                     "won_at": None,
                     "election_duration": None,
@@ -709,16 +706,14 @@ def run_simulation(
             )
 
         # Fill in election lost times
-        if "Did not win the election" in line:
-            node_id = int(get_node_id(line))
-            election_lost_at = int(get_at_time(line))
+        if event["result"] == "lost":
+            election_lost_at = event["time"]
 
             last_election_item = all_elections[node_id][-1]
             last_election_item["lost_at"] = election_lost_at
             last_election_item["election_duration"] = (
                 election_lost_at - last_election_item["started_at"]
             )
-            all_elections[node_id][-1] = last_election_item
 
             # Make sure that the data makes sense
             assert (
@@ -726,18 +721,15 @@ def run_simulation(
             )
 
         # Fill in election won times
-        if "Won the election" in line:
-            node_id = int(get_node_id(line))
-            election_won_at = int(get_at_time(line))
+        if event["result"] == "won":
+            election_won_at = event["time"]
 
             last_election_item = all_elections[node_id][-1]
             last_election_item["success"] = True
-            last_election_item["lost_at"] = None
             last_election_item["won_at"] = election_won_at
             last_election_item["election_duration"] = (
                 election_won_at - last_election_item["started_at"]
             )
-            all_elections[node_id][-1] = last_election_item
 
             # Make sure that the data makes sense
             assert (
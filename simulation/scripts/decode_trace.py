@@ -0,0 +1,145 @@
+#!/usr/bin/env python
+
+"""Trace Decoder
+
+This script decodes the binary traces of ramen nodes. To view the input
+arguments execute `python decode_trace.py -h`
+
+The input is either the serial output of a node, or of virtual_esp with
+--trace, where Server::dumpTrace() printed "RAMEN_TRACE <hex>" lines, or with
+--binary the bytes written by Trace::serialize(). Every trace found in the
+input is printed from its oldest to its newest event.
+
+Keep the event names in sync with TraceEventType in
+library/src/ramen/trace.hpp
+"""
+
+import argparse
+import re
+import struct
+import sys
+
+HEADER = struct.Struct("<4sBBHII")
+EVENT = struct.Struct("<IHHIII")
+MAGIC = b"RTRC"
+VERSION = 1
+
+STATES = {0: "FOLLOWER", 1: "CANDIDATE", 2: "LEADER"}
+
+# Event types and the names of their arguments
+EVENTS = {
+    1: ("STARTED", []),
+    2: ("STATE_CHANGED", ["state", "term", "previous_state"]),
+    3: ("ELECTION_STARTED", ["term", "last_log_term", "log_size"]),
+    4: ("VOTE_REQUEST", ["sender", "term", "granted"]),
+    5: ("VOTE_RESPONSE", ["sender", "term", "granted"]),
+    6: ("APPEND_ENTRIES_REQUEST", ["sender", "success", "match_index"]),
+    7: ("APPEND_ENTRIES_RESPONSE", ["sender", "success", "match_index"]),
+    8: ("COMMIT_ADVANCED", ["commit_index", "previous_commit_index"]),
+    9: ("MALFORMED_MESSAGE", ["sender"]),
+}
+
+
+def read_dumps(text):
+    """
+    Collect the bytes of the "RAMEN_TRACE <hex>" lines, the other lines of the
+    serial output are skipped
+
+    :param text: Serial output
+    :type text: str
+    :return: Bytes of all traces in the order they were printed
+    :rtype: bytes
+    """
+
+    lines = re.findall(r"RAMEN_TRACE ([0-9a-f]+)", text)
+    return bytes.fromhex("".join(lines))
+
+
+def decode(data):
+    """
+    Decode all traces in the data
+
+    :param data: Serialized traces, one after the other
+    :type data: bytes
+    :return: List of (node_id, recorded, events) for every trace, where the
+    events are (time, sequence, name, args)
+    :rtype: list
+    """
+
+    traces = list()
+    offset = 0
+
+    while offset + HEADER.size <= len(data):
+        magic, version, event_size, count, node_id, recorded = (
+            HEADER.unpack_from(data, offset)
+        )
+        if magic != MAGIC or version != VERSION:
+            raise ValueError("No trace header at byte {}".format(offset))
+        offset += HEADER.size
+
+        events = list()
+        for _ in range(count):
+            if offset + event_size > len(data):
+                raise ValueError("Trace of node {} is cut off".format(node_id))
+
+            time, event_type, sequence, *args = EVENT.unpack_from(data, offset)
+            offset += event_size
+
+            name, arg_names = EVENTS.get(
+                event_type, ("UNKNOWN_{}".format(event_type), ["arg0", "arg1", "arg2"])
+            )
+            named_args = dict(zip(arg_names, args))
+            for key in ("state", "previous_state"):
+                if key in named_args:
+                    named_args[key] = STATES.get(named_args[key], named_args[key])
+            events.append((time, sequence, name, named_args))
+
+        traces.append((node_id, recorded, events))
+
+    return traces
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Decode the traces of ramen nodes")
+    parser.add_argument(
+        "infile",
+        nargs="?",
+        help="serial output or serialized trace, standard input if left out",
+    )
+    parser.add_argument(
+        "--binary",
+        action="store_true",
+        help="the input holds the bytes of Trace::serialize()",
+    )
+    args = parser.parse_args()
+
+    if args.binary:
+        if args.infile:
+            with open(args.infile, "rb") as infile:
+                data = infile.read()
+        else:
+            data = sys.stdin.buffer.read()
+    else:
+        if args.infile:
+            with open(args.infile, errors="replace") as infile:
+                data = read_dumps(infile.read())
+        else:
+            data = read_dumps(sys.stdin.read())
+
+    for node_id, recorded, events in decode(data):
+        print(
+            "Node {}: {} of {} recorded events".format(node_id, len(events), recorded)
+        )
+        for time, sequence, name, named_args in events:
+            print(
+                "  {:>12} #{:<5} {} {}".format(
+                    time,
+                    sequence,
+                    name,
+                    " ".join("{}={}".format(k, v) for k, v in named_args.items()),
+                )
+            )
+
+
+if __name__ == "__main__":
+    main()